@@ -15,6 +15,8 @@
 #include "file/file.h"
 
 #include <pthread.h>
+#include <sys/mman.h>
+#include <unistd.h>
 #include <string>
 #include <unordered_map>
 
@@ -313,6 +315,13 @@ uint64 File::Size() {
   return size;
 }
 
+void File::Unmap(void *data, size_t size) {
+  // Mappings start on a page boundary, so the part of the first page before
+  // the data is also released.
+  uintptr_t offset = reinterpret_cast<uintptr_t>(data) % sysconf(_SC_PAGESIZE);
+  CHECK_EQ(munmap(static_cast<char *>(data) - offset, size + offset), 0);
+}
+
 REGISTER_INITIALIZER(filesystem, {
   File::Init();
 });
@@ -96,6 +96,15 @@ class File {
   // Flush unwritten data.
   virtual Status Flush() = 0;
 
+  // Map region of file into memory. Returns null if the file cannot be memory
+  // mapped. Changes to the mapped memory are private to the process and are
+  // not written back to the file. The mapping stays valid after the file has
+  // been closed and must be released with Unmap().
+  virtual void *Map(uint64 pos, size_t size) { return nullptr; }
+
+  // Release memory mapped with Map().
+  static void Unmap(void *data, size_t size);
+
   // Return the file name.
   virtual string filename() const = 0;
 
@@ -20,6 +20,7 @@
 #include <unistd.h>
 #include <stdio.h>
 #include <string.h>
+#include <sys/mman.h>
 #include <sys/stat.h>
 
 #include <string>
@@ -141,6 +142,16 @@ class PosixFile : public File {
     return Status::OK;
   }
 
+  void *Map(uint64 pos, size_t size) override {
+    // The file offset for the mapping must be a multiple of the page size.
+    if (size == 0) return nullptr;
+    uint64 offset = pos % sysconf(_SC_PAGESIZE);
+    void *mapping = mmap(nullptr, size + offset, PROT_READ | PROT_WRITE,
+                         MAP_PRIVATE, fd_, pos - offset);
+    if (mapping == MAP_FAILED) return nullptr;
+    return static_cast<char *>(mapping) + offset;
+  }
+
   string filename() const override { return filename_; }
 
  private:
@@ -15,6 +15,7 @@
 #include "frame/decoder.h"
 
 #include <string>
+#include <vector>
 
 #include "base/logging.h"
 #include "frame/object.h"
@@ -53,7 +54,7 @@ Handle Decoder::DecodeObject() {
       break;
 
     case WIRE_FRAME:
-      handle = DecodeFrame(arg, -1);
+      handle = DecodeFrame(arg, -1, -1);
       break;
 
     case WIRE_STRING:
@@ -62,12 +63,20 @@ Handle Decoder::DecodeObject() {
       break;
 
     case WIRE_SYMBOL:
-      handle = DecodeSymbol(arg);
+      if (dictionary_.length() > 0) {
+        handle = DictionarySymbol(arg);
+      } else {
+        handle = DecodeSymbol(arg);
+      }
       *references_.push() = handle;
       break;
 
     case WIRE_LINK:
-      handle = DecodeLink(arg);
+      if (dictionary_.length() > 0) {
+        handle = store_->Lookup(DictionarySymbol(arg));
+      } else {
+        handle = DecodeLink(arg);
+      }
       *references_.push() = handle;
       break;
 
@@ -102,9 +111,27 @@ Handle Decoder::DecodeObject() {
           CHECK(input_->ReadVarint32(&slots));
           CHECK(input_->ReadVarint32(&replace));
           DCHECK_LT(replace, references_.length());
-          handle = DecodeFrame(slots, replace);
+          handle = DecodeFrame(slots, replace, -1);
+          break;
+        }
+        case WIRE_SHAPE: {
+          uint32 slots;
+          CHECK(input_->ReadVarint32(&slots));
+          handle = DecodeFrame(slots, -1, shapes_.size());
+          break;
+        }
+        case WIRE_SHAPED: {
+          uint32 shape;
+          CHECK(input_->ReadVarint32(&shape));
+          CHECK_LT(shape, shapes_.size());
+          handle = DecodeFrame(shapes_[shape].slots, -1, shape);
           break;
         }
+        case WIRE_SYMBOLS:
+          // The symbol dictionary is followed by the object.
+          DecodeDictionary();
+          handle = DecodeObject();
+          break;
         default: LOG(FATAL) << "Invalid tag value: " << tag;
       }
   }
@@ -113,7 +140,7 @@ Handle Decoder::DecodeObject() {
   return handle;
 }
 
-Handle Decoder::DecodeFrame(int slots, int replace) {
+Handle Decoder::DecodeFrame(int slots, int replace, int shape) {
   // Pre-allocate frame unless we are resolving a link.
   Handle handle;
   int index;
@@ -126,11 +153,30 @@ Handle Decoder::DecodeFrame(int slots, int replace) {
     index = replace;
   }
 
+  // Read slot names for new shape. The names are decoded onto the stack first,
+  // because decoding the names can add other shapes.
+  if (shape == shapes_.size()) {
+    shapes_.push_back({0, slots});
+    Word mark = Mark();
+    for (int i = 0; i < slots; ++i) Push(DecodeObject());
+    shapes_[shape].names = shape_names_.length();
+    for (Handle *h = stack_.address(mark); h < stack_.end(); ++h) {
+      *shape_names_.push() = *h;
+    }
+    Release(mark);
+  }
+
   // Decode slots for frame and store them temporarily on the stack.
   Word mark = Mark();
   for (int i = 0; i < slots; ++i) {
-    // Read slot name and value.
-    Handle name = DecodeObject();
+    // Read slot name and value. The shape names are looked up for each slot,
+    // because decoding the value can add new shapes.
+    Handle name;
+    if (shape == -1) {
+      name = DecodeObject();
+    } else {
+      name = shape_names_.base()[shapes_[shape].names + i];
+    }
     Push(name);
     Handle value = DecodeObject();
     Push(value);
@@ -161,7 +207,7 @@ Handle Decoder::DecodeFrame(int slots, int replace) {
           *(references_.base() + index) = handle;
 
           // Unbind the symbol. It will be bound to the frame later.
-          symbol->value = symbol->self;
+          store_->Mutable(value)->AsSymbol()->value = value;
         }
       }
     }
@@ -235,6 +281,7 @@ Handle Decoder::DecodeArray() {
   ArrayDatum *array = store_->Deref(handle)->AsArray();
   Handle *dest = array->begin();
   while (source < end) *dest++ = *source++;
+  store_->WriteBarrier(array);
 
   // Remove elements from stack.
   Release(mark);
@@ -244,29 +291,105 @@ Handle Decoder::DecodeArray() {
 
 Handle Decoder::DecodeSymbol(int name_size) {
   // Read symbol name and resolve unbound symbol reference.
-  const char *data;
-  if (input_->TryRead(name_size, &data)) {
-    // Fast case.
-    return store_->Symbol(Text(data, name_size));
-  } else {
-    // Slow case.
-    string name;
-    CHECK(input_->ReadString(name_size, &name));
-    return store_->Symbol(name);
-  }
+  return ResolveSymbol(name_size, false);
 }
 
 Handle Decoder::DecodeLink(int name_size) {
   // Read symbol name and resolve bound symbol reference.
+  return ResolveSymbol(name_size, true);
+}
+
+Handle Decoder::ResolveSymbol(int name_size, bool link) {
+  // Read symbol name.
   const char *data;
-  if (input_->TryRead(name_size, &data)) {
-    // Fast case.
-    return store_->Lookup(Text(data, name_size));
-  } else {
+  string buffer;
+  if (!input_->TryRead(name_size, &data)) {
     // Slow case.
-    string name;
-    CHECK(input_->ReadString(name_size, &name));
-    return store_->Lookup(name);
+    CHECK(input_->ReadString(name_size, &buffer));
+    data = buffer.data();
+  }
+  return ResolveName(Text(data, name_size), link);
+}
+
+Handle Decoder::ResolveName(Text name, bool link) {
+  if (symbol_cache_ != nullptr) {
+    // Try to resolve the symbol using the symbol cache.
+    Handle hash = Store::Hash(name);
+    Handle h = LookupCache(name, hash, link);
+    if (!h.IsNil()) {
+      cache_hits_++;
+      return h;
+    }
+    cache_misses_++;
+
+    // Add global symbol to the cache.
+    Handle symbol = store_->Symbol(name);
+    symbol_cache_->Insert(symbol);
+    return link ? store_->Lookup(symbol) : symbol;
+  }
+
+  return link ? store_->Lookup(name) : store_->Symbol(name);
+}
+
+Handle Decoder::LookupCache(Text name, Handle hash, bool link) {
+  const SymbolCache::Entry *entry = symbol_cache_->Find(name, hash);
+  if (entry == nullptr) return Handle::nil();
+
+  // Local symbols take precedence over global symbols.
+  Handle local = store_->FindLocalSymbol(name, hash);
+  if (!local.IsNil()) return link ? store_->Lookup(local) : local;
+  if (!link) return entry->symbol;
+
+  // Unbound global symbols are bound to proxies through local symbols.
+  if (entry->value.IsNil()) return store_->Lookup(entry->symbol);
+  return entry->value;
+}
+
+void Decoder::DecodeDictionary() {
+  uint32 size;
+  CHECK(input_->ReadVarint32(&size));
+
+  // Each name shares a prefix with the previous name in the dictionary.
+  string name;
+  for (uint32 i = 0; i < size; ++i) {
+    uint32 common;
+    uint32 length;
+    CHECK(input_->ReadVarint32(&common));
+    CHECK(input_->ReadVarint32(&length));
+    CHECK_LE(common, name.size());
+    name.resize(common + length);
+    CHECK(input_->Read(&name[common], length));
+    Handle symbol = ResolveName(name, false);
+    *dictionary_.push() = symbol;
+  }
+}
+
+Handle Decoder::DictionarySymbol(uint32 index) {
+  CHECK_LT(index, dictionary_.length());
+  Handle *symbol = dictionary_.base() + index;
+  if (!store_->Owned(*symbol)) {
+    // A local symbol might have been created for the name after the dictionary
+    // was decoded, e.g. for a frame that has the symbol as its id.
+    const SymbolDatum *global = store_->GetSymbol(*symbol);
+    Text name = store_->GetString(global->name)->str();
+    Handle local = store_->FindLocalSymbol(name, global->hash);
+    if (!local.IsNil()) *symbol = local;
+  }
+  return *symbol;
+}
+
+void Decoder::set_symbol_cache(SymbolCache *cache) {
+  if (symbol_cache_ != nullptr) {
+    symbol_cache_->AddStats(cache_hits_, cache_misses_);
+    cache_hits_ = cache_misses_ = 0;
+  }
+  if (cache != nullptr) CHECK(cache->globals() == store_->globals());
+  symbol_cache_ = cache;
+}
+
+Decoder::~Decoder() {
+  if (symbol_cache_ != nullptr) {
+    symbol_cache_->AddStats(cache_hits_, cache_misses_);
   }
 }
 
@@ -16,10 +16,12 @@
 #define FRAME_DECODER_H_
 
 #include <string>
+#include <vector>
 
 #include "base/macros.h"
 #include "frame/object.h"
 #include "frame/store.h"
+#include "frame/symbol-cache.h"
 #include "stream/input.h"
 
 namespace sling {
@@ -30,7 +32,11 @@ class Decoder {
   // Initializes decoder with store where objects should be stored and input
   // where objects are read from.
   Decoder(Store *store, Input *input)
-      : store_(store), input_(input), references_(store), stack_(store) {}
+      : store_(store), input_(input), references_(store), stack_(store),
+        dictionary_(store), shape_names_(store) {}
+
+  // Adds the cache statistics to the symbol cache.
+  ~Decoder();
 
   // Decodes the next object from the input.
   Object Decode();
@@ -47,9 +53,16 @@ class Decoder {
   // Skips frames in the input which are already in the store.
   void set_skip_known_frames(bool b) { skip_known_frames_ = b; }
 
+  // Resolves symbol names through a symbol cache for the global store. The
+  // cache is not owned by the decoder and can be shared with other decoders.
+  void set_symbol_cache(SymbolCache *cache);
+
  private:
-  // Decodes frame from input.
-  Handle DecodeFrame(int slots, int replace);
+  // Decodes frame from input. If 'shape' is not -1, the slot names are taken
+  // from the shape and only the slot values are read from the input. A new
+  // shape is read from the input before the slot values if 'shape' is the
+  // next shape number.
+  Handle DecodeFrame(int slots, int replace, int shape);
 
   // Decodes string from input.
   Handle DecodeString(int size);
@@ -63,6 +76,24 @@ class Decoder {
   // Decodes bound symbol from input.
   Handle DecodeLink(int name_size);
 
+  // Reads symbol name and resolves it to a symbol, or to the value of the
+  // symbol for links.
+  Handle ResolveSymbol(int name_size, bool link);
+
+  // Resolves symbol name to a symbol, or to the value of the symbol for links.
+  Handle ResolveName(Text name, bool link);
+
+  // Decodes symbol dictionary and resolves the names in the dictionary.
+  void DecodeDictionary();
+
+  // Returns symbol from symbol dictionary.
+  Handle DictionarySymbol(uint32 index);
+
+  // Looks up symbol name in the symbol cache. Local symbols shadowing the
+  // cached global symbol take precedence. Returns nil if the symbol is not in
+  // the cache.
+  Handle LookupCache(Text name, Handle hash, bool link);
+
   // Gets the current location in the stack.
   Word Mark() { return stack_.offset(stack_.end()); }
 
@@ -97,9 +128,26 @@ class Decoder {
   // Stack for storing intermediate values while decoding objects.
   HandleSpace stack_;
 
+  // Symbols in symbol dictionaries for version 2 wire format.
+  HandleSpace dictionary_;
+
+  // Frame shapes for version 3 wire format. The slot names for all the shapes
+  // are stored in the shape name space.
+  struct Shape {
+    int names;  // position of the slot names in shape_names_
+    int slots;  // number of slots
+  };
+  std::vector<Shape> shapes_;
+  HandleSpace shape_names_;
+
   // Frames that already exist in the store can be skipped by the decoder.
   bool skip_known_frames_ = false;
 
+  // Cache for symbols in the global store.
+  SymbolCache *symbol_cache_ = nullptr;
+  int64 cache_hits_ = 0;
+  int64 cache_misses_ = 0;
+
   DISALLOW_IMPLICIT_CONSTRUCTORS(Decoder);
 };
 
@@ -14,16 +14,25 @@
 
 #include "frame/encoder.h"
 
+#include <algorithm>
 #include <string>
+#include <vector>
 
 #include "base/logging.h"
 #include "frame/object.h"
 #include "frame/store.h"
 #include "frame/wire.h"
+#include "stream/memory.h"
 #include "stream/output.h"
 
 namespace sling {
 
+// Maximum number of slot names in the shape table of the encoder.
+static const int kMaxShapeNames = 1 << 20;
+
+// Maximum number of frames in each section in streaming mode.
+static const int kMaxSectionFrames = 1024;
+
 Encoder::Encoder(const Store *store, Output *output)
     : store_(store), output_(output), global_(store->globals() == nullptr) {
   // Insert special values in reference mapping.
@@ -33,24 +42,179 @@ Encoder::Encoder(const Store *store, Output *output)
   references_[Handle::is()] = Reference(-WIRE_IS);
 }
 
+void Encoder::set_streaming(bool streaming) {
+  streaming_ = streaming;
+  if (streaming) ResizeTables();
+}
+
+void Encoder::ResizeTables() {
+  size_t size = handle_references_.size();
+  size_t handles = store_->num_handles();
+  if (handles == size) return;
+  handle_references_.resize(handles);
+  handle_dictionary_.resize(handles, -1);
+
+  // Copy special values owned by the store to the reference table.
+  if (size == 0) {
+    const Handle specials[] = {
+      Handle::nil(), Handle::id(), Handle::isa(), Handle::is()
+    };
+    for (Handle h : specials) {
+      if (store_->Owned(h)) {
+        handle_references_[h.offset() / sizeof(Datum *)] = references_[h];
+      }
+    }
+  }
+}
+
+void Encoder::Encode(Handle handle) {
+  if (streaming_) ResizeTables();
+  if (version_ >= WIRE_VERSION_2) {
+    EncodeSection(&handle, &handle + 1, false);
+  } else {
+    EncodeObject(handle);
+  }
+}
+
 void Encoder::EncodeAll() {
-  const MapDatum *map = store_->GetMap(store_->symbols());
-  for (Handle *bucket = map->begin(); bucket < map->end(); ++bucket) {
-    Handle h = *bucket;
-    while (!h.IsNil()) {
-      const SymbolDatum *symbol = store_->GetSymbol(h);
+  // Objects in a forked store can be shared with its parent, so these are
+  // encoded from the symbol table.
+  if (streaming_) ResizeTables();
+  if (streaming_ && store_->parent() == nullptr) {
+    EncodeHeaps();
+  } else if (version_ >= WIRE_VERSION_2) {
+    EncodeSection(nullptr, nullptr, true);
+  } else {
+    EncodeSymbolTable();
+  }
+}
+
+void Encoder::EncodeSymbolTable() {
+  const ArrayDatum *segments = store_->GetArray(store_->symbols());
+  for (Handle *s = segments->begin(); s < segments->end(); ++s) {
+    const MapDatum *map = store_->GetMap(*s);
+    for (MapDatum::Entry *e = map->begin(); e < map->end(); ++e) {
+      if (e->symbol.IsNil()) continue;
+      const SymbolDatum *symbol = store_->GetSymbol(e->symbol);
       if (symbol->bound() && !store_->IsProxy(symbol->value)) {
         EncodeObject(symbol->value);
       }
-      h = symbol->next;
     }
   }
 }
 
+void Encoder::EncodeHeaps() {
+  // The frames are encoded in batches to keep the section buffer small for
+  // version 2 encoding.
+  std::vector<Handle> batch;
+  Store::Iterator objects(store_);
+  const Datum *datum;
+  while ((datum = objects.next()) != nullptr) {
+    if (!datum->IsFrame() || datum->IsProxy()) continue;
+    const FrameDatum *frame = datum->AsFrame();
+    if (!frame->IsNamed()) continue;
+
+    // Only encode frames that are bound to one of their ids. This skips
+    // invalidated frames and garbage left in the heaps.
+    if (store_->GetObject(frame->self) != datum) continue;
+    bool bound = false;
+    for (const Slot *s = frame->begin(); s < frame->end() && !bound; ++s) {
+      if (s->name.IsId() && store_->Owned(s->value)) {
+        const Datum *id = store_->GetObject(s->value);
+        bound = id->IsSymbol() && id->AsSymbol()->value == frame->self;
+      }
+    }
+    if (!bound) continue;
+
+    // Frames can already have been encoded by value as part of other frames.
+    if (GetReference(frame->self).status == ENCODED) continue;
+    if (version_ >= WIRE_VERSION_2) {
+      batch.push_back(frame->self);
+      if (batch.size() == kMaxSectionFrames) {
+        EncodeSection(batch.data(), batch.data() + batch.size(), false);
+        batch.clear();
+      }
+    } else {
+      EncodeObject(frame->self);
+    }
+  }
+  if (!batch.empty()) {
+    EncodeSection(batch.data(), batch.data() + batch.size(), false);
+  }
+}
+
+void Encoder::EncodeSection(const Handle *begin, const Handle *end, bool all) {
+  // Encode objects into the section buffer.
+  Output *output = output_;
+  section_.clear();
+  {
+    StringOutputStream stream(&section_);
+    Output buffer(&stream);
+    output_ = &buffer;
+    if (all) {
+      EncodeSymbolTable();
+    } else {
+      for (const Handle *h = begin; h < end; ++h) EncodeObject(*h);
+    }
+  }
+  output_ = output;
+
+  // Output dictionary with the new symbols sorted by name.
+  int first = dictionary_size_;
+  int num_new = new_symbols_.size();
+  if (num_new > 0) {
+    std::vector<Text> names(num_new);
+    for (int i = 0; i < num_new; ++i) {
+      const SymbolDatum *symbol = store_->GetSymbol(new_symbols_[i]);
+      names[i] = store_->GetString(symbol->name)->str();
+    }
+    std::vector<int> order(num_new);
+    for (int i = 0; i < num_new; ++i) order[i] = i;
+    std::sort(order.begin(), order.end(), [&names](int a, int b) {
+      return names[a] < names[b];
+    });
+
+    WriteTag(WIRE_SPECIAL, WIRE_SYMBOLS);
+    output_->WriteVarint32(num_new);
+    std::vector<int> remap(num_new);
+    Text prev;
+    for (int i = 0; i < num_new; ++i) {
+      int n = order[i];
+      Text name = names[n];
+      int common = 0;
+      int limit = std::min(prev.size(), name.size());
+      while (common < limit && prev[common] == name[common]) common++;
+      output_->WriteVarint32(common);
+      output_->WriteVarint32(name.size() - common);
+      output_->Write(name.data() + common, name.size() - common);
+      prev = name;
+
+      remap[n] = first + i;
+      DictionaryIndex(new_symbols_[n]) = first + i;
+    }
+    dictionary_size_ += num_new;
+    new_symbols_.clear();
+
+    for (SymbolTag &tag : symbol_tags_) {
+      if (tag.index >= first) tag.index = remap[tag.index - first];
+    }
+  }
+
+  // Output section buffer with the symbol and link tags.
+  int64 position = 0;
+  for (const SymbolTag &tag : symbol_tags_) {
+    output_->Write(section_.data() + position, tag.position - position);
+    WriteTag(tag.type, tag.index);
+    position = tag.position;
+  }
+  output_->Write(section_.data() + position, section_.size() - position);
+  symbol_tags_.clear();
+}
+
 void Encoder::EncodeObject(Handle handle) {
   if (handle.IsRef()) {
     // Check if object has already been output.
-    Reference &ref = references_[handle];
+    Reference &ref = GetReference(handle);
     if (ref.status == ENCODED) {
       WriteReference(ref);
     } else if (ref.status == LINKED) {
@@ -94,12 +258,7 @@ void Encoder::EncodeObject(Handle handle) {
             // Output frame slots.
             ref.index = next_index_++;
             ref.status = ENCODED;
-            const FrameDatum *frame = datum->AsFrame();
-            WriteTag(WIRE_FRAME, frame->slots());
-            for (const Slot *s = frame->begin(); s < frame->end(); ++s) {
-              EncodeLink(s->name);
-              EncodeLink(s->value);
-            }
+            EncodeFrame(datum->AsFrame());
           }
           break;
         }
@@ -144,6 +303,95 @@ void Encoder::EncodeObject(Handle handle) {
   }
 }
 
+void Encoder::EncodeFrame(const FrameDatum *frame) {
+  // Frames with less than two slots are not worth encoding with shapes.
+  Shape *shape = nullptr;
+  if (version_ >= WIRE_VERSION_3 && frame->slots() >= 2) {
+    shape = FindShape(frame);
+  }
+
+  if (shape == nullptr) {
+    // Output slot names and values.
+    WriteTag(WIRE_FRAME, frame->slots());
+    for (const Slot *s = frame->begin(); s < frame->end(); ++s) {
+      EncodeLink(s->name);
+      EncodeLink(s->value);
+    }
+  } else if (shape->index == -1) {
+    // Output new shape with the slot names followed by the slot values.
+    shape->index = num_shapes_++;
+    WriteTag(WIRE_SPECIAL, WIRE_SHAPE);
+    output_->WriteVarint32(frame->slots());
+    for (const Slot *s = frame->begin(); s < frame->end(); ++s) {
+      EncodeLink(s->name);
+    }
+    for (const Slot *s = frame->begin(); s < frame->end(); ++s) {
+      EncodeLink(s->value);
+    }
+  } else {
+    // Output shape number followed by the slot values.
+    WriteTag(WIRE_SPECIAL, WIRE_SHAPED);
+    output_->WriteVarint32(shape->index);
+    for (const Slot *s = frame->begin(); s < frame->end(); ++s) {
+      EncodeLink(s->value);
+    }
+  }
+}
+
+Encoder::Shape *Encoder::FindShape(const FrameDatum *frame) {
+  // Compute hash value for slot names.
+  int slots = frame->slots();
+  uint64 hash = slots;
+  for (const Slot *s = frame->begin(); s < frame->end(); ++s) {
+    hash = (hash ^ s->name.raw()) * 0x100000001B3ULL;
+  }
+
+  // The multiplications only carry bits upwards, so the low bits only depend
+  // on the low bits of the names, which are mostly zero for references. Fold
+  // the high bits into the low bits used for the bucket number.
+  hash ^= hash >> 32;
+
+  // Look up slot names in shape table.
+  int mask = shape_table_.size() - 1;
+  int b = hash & mask;
+  while (!shape_table_.empty() && shape_table_[b] != 0) {
+    Shape &shape = shapes_[shape_table_[b] - 1];
+    if (shape.hash == hash && shape.slots == slots) {
+      const Handle *name = shape_names_.data() + shape.names;
+      const Slot *s = frame->begin();
+      for (; s < frame->end(); ++s, ++name) {
+        if (s->name != *name) break;
+      }
+      if (s == frame->end()) return &shape;
+    }
+    b = (b + 1) & mask;
+  }
+
+  // Stop adding shapes when the table gets too big, e.g. when encoding a large
+  // store where most frames have distinct slot names.
+  if (shape_names_.size() >= kMaxShapeNames) return nullptr;
+
+  // Add new shape. The hash table is kept at most half full.
+  if ((shapes_.size() + 1) * 2 > shape_table_.size()) {
+    int size = shape_table_.empty() ? 1024 : shape_table_.size() * 2;
+    shape_table_.assign(size, 0);
+    mask = size - 1;
+    for (int i = 0; i < shapes_.size(); ++i) {
+      int bucket = shapes_[i].hash & mask;
+      while (shape_table_[bucket] != 0) bucket = (bucket + 1) & mask;
+      shape_table_[bucket] = i + 1;
+    }
+    b = hash & mask;
+    while (shape_table_[b] != 0) b = (b + 1) & mask;
+  }
+  shape_table_[b] = shapes_.size() + 1;
+  shapes_.push_back({hash, static_cast<int>(shape_names_.size()), slots, -1});
+  for (const Slot *s = frame->begin(); s < frame->end(); ++s) {
+    shape_names_.push_back(s->name);
+  }
+  return nullptr;
+}
+
 void Encoder::EncodeLink(Handle handle) {
   // Determine if only a link to the object should be output.
   Handle link = Handle::nil();
@@ -168,7 +416,7 @@ void Encoder::EncodeLink(Handle handle) {
     EncodeObject(handle);
   } else {
     // Output link to object.
-    Reference &ref = references_[handle];
+    Reference &ref = GetReference(handle);
     if (ref.status == UNRESOLVED) {
       ref.index = next_index_++;
       ref.status = LINKED;
@@ -180,6 +428,17 @@ void Encoder::EncodeLink(Handle handle) {
 }
 
 void Encoder::EncodeSymbol(const SymbolDatum *symbol, int type) {
+  if (version_ >= WIRE_VERSION_2) {
+    // Add symbol to the dictionary and leave a placeholder for the tag.
+    int &index = DictionaryIndex(symbol->self);
+    if (index == -1) {
+      index = dictionary_size_ + new_symbols_.size();
+      new_symbols_.push_back(symbol->self);
+    }
+    symbol_tags_.push_back({output_->position(), type, index});
+    return;
+  }
+
   const StringDatum *name = store_->GetString(symbol->name);
   WriteTag(type, name->size());
   output_->Write(name->data(), name->size());
@@ -17,10 +17,13 @@
 
 #include <string>
 #include <hash_map>
+#include <vector>
 
+#include "base/logging.h"
 #include "base/macros.h"
 #include "frame/object.h"
 #include "frame/store.h"
+#include "frame/wire.h"
 #include "stream/output.h"
 
 namespace sling {
@@ -32,16 +35,28 @@ class Encoder {
   Encoder(const Store *store, Output *output);
 
   // Encodes object to output.
-  void Encode(const Object &object) { EncodeObject(object.handle()); }
-  void Encode(Handle handle) { EncodeObject(handle); }
+  void Encode(const Object &object) { Encode(object.handle()); }
+  void Encode(Handle handle);
 
-  // Encodes all frames in the symbol table of the store.
+  // Encodes all frames in the symbol table of the store. In streaming mode,
+  // the frames are encoded in the order they are stored in the heaps.
   void EncodeAll();
 
   // Configuration parameters.
   void set_shallow(bool shallow) { shallow_ = shallow; }
   void set_global(bool global) { global_ = global; }
 
+  // Sets the wire format version for the encoder. Version 2 outputs a sorted
+  // symbol dictionary before each encoded object. Version 3 also encodes frames
+  // with recurring slot names as shapes.
+  void set_version(int version) { version_ = version; }
+
+  // Enables streaming mode for encoding large stores. References to objects in
+  // the store are kept in tables indexed by handle instead of hash tables, and
+  // each frame is encoded in its own section. This should be set before any
+  // objects are encoded.
+  void set_streaming(bool streaming);
+
  private:
   // Object encoding states.
   enum Status {
@@ -62,15 +77,75 @@ class Encoder {
     int index;      // reference number
   };
 
+  // Frame shape, i.e. the sequence of slot names in a frame.
+  struct Shape {
+    uint64 hash;     // hash value for slot names
+    int names;       // position of the slot names in shape_names_
+    int slots;       // number of slots
+    int index;       // shape number, or -1 if the shape has not been output
+  };
+
+  // Symbol or link tag in the section buffer.
+  struct SymbolTag {
+    int64 position;  // position of tag in section buffer
+    int type;        // WIRE_SYMBOL or WIRE_LINK
+    int index;       // dictionary index for symbol
+  };
+
+  // Encodes all frames in the symbol table.
+  void EncodeSymbolTable();
+
+  // Encodes all named frames in the store in heap order.
+  void EncodeHeaps();
+
+  // Encodes objects, or all frames in the symbol table, in a section with a
+  // symbol dictionary for version 2 encoding.
+  void EncodeSection(const Handle *begin, const Handle *end, bool all);
+
   // Encodes object for handle.
   void EncodeObject(Handle handle);
 
+  // Encodes frame slots, using a shape if the slot names are recurring.
+  void EncodeFrame(const FrameDatum *frame);
+
+  // Finds shape with the slot names of the frame. Returns null if the frame
+  // has a new sequence of slot names, which is then added as a new shape.
+  Shape *FindShape(const FrameDatum *frame);
+
   // Encodes object link.
   void EncodeLink(Handle handle);
 
   // Encodes symbol.
   void EncodeSymbol(const SymbolDatum *symbol, int type);
 
+  // Returns reference for object. The returned reference stays valid while an
+  // object is being encoded, since the streaming tables are only resized
+  // before encoding starts.
+  Reference &GetReference(Handle handle) {
+    if (streaming_ && store_->Owned(handle)) {
+      size_t index = handle.offset() / sizeof(Datum *);
+      CHECK_LT(index, handle_references_.size());
+      return handle_references_[index];
+    }
+    return references_[handle];
+  }
+
+  // Returns dictionary index for symbol, or -1 if the symbol is not in the
+  // dictionary.
+  int &DictionaryIndex(Handle symbol) {
+    if (streaming_ && store_->Owned(symbol)) {
+      size_t index = symbol.offset() / sizeof(Datum *);
+      CHECK_LT(index, handle_dictionary_.size());
+      return handle_dictionary_[index];
+    }
+    return dictionary_.insert(std::make_pair(symbol, -1)).first->second;
+  }
+
+  // Resizes the streaming tables to the size of the handle table of the store.
+  // This is called before encoding objects, since the store can have grown
+  // since the last object was encoded.
+  void ResizeTables();
+
   // Writes tag to output.
   void WriteTag(int tag, uint64 arg) {
     output_->WriteVarint64(tag | (arg << 3));
@@ -89,15 +164,50 @@ class Encoder {
   // have been encoded so far.
   HandleMap<Reference> references_;
 
+  // Reference and dictionary tables indexed by handle for the objects in the
+  // store in streaming mode.
+  std::vector<Reference> handle_references_;
+  std::vector<int> handle_dictionary_;
+
   // Next available reference index.
   int next_index_ = 0;
 
+  // Wire format version.
+  int version_ = WIRE_VERSION_1;
+
+  // Hash table mapping symbols to dictionary indices for version 2 encoding.
+  HandleMap<int> dictionary_;
+
+  // Number of symbols in the dictionaries that have been output.
+  int dictionary_size_ = 0;
+
+  // Symbols added to the dictionary in the current section.
+  std::vector<Handle> new_symbols_;
+
+  // Objects in the current section are encoded in the section buffer without
+  // the symbol and link tags, because the dictionary indices are not known
+  // until the whole section has been encoded.
+  string section_;
+  std::vector<SymbolTag> symbol_tags_;
+
+  // Frame shapes for version 3 encoding. The hash table uses open addressing,
+  // and each entry is the index of a shape plus one.
+  std::vector<Shape> shapes_;
+  std::vector<Handle> shape_names_;
+  std::vector<int> shape_table_;
+
+  // Number of shapes that have been output.
+  int num_shapes_ = 0;
+
   // Output frames with public ids by reference.
   bool shallow_ = true;
 
   // Output frames in the global store by value.
   bool global_;
 
+  // Streaming mode for encoding large stores.
+  bool streaming_ = false;
+
   DISALLOW_IMPLICIT_CONSTRUCTORS(Encoder);
 };
 
@@ -337,7 +337,11 @@ class Array : public Object {
   Handle get(int index) const { return array()->get(index); }
 
   // Sets element in array.
-  void set(int index, Handle value) const { *array()->at(index) = value; }
+  void set(int index, Handle value) const {
+    ArrayDatum *a = store_->Mutable(handle())->AsArray();
+    *a->at(index) = value;
+    store_->WriteBarrier(a);
+  }
 
  private:
   // Dereferences array reference.
@@ -722,6 +726,150 @@ class Frame : public Object {
   const FrameDatum *frame() const { return datum()->AsFrame(); }
 };
 
+// A handle scope keeps objects alive without linking a root for each object
+// reference. The scope is registered once with the store as an external, and
+// the handles tracked by the scope are kept in a stack segment owned by the
+// scope. All the handles are released when the scope is destroyed. Scoped
+// frames are lightweight frame references that are tracked by a handle scope,
+// so they can be created, copied, and destroyed without updating the root list:
+//
+//   HandleScope scope(store);
+//   for (Handle h : frames) {
+//     ScopedFrame f(&scope, h);
+//     ...
+//   }
+class HandleScope : public External {
+ public:
+  explicit HandleScope(Store *store) : External(store), store_(store) {}
+
+  // Adds handle to the scope. Only references to objects owned by an unfrozen
+  // store need to be tracked.
+  Handle Track(Handle handle) {
+    if (handle.IsRef() && !handle.IsNil() &&
+        store_->Owned(handle) && !store_->frozen()) {
+      *handles_.push() = handle;
+    }
+    return handle;
+  }
+
+  // Returns the number of handles tracked by the scope.
+  int size() const { return handles_.length(); }
+
+  // Releases all the handles added to the scope after it had the given size.
+  // This can be used for reusing a scope in a loop.
+  void Release(int size) { handles_.set_end(handles_.base() + size); }
+
+  // Returns the store for the scope.
+  Store *store() const { return store_; }
+
+  void GetReferences(Range *range) override {
+    range->begin = handles_.base();
+    range->end = handles_.end();
+  }
+
+ private:
+  // Store for tracked handles.
+  Store *store_;
+
+  // Handles tracked by the scope.
+  Space<Handle> handles_;
+};
+
+// Frame reference tracked by a handle scope. A scoped frame has read-only
+// access to the frame and must not outlive its scope.
+class ScopedFrame {
+ public:
+  // Initializes nil frame reference.
+  ScopedFrame() : scope_(nullptr), handle_(Handle::nil()) {}
+
+  // Initializes reference to existing frame and adds it to the scope.
+  ScopedFrame(HandleScope *scope, Handle handle)
+      : scope_(scope), handle_(scope->Track(handle)) {
+    DCHECK(IsNil() || store()->Deref(handle)->IsFrame());
+  }
+
+  // Returns the handle for the frame.
+  Handle handle() const { return handle_; }
+
+  // Returns the store for the frame.
+  Store *store() const { return scope_->store(); }
+
+  // Checks if frame is valid, i.e. is not nil.
+  bool IsNil() const { return handle_.IsNil(); }
+  bool valid() const { return !IsNil(); }
+  bool invalid() const { return IsNil(); }
+
+  // Returns a tracked frame object for the frame.
+  Frame AsFrame() const { return Frame(store(), handle_); }
+
+  // Returns the number of slots in the frame.
+  int size() const { return datum()->size() / sizeof(Slot); }
+
+  // Slot iteration.
+  const Slot *begin() const { return datum()->begin(); }
+  const Slot *end() const { return datum()->end(); }
+
+  // Checks if frame has named slot.
+  bool Has(Handle name) const { return datum()->has(name); }
+  bool Has(const Name &name) const { return Has(name.Lookup(store())); }
+
+  // Gets slot value as handle.
+  Handle GetHandle(Handle name) const { return datum()->get(name); }
+  Handle GetHandle(const Name &name) const {
+    return GetHandle(name.Lookup(store()));
+  }
+
+  // Gets slot value as frame. The frame is added to the scope.
+  ScopedFrame GetFrame(Handle name) const {
+    return ScopedFrame(scope_, store()->Cast(datum()->get(name), FRAME));
+  }
+  ScopedFrame GetFrame(const Name &name) const {
+    return GetFrame(name.Lookup(store()));
+  }
+
+  // Gets slot value as integer.
+  int GetInt(Handle name, int defval = 0) const {
+    Handle value = datum()->get(name);
+    return value.IsInt() ? value.AsInt() : defval;
+  }
+  int GetInt(const Name &name, int defval = 0) const {
+    return GetInt(name.Lookup(store()), defval);
+  }
+
+  // Gets slot value as text buffer.
+  Text GetText(Handle name) const {
+    Handle value = datum()->get(name);
+    if (value.IsRef() && !value.IsNil()) {
+      Datum *datum = store()->Deref(value);
+      if (datum->IsString()) return datum->AsString()->str();
+    }
+    return Text();
+  }
+  Text GetText(const Name &name) const {
+    return GetText(name.Lookup(store()));
+  }
+
+  // Checks frame type, i.e. checks if frame has an isa slot with the type.
+  bool IsA(Handle type) const {
+    const FrameDatum *frame = datum();
+    for (const Slot *slot = frame->begin(); slot < frame->end(); ++slot) {
+      if (slot->name.IsIsA() && slot->value == type) return true;
+    }
+    return false;
+  }
+  bool IsA(const Name &type) const { return IsA(type.Lookup(store())); }
+
+ private:
+  // Dereferences frame reference.
+  const FrameDatum *datum() const { return store()->GetFrame(handle_); }
+
+  // Handle scope tracking the frame.
+  HandleScope *scope_;
+
+  // Handle for frame.
+  Handle handle_;
+};
+
 // A builder is used for creating new frames in a store.
 class Builder : public External {
  public:
@@ -72,16 +72,16 @@ void Printer::Print(Handle handle, bool reference) {
 }
 
 void Printer::PrintAll() {
-  const MapDatum *map = store_->GetMap(store_->symbols());
-  for (Handle *bucket = map->begin(); bucket < map->end(); ++bucket) {
-    Handle h = *bucket;
-    while (!h.IsNil()) {
-      const SymbolDatum *symbol = store_->GetSymbol(h);
+  const ArrayDatum *segments = store_->GetArray(store_->symbols());
+  for (Handle *s = segments->begin(); s < segments->end(); ++s) {
+    const MapDatum *map = store_->GetMap(*s);
+    for (MapDatum::Entry *e = map->begin(); e < map->end(); ++e) {
+      if (e->symbol.IsNil()) continue;
+      const SymbolDatum *symbol = store_->GetSymbol(e->symbol);
       if (symbol->bound() && !store_->IsProxy(symbol->value)) {
         Print(symbol->value);
         WriteChar('\n');
       }
-      h = symbol->next;
     }
   }
 }
@@ -300,9 +300,9 @@ void Printer::PrintInt(int number) {
 }
 
 void Printer::PrintFloat(float number) {
-  char buffer[kFastToBufferSize];
-  char *str = FloatToBuffer(number, buffer);
-  output_->Write(str, strlen(str));
+  char buffer[kFloatToBufferSize];
+  char *end = FastFloatToBufferLeft(number, buffer);
+  output_->Write(buffer, end - buffer);
 }
 
 }  // namespace sling
@@ -57,7 +57,8 @@ Handle Reader::ParseObject() {
 
     case FLOAT_TOKEN: {
       float value;
-      CHECK(safe_strtof(token_text(), &value));
+      const string &text = token_text();
+      CHECK(safe_strtof(text.data(), text.size(), &value)) << text;
       handle = Handle::Float(value);
       NextToken();
       break;
@@ -0,0 +1,273 @@
+// Copyright 2017 Google Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "frame/role-index.h"
+
+#include <errno.h>
+#include <stdio.h>
+#include <string.h>
+#include <algorithm>
+
+#include "base/logging.h"
+#include "util/fingerprint.h"
+
+namespace sling {
+
+// Header for index file.
+struct RoleIndexHeader {
+  uint32 magic;        // magic number for identifying index files
+  uint32 version;      // index format version
+  uint64 num_handles;  // size of handle table in indexed store
+  uint64 num_entries;  // number of index entries
+  uint64 num_postings; // total size of posting lists
+  uint64 handle_size;  // size of handles in bytes
+};
+
+static const uint32 kRoleIndexMagic = 0x58444952;  // "RIDX"
+static const uint32 kRoleIndexVersion = 3;
+
+// String value keys have the top bit set to keep them apart from handles.
+static const uint64 kStringKey = 1ULL << 63;
+
+// Returns the number of handles in the handle table of a store.
+static uint64 NumHandles(const Store *store) {
+  MemoryUsage usage;
+  store->GetMemoryUsage(&usage, true);
+  return usage.num_handles - usage.num_unused_handles;
+}
+
+// Finds the first element in a sorted handle range that is not less than the
+// value by exponential search from the beginning of the range.
+static const Handle *Gallop(const Handle *begin, const Handle *end,
+                            Handle value) {
+  int step = 1;
+  const Handle *lo = begin;
+  const Handle *hi = begin;
+  while (hi < end && hi->raw() < value.raw()) {
+    lo = hi + 1;
+    hi = step < end - hi ? hi + step : end;
+    step *= 2;
+  }
+  return std::lower_bound(lo, hi, value, [](Handle a, Handle b) {
+    return a.raw() < b.raw();
+  });
+}
+
+RoleIndex::RoleIndex(const Store *store) : store_(store) {
+  // Handles in a store are only stable after it has been frozen.
+  CHECK(store->frozen());
+}
+
+void RoleIndex::Build(const std::vector<Handle> &roles) {
+  // Collect all (role, value, frame) triples. Strings with the same
+  // fingerprint but different contents are kept apart by comparing the
+  // contents when the value keys are equal.
+  const Store *store = store_;
+  auto content = [store](Handle text) {
+    return text.IsNil() ? Text() : store->GetString(text)->str();
+  };
+  struct Posting {
+    uint64 value;
+    Handle role;
+    Handle text;
+    Handle frame;
+  };
+  auto less = [&content](const Posting &a, const Posting &b) {
+    if (a.role.raw() != b.role.raw()) return a.role.raw() < b.role.raw();
+    if (a.value != b.value) return a.value < b.value;
+    if (a.text != b.text) {
+      int c = content(a.text).compare(content(b.text));
+      if (c != 0) return c < 0;
+    }
+    return a.frame.raw() < b.frame.raw();
+  };
+  auto same = [&content](const Posting &a, const Posting &b) {
+    return a.role == b.role && a.value == b.value &&
+           (a.text == b.text || content(a.text) == content(b.text));
+  };
+  std::vector<Posting> postings;
+  Store::Iterator it(store_);
+  const Datum *object;
+  while ((object = it.next()) != nullptr) {
+    if (!object->IsFrame()) continue;
+    const FrameDatum *frame = object->AsFrame();
+    if (frame->IsProxy()) continue;
+    for (const Slot *s = frame->begin(); s < frame->end(); ++s) {
+      if (s->name.IsId()) continue;
+      if (!roles.empty() &&
+          std::find(roles.begin(), roles.end(), s->name) == roles.end()) {
+        continue;
+      }
+      Handle text = IsString(s->value) ? s->value : Handle::nil();
+      postings.push_back({ValueKey(s->value), s->name, text, frame->self});
+    }
+  }
+  std::sort(postings.begin(), postings.end(), less);
+  postings.erase(std::unique(postings.begin(), postings.end(),
+                             [&same](const Posting &a, const Posting &b) {
+                               return same(a, b) && a.frame == b.frame;
+                             }),
+                 postings.end());
+
+  // Build index entries and posting lists.
+  entries_.clear();
+  postings_.clear();
+  postings_.reserve(postings.size());
+  for (int i = 0; i < postings.size(); ++i) {
+    const Posting &p = postings[i];
+    if (i == 0 || !same(postings[i - 1], p)) {
+      uint32 begin = postings_.size();
+      entries_.push_back({p.value, p.role, p.text, begin, begin});
+    }
+    postings_.push_back(p.frame);
+    entries_.back().end = postings_.size();
+  }
+  VLOG(1) << entries_.size() << " role index keys, "
+          << postings_.size() << " postings";
+}
+
+Status RoleIndex::Save(const string &filename) const {
+  RoleIndexHeader header;
+  memset(&header, 0, sizeof(header));
+  header.magic = kRoleIndexMagic;
+  header.version = kRoleIndexVersion;
+  header.num_handles = NumHandles(store_);
+  header.num_entries = entries_.size();
+  header.num_postings = postings_.size();
+  header.handle_size = sizeof(Handle);
+
+  FILE *f = fopen(filename.c_str(), "w");
+  if (f == nullptr) return Status(errno, filename.c_str(), strerror(errno));
+  bool ok = fwrite(&header, sizeof(header), 1, f) == 1;
+  ok = ok && fwrite(entries_.data(), sizeof(Entry), entries_.size(), f) ==
+             entries_.size();
+  ok = ok && fwrite(postings_.data(), sizeof(Handle), postings_.size(), f) ==
+             postings_.size();
+  if (fclose(f) != 0) ok = false;
+  if (!ok) return Status(EIO, filename.c_str(), "Error writing role index");
+
+  return Status::OK;
+}
+
+Status RoleIndex::Load(const string &filename) {
+  FILE *f = fopen(filename.c_str(), "r");
+  if (f == nullptr) return Status(errno, filename.c_str(), strerror(errno));
+  RoleIndexHeader header;
+  bool ok = fread(&header, sizeof(header), 1, f) == 1;
+  if (!ok || header.magic != kRoleIndexMagic ||
+      header.version != kRoleIndexVersion ||
+      header.handle_size != sizeof(Handle)) {
+    fclose(f);
+    return Status(EINVAL, filename.c_str(), "Not a role index");
+  }
+  if (header.num_handles != NumHandles(store_)) {
+    fclose(f);
+    return Status(EINVAL, filename.c_str(), "Role index is for another store");
+  }
+
+  entries_.resize(header.num_entries);
+  postings_.resize(header.num_postings);
+  ok = fread(entries_.data(), sizeof(Entry), entries_.size(), f) ==
+       entries_.size();
+  ok = ok && fread(postings_.data(), sizeof(Handle), postings_.size(), f) ==
+             postings_.size();
+  fclose(f);
+  if (!ok) {
+    entries_.clear();
+    postings_.clear();
+    return Status(EIO, filename.c_str(), "Error reading role index");
+  }
+
+  return Status::OK;
+}
+
+RoleIndex::Postings RoleIndex::Lookup(Handle role, Handle value) const {
+  if (IsString(value)) return FindString(role, store_->GetString(value)->str());
+  return Find(role, ValueKey(value));
+}
+
+RoleIndex::Postings RoleIndex::Lookup(Handle role, Text value) const {
+  return FindString(role, value);
+}
+
+void RoleIndex::Intersect(const std::vector<Postings> &lists,
+                          std::vector<Handle> *result) {
+  result->clear();
+  if (lists.empty()) return;
+
+  // Probe the other lists with the elements of the shortest list.
+  std::vector<Postings> order = lists;
+  std::sort(order.begin(), order.end(),
+            [](const Postings &a, const Postings &b) {
+              return a.size() < b.size();
+            });
+  if (order[0].empty()) return;
+  for (const Handle *h = order[0].begin; h < order[0].end; ++h) {
+    bool found = true;
+    for (int i = 1; i < order.size(); ++i) {
+      Postings &p = order[i];
+      p.begin = Gallop(p.begin, p.end, *h);
+      if (p.empty()) return;
+      if (*p.begin != *h) {
+        found = false;
+        break;
+      }
+    }
+    if (found) result->push_back(*h);
+  }
+}
+
+bool RoleIndex::IsString(Handle value) const {
+  return value.IsGlobalRef() && !value.IsNil() && store_->IsString(value);
+}
+
+uint64 RoleIndex::ValueKey(Handle value) const {
+  if (IsString(value)) return StringKey(store_->GetString(value)->str());
+  return value.raw();
+}
+
+uint64 RoleIndex::StringKey(Text str) {
+  return Fingerprint(str.data(), str.size()) | kStringKey;
+}
+
+RoleIndex::Postings RoleIndex::Find(Handle role, uint64 key) const {
+  Entry probe;
+  probe.role = role;
+  probe.value = key;
+  auto it = std::lower_bound(entries_.begin(), entries_.end(), probe);
+  if (it == entries_.end() || it->role != role || it->value != key) {
+    return Postings{nullptr, nullptr};
+  }
+  const Handle *base = postings_.data();
+  return Postings{base + it->begin, base + it->end};
+}
+
+RoleIndex::Postings RoleIndex::FindString(Handle role, Text str) const {
+  // Fingerprint collisions give several entries with the same key, so the
+  // contents of the string for each entry are checked.
+  Entry probe;
+  probe.role = role;
+  probe.value = StringKey(str);
+  auto it = std::lower_bound(entries_.begin(), entries_.end(), probe);
+  while (it != entries_.end() && it->role == role && it->value == probe.value) {
+    if (store_->GetString(it->text)->str() == str) {
+      const Handle *base = postings_.data();
+      return Postings{base + it->begin, base + it->end};
+    }
+    ++it;
+  }
+  return Postings{nullptr, nullptr};
+}
+
+}  // namespace sling
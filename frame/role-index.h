@@ -0,0 +1,129 @@
+// Copyright 2017 Google Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef FRAME_ROLE_INDEX_H_
+#define FRAME_ROLE_INDEX_H_
+
+#include <string>
+#include <vector>
+
+#include "base/macros.h"
+#include "base/port.h"
+#include "base/status.h"
+#include "base/types.h"
+#include "frame/store.h"
+#include "string/text.h"
+
+namespace sling {
+
+// Inverted index over the slots in a frozen store. The index maps (role, value)
+// pairs to posting lists with the frames that have a slot with this role and
+// value. Posting lists are sorted by handle, so the frames matching several
+// (role, value) pairs can be found by intersecting the posting lists. String
+// values are indexed by content, so all frames with a string value equal to a
+// given text can be looked up. Other values are indexed by handle.
+class RoleIndex {
+ public:
+  // Sorted list of frame handles for a (role, value) pair.
+  struct Postings {
+    int size() const { return end - begin; }
+    bool empty() const { return begin == end; }
+
+    const Handle *begin;
+    const Handle *end;
+  };
+
+  // Initializes empty index for frozen store.
+  explicit RoleIndex(const Store *store);
+
+  // Builds index for the slots in the store. If a list of roles is given, only
+  // slots with these roles are indexed. Otherwise all slots except id slots are
+  // indexed.
+  void Build(const std::vector<Handle> &roles = std::vector<Handle>());
+
+  // Saves index to file.
+  Status Save(const string &filename) const;
+
+  // Loads index from file. The index must have been built for the same store.
+  Status Load(const string &filename);
+
+  // Returns posting list with frames that have a slot with role and value.
+  Postings Lookup(Handle role, Handle value) const;
+
+  // Returns posting list with frames that have a slot with role and a string
+  // value equal to a text.
+  Postings Lookup(Handle role, Text value) const;
+
+  // Intersects posting lists and returns the frames that are in all the lists.
+  static void Intersect(const std::vector<Postings> &lists,
+                        std::vector<Handle> *result);
+
+  // Returns the number of (role, value) pairs in the index.
+  int num_keys() const { return entries_.size(); }
+
+  // Returns the total size of all the posting lists.
+  int num_postings() const { return postings_.size(); }
+
+ private:
+  // Index entry for (role, value) pair. The value key is the raw handle for
+  // the value, or a fingerprint of the contents for string values. For string
+  // values, the entry also keeps a handle to a string with the contents, so
+  // lookups can tell apart strings with the same fingerprint. Entries are
+  // written to index files as is.
+  struct Entry {
+    bool operator<(const Entry &other) const {
+      if (role.raw() != other.role.raw()) return role.raw() < other.role.raw();
+      return value < other.value;
+    }
+
+    uint64 value;  // value key
+    Handle role;   // slot role
+    Handle text;   // string with contents for string values, otherwise nil
+    uint32 begin;  // start of posting list
+    uint32 end;    // end of posting list
+  } PACKED;
+  static_assert(sizeof(Entry) == 16 + 2 * sizeof(Handle),
+                "Unexpected role index entry size");
+
+  // Checks if value is a string in the indexed store.
+  bool IsString(Handle value) const;
+
+  // Returns the value key for a value in the store.
+  uint64 ValueKey(Handle value) const;
+
+  // Returns the value key for a string value.
+  static uint64 StringKey(Text str);
+
+  // Returns posting list for role and value key.
+  Postings Find(Handle role, uint64 key) const;
+
+  // Returns posting list for role and string value. Only entries for strings
+  // with the same contents as the text match.
+  Postings FindString(Handle role, Text str) const;
+
+  // Store for index.
+  const Store *store_;
+
+  // Index entries sorted by role and value key.
+  std::vector<Entry> entries_;
+
+  // Posting lists for all entries.
+  std::vector<Handle> postings_;
+
+  DISALLOW_COPY_AND_ASSIGN(RoleIndex);
+};
+
+}  // namespace sling
+
+#endif  // FRAME_ROLE_INDEX_H_
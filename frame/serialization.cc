@@ -15,6 +15,7 @@
 #include "frame/serialization.h"
 
 #include "base/logging.h"
+#include "stream/file-input.h"
 
 namespace sling {
 
@@ -66,11 +67,19 @@ string Encode(const Object &object) {
 }
 
 void LoadStore(const string &filename, Store *store) {
-  FileDecoder decoder(store, filename);
+  FileInput input(filename);
+  Decoder decoder(store, &input);
   store->LockGC();
   decoder.DecodeAll();
   store->UnlockGC();
 }
 
+void SaveStore(const Store *store, const string &filename) {
+  FileEncoder encoder(store, filename);
+  encoder.encoder()->set_streaming(true);
+  encoder.EncodeAll();
+  CHECK(encoder.Close());
+}
+
 }  // namespace sling
 
@@ -338,6 +338,9 @@ string Encode(const Object &object);
 // Load store from file.
 void LoadStore(const string &filename, Store *store);
 
+// Save all frames in store to file using streaming encoding.
+void SaveStore(const Store *store, const string &filename);
+
 }  // namespace sling
 
 #endif  // FRAME_SERIALIZATION_H_
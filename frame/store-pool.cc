@@ -0,0 +1,60 @@
+// Copyright 2017 Google Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "frame/store-pool.h"
+
+#include "base/logging.h"
+
+namespace sling {
+
+StorePool::StorePool(const Store *globals, int max_free)
+    : globals_(globals), max_free_(max_free) {}
+
+StorePool::~StorePool() {
+  for (Store *store : free_) delete store;
+}
+
+Store *StorePool::Acquire() {
+  {
+    std::lock_guard<std::mutex> lock(mu_);
+    if (!free_.empty()) {
+      Store *store = free_.back();
+      free_.pop_back();
+      return store;
+    }
+  }
+  return new Store(globals_);
+}
+
+void StorePool::Release(Store *store) {
+  CHECK(store->globals() == globals_);
+
+  // Reset the store outside the lock, since only the caller has access to it.
+  store->Reset();
+  {
+    std::lock_guard<std::mutex> lock(mu_);
+    if (free_.size() < max_free_) {
+      free_.push_back(store);
+      return;
+    }
+  }
+  delete store;
+}
+
+int StorePool::num_free() {
+  std::lock_guard<std::mutex> lock(mu_);
+  return free_.size();
+}
+
+}  // namespace sling
@@ -0,0 +1,87 @@
+// Copyright 2017 Google Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef FRAME_STORE_POOL_H_
+#define FRAME_STORE_POOL_H_
+
+#include <mutex>
+#include <vector>
+
+#include "base/macros.h"
+#include "frame/store.h"
+
+namespace sling {
+
+// A store pool keeps a free list of local stores on top of a global store.
+// Stores returned to the pool are reset, so their heaps and handle tables can
+// be reused for the next request without allocating new memory. The pool can
+// be shared between threads.
+class StorePool {
+ public:
+  // Initializes pool for local stores on top of a frozen global store. At most
+  // max_free stores are kept in the free list.
+  explicit StorePool(const Store *globals, int max_free = 64);
+
+  // Deletes all the stores in the free list.
+  ~StorePool();
+
+  // Returns an empty local store from the pool. A new store is allocated if
+  // the pool is empty.
+  Store *Acquire();
+
+  // Resets store and returns it to the pool. All roots and external references
+  // to the store must have been released.
+  void Release(Store *store);
+
+  // Returns the number of stores in the free list.
+  int num_free();
+
+ private:
+  // Global store for local stores.
+  const Store *globals_;
+
+  // Maximum number of stores in the free list.
+  int max_free_;
+
+  // Free list of reset stores.
+  std::vector<Store *> free_;
+
+  // Mutex for serializing access to the free list.
+  std::mutex mu_;
+
+  DISALLOW_COPY_AND_ASSIGN(StorePool);
+};
+
+// Scoped local store from a store pool. The store is returned to the pool when
+// the scoped store goes out of scope.
+class PooledStore {
+ public:
+  explicit PooledStore(StorePool *pool)
+      : pool_(pool), store_(pool->Acquire()) {}
+  ~PooledStore() { pool_->Release(store_); }
+
+  // Access to the pooled store.
+  Store *store() const { return store_; }
+  Store *operator->() const { return store_; }
+
+ private:
+  StorePool *pool_;
+  Store *store_;
+
+  DISALLOW_COPY_AND_ASSIGN(PooledStore);
+};
+
+}  // namespace sling
+
+#endif  // FRAME_STORE_POOL_H_
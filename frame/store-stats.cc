@@ -0,0 +1,210 @@
+// Copyright 2017 Google Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "frame/store-stats.h"
+
+#include <cxxabi.h>
+#include <dlfcn.h>
+#include <stdlib.h>
+#include <algorithm>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include "string/printf.h"
+#include "string/strcat.h"
+
+namespace sling {
+
+// Maximum number of allocation call sites in output.
+static const int kMaxCallSites = 20;
+
+// Returns the (demangled) name of the function containing a code address.
+static string FunctionName(void *address) {
+  Dl_info info;
+  if (dladdr(address, &info) == 0 || info.dli_sname == nullptr) {
+    return StringPrintf("%p", address);
+  }
+  int status;
+  char *demangled = abi::__cxa_demangle(info.dli_sname, nullptr, nullptr,
+                                        &status);
+  if (demangled == nullptr) return info.dli_sname;
+  string name(demangled);
+  free(demangled);
+  return name;
+}
+
+// Returns a label for a bucket for power-of-two ranges, where bucket 0 is for
+// zero and bucket i is for the range 2^(i-1) to 2^i-1. The last bucket is open.
+static string BucketLabel(int bucket, int num_buckets) {
+  if (bucket == 0) return "0";
+  int low = 1 << (bucket - 1);
+  int high = (1 << bucket) - 1;
+  if (bucket == num_buckets - 1) return StrCat(low, "+");
+  if (low == high) return StrCat(low);
+  return StrCat(low, "-", high);
+}
+
+// Adds row with object statistics for an object type.
+static void AddObjectRow(const string &type,
+                         const MemoryUsage::ObjectStats &stats,
+                         TableWriter *writer) {
+  if (stats.count == 0) return;
+  writer->AddNamedRow(type);
+  writer->SetCell(type, 0, type);
+  writer->SetCell(type, 1, stats.count);
+  writer->SetCell(type, 2, stats.bytes);
+}
+
+// Adds object statistics for a category of heap objects to the totals.
+static void AddStats(const MemoryUsage::ObjectStats &stats,
+                     MemoryUsage::ObjectStats *totals) {
+  totals->count += stats.count;
+  totals->bytes += stats.bytes;
+}
+
+void AddObjectStats(const Store &store, MemoryUsage *totals) {
+  MemoryUsage usage;
+  store.GetMemoryUsage(&usage);
+
+  // Only the used heap bytes and handles are added up, since the memory
+  // allocated for the heaps and the handle table is kept when the store is
+  // reset.
+  totals->total_heap_size += usage.used_heap_bytes();
+  totals->num_handles += usage.used_handles();
+  totals->num_bound_symbols += usage.num_bound_symbols;
+  totals->num_unbound_symbols += usage.num_unbound_symbols;
+  totals->num_proxy_symbols += usage.num_proxy_symbols;
+
+  for (int i = 0; i < MemoryUsage::kFrameBuckets; ++i) {
+    AddStats(usage.frames[i], &totals->frames[i]);
+  }
+  AddStats(usage.proxies, &totals->proxies);
+  AddStats(usage.strings, &totals->strings);
+  AddStats(usage.arrays, &totals->arrays);
+  AddStats(usage.symbols, &totals->symbols);
+  AddStats(usage.indexes, &totals->indexes);
+  AddStats(usage.invalid, &totals->invalid);
+}
+
+void WriteStoreStats(const Store &store, const string &name,
+                     TableWriter *writer, const MemoryUsage *objects) {
+  MemoryUsage usage;
+  store.GetMemoryUsage(&usage);
+  if (objects == nullptr) objects = &usage;
+
+  // Memory usage.
+  writer->StartTable(StrCat(name, " memory usage"));
+  writer->SetColumns({"Metric", "Value"});
+  writer->AddRow("Heaps", usage.num_heaps);
+  writer->AddRow("Heap bytes", usage.total_heap_size);
+  writer->AddRow("Used heap bytes", objects->used_heap_bytes());
+  writer->AddRow("Handles", usage.num_handles);
+  writer->AddRow("Used handles", objects->used_handles());
+  writer->AddRow("Symbols", objects->num_symbols());
+  writer->AddRow("Nursery bytes", usage.nursery_size);
+  writer->AddRow("GCs", usage.num_gcs);
+  writer->AddRow("Nursery GCs", usage.num_minor_gcs);
+  writer->AddRow("GC time (us)", usage.gc_time);
+  writer->AddRow("Mark time (us)", usage.mark_time);
+  writer->AddRow("Compact time (us)", usage.compact_time);
+  writer->AddRow("Promote time (us)", usage.promote_time);
+  writer->AddRow("Promoted bytes", usage.promoted_bytes);
+  writer->AddRow("Remembered objects", usage.num_remembered);
+
+  // Objects by type.
+  writer->StartTable(StrCat(name, " objects"));
+  writer->SetColumns({"Type", "Count", "Bytes"});
+  for (int i = 0; i < MemoryUsage::kFrameBuckets; ++i) {
+    string label = StrCat("frames with ",
+                          BucketLabel(i, MemoryUsage::kFrameBuckets),
+                          " slots");
+    AddObjectRow(label, objects->frames[i], writer);
+  }
+  AddObjectRow("proxies", objects->proxies, writer);
+  AddObjectRow("strings", objects->strings, writer);
+  AddObjectRow("arrays", objects->arrays, writer);
+  AddObjectRow("symbols", objects->symbols, writer);
+  AddObjectRow("slot indexes", objects->indexes, writer);
+  AddObjectRow("invalid", objects->invalid, writer);
+
+  // Garbage collection pauses.
+  writer->StartTable(StrCat(name, " GC pauses"));
+  writer->SetColumns({"Pause (us)", "Count"});
+  for (int i = 0; i < MemoryUsage::kPauseBuckets; ++i) {
+    if (usage.gc_pauses[i] == 0) continue;
+    string label = BucketLabel(i, MemoryUsage::kPauseBuckets);
+    writer->AddNamedRow(label);
+    writer->SetCell(label, 0, label);
+    writer->SetCell(label, 1, usage.gc_pauses[i]);
+  }
+
+  // Allocation call sites. Functions inside the store are skipped, so the call
+  // site is the first function outside the store followed by its caller.
+  // Samples with the same call site are merged.
+  std::vector<AllocationSample> samples;
+  store.GetAllocationSamples(&samples);
+  if (samples.empty()) return;
+  std::vector<std::pair<string, MemoryUsage::ObjectStats>> sites;
+  std::unordered_map<string, int> site_index;
+  for (const AllocationSample &sample : samples) {
+    string site;
+    int shown = 0;
+    for (int d = 0; d < sample.depth && shown < 2; ++d) {
+      string function = FunctionName(sample.stack[d]);
+      if (shown == 0 && function.compare(0, 14, "sling::Store::") == 0) {
+        continue;
+      }
+      if (shown > 0) site.append(" < ");
+      site.append(function);
+      shown++;
+    }
+    auto f = site_index.find(site);
+    if (f == site_index.end()) {
+      site_index[site] = sites.size();
+      sites.emplace_back(site, MemoryUsage::ObjectStats{0, 0});
+      f = site_index.find(site);
+    }
+    sites[f->second].second.count += sample.count;
+    sites[f->second].second.bytes += sample.bytes;
+  }
+  std::sort(sites.begin(), sites.end(),
+            [](const std::pair<string, MemoryUsage::ObjectStats> &a,
+               const std::pair<string, MemoryUsage::ObjectStats> &b) {
+              return a.second.bytes > b.second.bytes;
+            });
+
+  writer->StartTable(StrCat(name, " allocation sites"));
+  writer->SetColumns({"Call site", "Samples", "Bytes"});
+  for (int i = 0; i < sites.size() && i < kMaxCallSites; ++i) {
+    writer->SetCell(i, 0, sites[i].first);
+    writer->SetCell(i, 1, sites[i].second.count);
+    writer->SetCell(i, 2, sites[i].second.bytes);
+  }
+}
+
+void WriteSymbolCacheStats(const SymbolCache &cache, const string &name,
+                           TableWriter *writer) {
+  int64 lookups = cache.hits() + cache.misses();
+  writer->StartTable(StrCat(name, " symbol cache"));
+  writer->SetColumns({"Metric", "Value"});
+  writer->AddRow("Symbols", cache.size());
+  writer->AddRow("Hits", cache.hits());
+  writer->AddRow("Misses", cache.misses());
+  writer->AddRow("Hit rate (%)",
+                 lookups == 0 ? 0.0f : cache.hits() * 100.0f / lookups);
+}
+
+}  // namespace sling
@@ -0,0 +1,49 @@
+// Copyright 2017 Google Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef FRAME_STORE_STATS_H_
+#define FRAME_STORE_STATS_H_
+
+#include <string>
+
+#include "base/types.h"
+#include "frame/store.h"
+#include "frame/symbol-cache.h"
+#include "util/table-writer.h"
+
+namespace sling {
+
+// Outputs memory usage, object type, and garbage collection statistics for a
+// store as tables with the store name as prefix. The sampled allocation call
+// sites are also output if allocation sampling is enabled for the store. If
+// object totals are given, these are used for the object statistics instead of
+// the objects currently in the store. This is used for stores that are reset
+// and reused, since they are empty when the statistics are output.
+void WriteStoreStats(const Store &store, const string &name,
+                     TableWriter *writer,
+                     const MemoryUsage *objects = nullptr);
+
+// Adds the heap, handle, symbol, and object statistics for the objects in a
+// store to the totals. This should be called before the store is reset. The
+// totals must be zero-initialized before the first call.
+void AddObjectStats(const Store &store, MemoryUsage *totals);
+
+// Outputs size and hit rate for a symbol cache as a table with the cache name
+// as prefix.
+void WriteSymbolCacheStats(const SymbolCache &cache, const string &name,
+                           TableWriter *writer);
+
+}  // namespace sling
+
+#endif  // FRAME_STORE_STATS_H_
@@ -14,20 +14,70 @@
 
 #include "frame/store.h"
 
+#include <errno.h>
+#include <execinfo.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <immintrin.h>
+#include <algorithm>
+#include <atomic>
+#include <mutex>
 #include <string>
+#include <thread>
+#include <vector>
 
 #include "base/clock.h"
 #include "base/logging.h"
 #include "string/strcat.h"
 #include "string/text.h"
+#include "third_party/jit/cpu.h"
 #include "util/city.h"
+#include "util/worker-pool.h"
 
 namespace sling {
 
+// Minimum number of bytes in the heaps for marking in parallel. Smaller stores
+// are marked by the calling thread, since the cost of starting the marking
+// threads would exceed the gain.
+static const int64 kMinParallelMarkBytes = 16 << 20;
+
+// Maximum number of handles in a range on a parallel marking stack.
+static const int kMarkChunk = 1024;
+
+// Minimum number of ranges on the private marking stack of a parallel marking
+// thread before some of them are shared with idle threads.
+static const int kMarkShareThreshold = 16;
+
 // Initial heap with standard symbols.
 // NB: This table depends on internal object layout, heap alignment, symbol
 // hashing and pre-defined handle values. Please take this into consideration
 // when making changes to this table.
+#ifdef SLING_WIDE_HANDLES
+static const Word kInitialHeap[] = {
+  // id frame
+  FRAME | NAMED  | 16, 0x08, 0x08, 0x20,
+  // isa frame
+  FRAME | NAMED  | 16, 0x10, 0x08, 0x28,
+  // is frame
+  FRAME | NAMED  | 16, 0x18, 0x08, 0x30,
+  // id symbol
+  SYMBOL         | 24, 0x20, 0x9fc5c532, 0x38, 0x08,
+  // isa symbol
+  SYMBOL         | 24, 0x28, 0xf847db0a, 0x40, 0x10,
+  // is symbol
+  SYMBOL         | 24, 0x30, 0x4d55c812, 0x48, 0x18,
+  // "id" string
+  STRING         |  2, 0x38, 'i' | ('d' << 8),
+  // "isa" string
+  STRING         |  3, 0x40, 'i' | ('s' << 8) | ('a' << 16),
+  // "is" string
+  STRING         |  2, 0x48, 'i' | ('s' << 8),
+};
+#else
 static const Word kInitialHeap[] = {
   // id frame
   FRAME | NAMED  |  8, 0x08, 0x08, 0x20,
@@ -36,11 +86,11 @@ static const Word kInitialHeap[] = {
   // is frame
   FRAME | NAMED  |  8, 0x18, 0x08, 0x30,
   // id symbol
-  SYMBOL         | 16, 0x20, 0x9fc5c532, 0, 0x38, 0x08,
+  SYMBOL         | 12, 0x20, 0x9fc5c532, 0x38, 0x08, 0,
   // isa symbol
-  SYMBOL         | 16, 0x28, 0xf847db0a, 0, 0x40, 0x10,
+  SYMBOL         | 12, 0x28, 0xf847db0a, 0x40, 0x10, 0,
   // is symbol
-  SYMBOL         | 16, 0x30, 0x4d55c812, 0, 0x48, 0x18,
+  SYMBOL         | 12, 0x30, 0x4d55c812, 0x48, 0x18, 0,
   // "id" string
   STRING         |  2, 0x38, 'i' | ('d' << 8), 0,
   // "isa" string
@@ -48,15 +98,126 @@ static const Word kInitialHeap[] = {
   // "is" string
   STRING         |  2, 0x48, 'i' | ('s' << 8), 0,
 };
+#endif
 
 // Default store options.
 const Store::Options Store::kDefaultOptions;
 
+// A store snapshot file starts with a header followed by the heap and the
+// handle table. The heap is page-aligned in the file so it can be mapped
+// directly into memory. The handle table contains object pointers relative to
+// the preferred mapping address for the snapshot. If the snapshot cannot be
+// mapped at this address, the handle table is relocated when it is loaded.
+// The size and modification time of the file the store was loaded from are
+// recorded, so stale snapshots can be detected when the source is rebuilt.
+// Snapshots can only be loaded by stores with the same handle size.
+struct SnapshotHeader {
+  uint32 magic;            // magic number for identifying snapshot files
+  uint32 version;          // snapshot format version
+  uint64 base;             // preferred mapping address for snapshot
+  uint64 heap_offset;      // file offset of heap
+  uint64 heap_size;        // size of heap in bytes
+  uint64 handles_offset;   // file offset of handle table
+  uint64 handles_size;     // size of handle table in bytes
+  uint64 symbols;          // handle for symbol table
+  int64 num_dead_handles;  // number of dead handles in handle table
+  int32 num_symbols;       // number of symbols in symbol table
+  int32 num_buckets;       // number of buckets in symbol table
+  int32 handle_size;       // size of handles in bytes
+  uint64 source_size;      // size of source file, or zero if unknown
+  int64 source_mtime;      // modification time of source file
+};
+
+static const uint32 kSnapshotMagic = 0x50414e53;  // "SNAP"
+static const uint32 kSnapshotVersion = 4;
+static const uint64 kSnapshotBase = 0x200000000000;
+static const uint64 kSnapshotPageSize = 4096;
+
+// Value used for trapping dereferencing of nil handles.
+static const uint64 kNilTrap = 0xdeadbeefdeadbeef;
+
+// Maximum number of entries in a symbol table segment. This keeps the symbol
+// maps well below the maximum object size.
+static const int kMaxMapCapacity = 1 << 24;
+
+// Maximum number of hash bits for selecting symbol table segment. Together
+// with the bits for the map buckets, this covers all 30 bits of the hash.
+static const int kMaxSegmentBits = 6;
+
+// Maximum size of handle table. Handles are 32-bit byte offsets into the handle
+// table, so each pool can hold at most 2^29 objects. Growing the table beyond
+// this would silently produce handles that wrap around to other objects. Wide
+// handles have no practical limit, so the table is only bounded by memory.
+#ifdef SLING_WIDE_HANDLES
+static const size_t kMaxHandleTableSize = 1ULL << 48;
+#else
+static const size_t kMaxHandleTableSize = 1ULL << 32;
+#endif
+
+// Returns the power of two symbol map capacity for a requested number of
+// entries.
+static int MapCapacity(int entries) {
+  int capacity = 1;
+  while (capacity < entries && capacity < kMaxMapCapacity) capacity <<= 1;
+  return capacity;
+}
+
 // Use city hash to compute hash values for strings.
 static inline uint64 HashBytes(const void *ptr, size_t len) {
   return CityHash64(reinterpret_cast<const char *>(ptr), len);
 }
 
+// Scans slots for name one slot at a time.
+static const Slot *ScanSlotsGeneric(const Slot *begin, const Slot *end,
+                                    Handle name) {
+  for (const Slot *slot = begin; slot < end; ++slot) {
+    if (slot->name == name) return slot;
+  }
+  return nullptr;
+}
+
+// Scans slots for name using AVX2. Each 256-bit vector holds four slots, and
+// the name lanes of the comparison mask are the even bits of the mask.
+__attribute__((target("avx2")))
+static const Slot *ScanSlotsAVX2(const Slot *begin, const Slot *end,
+                                 Handle name) {
+  const __m256i key = _mm256_set1_epi32(name.raw());
+  const Slot *slot = begin;
+  while (slot + 8 <= end) {
+    __m256i v0 = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(slot));
+    __m256i v1 =
+        _mm256_loadu_si256(reinterpret_cast<const __m256i *>(slot + 4));
+    int m0 = _mm256_movemask_ps(
+        _mm256_castsi256_ps(_mm256_cmpeq_epi32(v0, key))) & 0x55;
+    int m1 = _mm256_movemask_ps(
+        _mm256_castsi256_ps(_mm256_cmpeq_epi32(v1, key))) & 0x55;
+    int mask = m0 | (m1 << 8);
+    if (mask != 0) return slot + (__builtin_ctz(mask) >> 1);
+    slot += 8;
+  }
+  if (slot + 4 <= end) {
+    __m256i v = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(slot));
+    int mask = _mm256_movemask_ps(
+        _mm256_castsi256_ps(_mm256_cmpeq_epi32(v, key))) & 0x55;
+    if (mask != 0) return slot + (__builtin_ctz(mask) >> 1);
+    slot += 4;
+  }
+  return ScanSlotsGeneric(slot, end, name);
+}
+
+// Selects slot scanner from the CPU features when the program is initialized.
+// Frames used by earlier static initializers are scanned with the generic
+// scanner, and the scanner is never changed after initialization. The AVX2
+// scanner compares 32-bit handles, so wide handles use the generic scanner.
+SlotScanner ScanSlots = ScanSlotsGeneric;
+static struct SlotScannerSelector {
+  SlotScannerSelector() {
+    if (sizeof(Handle) == 4 && jit::CPU::Enabled(jit::AVX2)) {
+      ScanSlots = ScanSlotsAVX2;
+    }
+  }
+} slot_scanner_selector;
+
 void Region::reserve(size_t bytes) {
   size_t used = size();
   DCHECK_LE(used, bytes);
@@ -109,6 +270,11 @@ Store::Store(const Options *options) : options_(options) {
   heap->reserve(options_->initial_heap_size);
   first_heap_ = last_heap_ = current_heap_ = heap;
 
+  // Sample allocations if requested.
+  if (options_->allocation_sampling > 0) {
+    sample_countdown_ = options_->allocation_sampling;
+  }
+
   // The symbol table will be allocated later.
   symbols_ = Handle::nil();
 
@@ -125,7 +291,7 @@ Store::Store(const Options *options) : options_(options) {
   // Reserve the first global handle for the nil value. This is initialized
   // to point to an invalid memory location to trap any attempt at dereferencing
   // a nil handle.
-  handles_.push()->bits = 0xdeadbeefdeadbeef;
+  handles_.push()->bits = kNilTrap;
 
   // Allocate standard heap objects.
   LockGC();
@@ -139,15 +305,14 @@ Store::Store(const Options *options) : options_(options) {
   }
 
   // Allocate symbol table.
-  num_buckets_ = options_->map_buckets;
-  symbols_ = AllocateArray(num_buckets_);
-  roots_.handle_ = symbols_;
+  InitSymbolTable();
 
   // Insert standard symbols into symbol table.
   for (Datum *datum = begin; datum < end; datum = datum->next()) {
     if (datum->IsSymbol()) InsertSymbol(datum->AsSymbol());
   }
   UnlockGC();
+  ArmSampling();
 }
 
 Store::Store(const Store *globals) : globals_(globals) {
@@ -162,6 +327,11 @@ Store::Store(const Store *globals) : globals_(globals) {
   heap->reserve(options_->initial_heap_size);
   first_heap_ = last_heap_ = current_heap_ = heap;
 
+  // Sample allocations if requested.
+  if (options_->allocation_sampling > 0) {
+    sample_countdown_ = options_->allocation_sampling;
+  }
+
   // Initialize handle table.
   handles_.reserve(options_->initial_handles);
   free_handle_ = nullptr;
@@ -171,10 +341,84 @@ Store::Store(const Store *globals) : globals_(globals) {
   pools_[Handle::kGlobal] = globals_->pools_[Handle::kGlobal];
   pools_[Handle::kLocal] = reinterpret_cast<Address>(handles_.base());
 
+  // Allocate nursery. The nursery is linked into the heap list after the
+  // initial heap, and new objects are allocated from the nursery.
+  if (options_->nursery_size > 0) {
+    nursery_ = new Heap();
+    nursery_->reserve(options_->nursery_size);
+    heap->set_next(nursery_);
+    tenured_heap_ = heap;
+    current_heap_ = nursery_;
+    tenured_limit_ = 2 * options_->initial_heap_size;
+  }
+
   // Allocate symbol map.
-  num_buckets_ = options_->map_buckets;
-  symbols_ = AllocateArray(num_buckets_);
+  InitSymbolTable();
+  ArmSampling();
+}
+
+Store::Store(const Options *options, const string &snapshot)
+    : options_(options) {
+  // Open snapshot file and read header.
+  int fd = open(snapshot.c_str(), O_RDONLY);
+  CHECK(fd != -1) << snapshot << ": " << strerror(errno);
+  SnapshotHeader header;
+  CHECK_EQ(pread(fd, &header, sizeof(header), 0), sizeof(header)) << snapshot;
+  CHECK_EQ(header.magic, kSnapshotMagic) << "Not a snapshot: " << snapshot;
+  CHECK_EQ(header.version, kSnapshotVersion) << snapshot;
+  CHECK_EQ(header.handle_size, sizeof(Handle)) << snapshot;
+
+  // Map snapshot into memory, preferably at the address used for the handle
+  // table in the snapshot.
+  mapping_size_ = header.handles_offset + header.handles_size;
+  mapping_ = mmap(reinterpret_cast<void *>(header.base), mapping_size_,
+                  PROT_READ, MAP_SHARED, fd, 0);
+  CHECK(mapping_ != MAP_FAILED) << snapshot << ": " << strerror(errno);
+  close(fd);
+  Address image = static_cast<Address>(mapping_);
+
+  // The mapped heap is full, so all allocations will go through the slow path
+  // where allocation in a frozen store is trapped.
+  Heap *heap = new Heap();
+  heap->attach(image + header.heap_offset, header.heap_size);
+  first_heap_ = last_heap_ = current_heap_ = heap;
+
+  // Use the handle table in the snapshot directly if it has been mapped at
+  // the preferred address. Otherwise, make a relocated copy of it.
+  Address table = image + header.handles_offset;
+  if (image == reinterpret_cast<Address>(header.base)) {
+    handles_.attach(table, header.handles_size);
+  } else {
+    int64 delta = image - reinterpret_cast<Address>(header.base);
+    size_t size = header.handles_size / sizeof(Reference);
+    handles_.reserve(header.handles_size);
+    Reference *src = reinterpret_cast<Reference *>(table);
+    Reference *dst = handles_.add(size);
+    dst[0].bits = kNilTrap;
+    for (size_t i = 1; i < size; ++i) {
+      dst[i].bits = src[i].bits == 0 ? 0 : src[i].bits + delta;
+    }
+    VLOG(1) << "Snapshot " << snapshot << " relocated by " << delta;
+  }
+  free_handle_ = nullptr;
+
+  // Set up pools.
+  globals_ = nullptr;
+  store_tag_ = Handle::kGlobalTag;
+  pools_[Handle::kGlobal] = reinterpret_cast<Address>(handles_.base());
+  pools_[Handle::kLocal] = nullptr;
+
+  // Set up symbol table.
+  symbols_ = Handle{static_cast<Word>(header.symbols)};
+  num_symbols_ = header.num_symbols;
+  num_buckets_ = header.num_buckets;
+  num_dead_handles_ = header.num_dead_handles;
   roots_.handle_ = symbols_;
+  int segments = GetArray(symbols_)->length();
+  while ((1 << segment_bits_) < segments) segment_bits_++;
+
+  // Snapshots are always frozen.
+  frozen_ = true;
 }
 
 Store::~Store() {
@@ -183,6 +427,26 @@ Store::~Store() {
   roots_.Unlink();
   externals_.Unlink();
 
+  // Release parent store for fork.
+  if (parent_ != nullptr) {
+    parent_->forks_--;
+    parent_->UnlockGC();
+  }
+
+  // Detach memory-mapped heap and handle table from snapshot.
+  if (mapping_ != nullptr) {
+    Address image = static_cast<Address>(mapping_);
+    first_heap_->detach();
+    Address table = reinterpret_cast<Address>(handles_.base());
+    if (table >= image && table < image + mapping_size_) {
+      handles_.detach();
+    }
+    munmap(mapping_, mapping_size_);
+  }
+
+  // Stop worker threads for parallel marking.
+  delete mark_pool_;
+
   // Delete all object heaps.
   Heap *heap = first_heap_;
   while (heap != nullptr) {
@@ -192,6 +456,196 @@ Store::~Store() {
   }
 }
 
+void Store::Reset() {
+  // Only local stores can be reset.
+  CHECK(globals_ != nullptr);
+  CHECK(parent_ == nullptr) << "Forked stores cannot be reset";
+  CHECK_EQ(forks_, 0) << "Store has active forks";
+  CHECK(roots_.next_ == &roots_) << "Store has active roots";
+  CHECK(externals_.next_ == &externals_) << "Store has active externals";
+  CHECK_EQ(gc_locks_, 0);
+
+  // Clear all the heaps but keep the memory.
+  DisarmSampling();
+  for (Heap *heap = first_heap_; heap != nullptr; heap = heap->next()) {
+    heap->reset();
+  }
+  current_heap_ = first_heap_;
+  if (nursery_ != nullptr) {
+    tenured_heap_ = first_heap_;
+    current_heap_ = nursery_;
+    remembered_.reset();
+    tenured_limit_ = 2 * options_->initial_heap_size;
+  }
+
+  // Clear the handle table but keep the memory.
+  handles_.reset();
+  free_handle_ = nullptr;
+  num_dead_handles_ = 0;
+  gc_pending_ = false;
+
+  // Allocate new symbol table.
+  num_symbols_ = 0;
+  num_shadows_ = 0;
+  InitSymbolTable();
+  ArmSampling();
+}
+
+Store::Store(const Store *globals, Store *parent)
+    : globals_(globals), options_(parent->options_) {
+  // Allocate initial heap. Forked stores do not use a nursery.
+  Heap *heap = new Heap();
+  heap->reserve(options_->initial_heap_size);
+  first_heap_ = last_heap_ = current_heap_ = heap;
+
+  // Sample allocations if requested.
+  if (options_->allocation_sampling > 0) {
+    sample_countdown_ = options_->allocation_sampling;
+  }
+
+  // Initialize handle table with a copy of the handle table in the parent.
+  // Free handles in the parent are cleared since they cannot be used by the
+  // fork.
+  size_t size = parent->handles_.size();
+  size_t n = size / sizeof(Reference);
+  handles_.reserve(size + options_->initial_handles);
+  Reference *table = handles_.add(n);
+  memcpy(table, parent->handles_.base(), size);
+  Reference *base = parent->handles_.base();
+  for (Reference *r = parent->free_handle_; r != nullptr; r = r->next) {
+    table[r - base].object = nullptr;
+  }
+  free_handle_ = nullptr;
+
+  // Set up global and local pools.
+  store_tag_ = Handle::kLocalTag;
+  pools_[Handle::kGlobal] = globals_->pools_[Handle::kGlobal];
+  pools_[Handle::kLocal] = reinterpret_cast<Address>(handles_.base());
+
+  // All the inherited objects are initially shared with the parent.
+  parent_ = parent;
+  inherited_ = size;
+  shared_.assign(n, true);
+
+  // Allocate symbol map for new symbols in the fork.
+  InitSymbolTable();
+
+  // Objects in the parent must not move while it has forks.
+  parent->forks_++;
+  parent->LockGC();
+  ArmSampling();
+}
+
+Store *Store::Fork() {
+  // Only local stores can be forked.
+  CHECK(globals_ != nullptr);
+  CHECK(!frozen_);
+  return new Store(globals_, this);
+}
+
+void Store::Commit() {
+  Store *parent = parent_;
+  CHECK(parent != nullptr) << "Store is not a fork";
+  CHECK_EQ(parent->forks_, 1) << "Parent store has other forks";
+  CHECK(roots_.next_ == &roots_) << "Store has active roots";
+  CHECK(externals_.next_ == &externals_) << "Store has active externals";
+  CHECK_EQ(gc_locks_, 0);
+  CHECK_EQ(parent->handles_.size(), inherited_)
+      << "Parent store has been modified";
+
+  // Remove the sampling fence before the heaps are moved to the parent.
+  DisarmSampling();
+
+  // Collect the new symbols in the fork before the handle table is moved.
+  std::vector<Handle> symbols;
+  ArrayDatum *segments = GetArray(symbols_);
+  for (Handle *s = segments->begin(); s < segments->end(); ++s) {
+    MapDatum *map = GetMap(*s);
+    for (MapDatum::Entry *e = map->begin(); e < map->end(); ++e) {
+      if (!e->symbol.IsNil() && e->symbol.offset() >= inherited_) {
+        symbols.push_back(e->symbol);
+      }
+    }
+  }
+
+  // Update the inherited part of the handle table in the fork. Shared handles
+  // are taken from the parent, and the original objects for the handles that
+  // have been copied to the fork are discarded.
+  Reference *original = parent->handles_.base();
+  Reference *table = handles_.base();
+  size_t n = inherited_ / sizeof(Reference);
+  for (size_t i = 0; i < n; ++i) {
+    if (shared_[i]) {
+      table[i] = original[i];
+    } else if (i < parent->shared_.size() && parent->shared_[i]) {
+      parent->shared_[i] = false;
+    } else {
+      original[i].object->invalidate();
+    }
+  }
+
+  // Add the free handles in the parent to the free list of the fork.
+  Reference *fh = free_handle_;
+  for (Reference *r = parent->free_handle_; r != nullptr; r = r->next) {
+    Reference *ref = table + (r - original);
+    ref->next = fh;
+    fh = ref;
+  }
+
+  // Move the handle table from the fork to the parent.
+  parent->handles_.swap(&handles_);
+  parent->pools_[Handle::kLocal] = reinterpret_cast<Address>(table);
+  parent->free_handle_ = fh;
+  parent->num_dead_handles_ += num_dead_handles_;
+  free_handle_ = nullptr;
+
+  // Move the heaps from the fork to the parent. The heaps are inserted after
+  // the tenured heaps in the parent. If the parent has a nursery, all the
+  // moved objects are remembered since they can refer to objects in the
+  // nursery.
+  if (parent->nursery_ != nullptr) {
+    for (Heap *heap = first_heap_; heap != nullptr; heap = heap->next()) {
+      Datum *object = heap->base();
+      Datum *end = heap->end();
+      while (object < end) {
+        if (!object->IsInvalid() && !object->IsBinary()) {
+          *parent->remembered_.push() = object;
+        }
+        object = object->next();
+      }
+    }
+  }
+  last_heap_->set_next(parent->last_heap_->next());
+  parent->last_heap_->set_next(first_heap_);
+  parent->last_heap_ = last_heap_;
+  first_heap_ = last_heap_ = current_heap_ = nullptr;
+
+  // Add the new symbols to the symbol table in the parent.
+  for (Handle h : symbols) parent->InsertSymbol(parent->GetSymbol(h));
+  parent->num_shadows_ += num_shadows_;
+
+  // Release the parent.
+  parent_ = nullptr;
+  parent->forks_--;
+  parent->UnlockGC();
+}
+
+Datum *Store::CopyOnWrite(Handle handle) {
+  // The copy is allocated without garbage collection, so pointers to other
+  // objects held by the caller remain valid.
+  Datum *object = Deref(handle);
+  DCHECK(!object->IsFrame() || !object->AsFrame()->IsIndexed());
+  Word size = object->size();
+  gc_locks_++;
+  Datum *copy = AllocateDatum(object->typebits(), size);
+  gc_locks_--;
+  memcpy(copy->payload(), object->payload(), size);
+
+  // Replace the shared object with the copy in the fork.
+  Replace(handle, copy);
+  return copy;
+}
+
 Handle Store::AllocateString(Word size) {
   StringDatum *object = AllocateDatum(STRING, size)->AsString();
   return AllocateHandle(object);
@@ -270,7 +724,7 @@ Handle Store::AllocateFrame(Slot *begin, Slot *end, Handle original) {
       if (slot->name.IsId()) {
         // Unbind symbol from the existing frame.
         DCHECK(slot->value.IsRef());
-        Datum *id = Deref(slot->value);
+        Datum *id = Mutable(slot->value);
         DCHECK(id->IsSymbol());
         SymbolDatum *symbol = id->AsSymbol();
         DCHECK_EQ(symbol->value.raw(), handle.raw());
@@ -287,7 +741,7 @@ Handle Store::AllocateFrame(Slot *begin, Slot *end, Handle original) {
       if (!slot->name.IsId()) continue;
       ids--;
       CHECK(slot->value.IsRef());
-      Datum *id = Deref(slot->value);
+      Datum *id = Mutable(slot->value);
       if (id->IsSymbol()) {
         // Make sure the symbol is not already bound to another frame.
         SymbolDatum *symbol = id->AsSymbol();
@@ -300,6 +754,7 @@ Handle Store::AllocateFrame(Slot *begin, Slot *end, Handle original) {
 
         // Bind symbol to frame.
         symbol->value = handle;
+        WriteBarrier(symbol);
         frame->AddFlags(NAMED);
       } else if (id->IsProxy()) {
         // This proxy is not the one used for replacement, because otherwise the
@@ -327,12 +782,59 @@ Handle Store::AllocateFrame(Word slots) {
   return AllocateHandle(frame);
 }
 
+void Store::AllocateFrames(const Slot *slots, const int *sizes, int count,
+                           Handle *frames) {
+  if (count == 0) return;
+
+  // Compute the heap space needed for all the frames.
+  size_t bytes = 0;
+  for (int i = 0; i < count; ++i) {
+    bytes += Align(sizeof(Datum) + sizes[i] * sizeof(Slot));
+  }
+  CHECK_LE(bytes - sizeof(Datum), kSizeMask) << "Frame batch too big";
+
+  // Allocate one block for all the frames. The block is then split into the
+  // individual frames, so the frames tile the block exactly.
+  Address block = reinterpret_cast<Address>(
+      AllocateDatum(FRAME, bytes - sizeof(Datum)));
+
+  // Make room in the handle table for the new frames, so the handle table is
+  // expanded at most once.
+  size_t needed = handles_.size() + count * sizeof(Reference);
+  if (needed > handles_.capacity()) {
+    CHECK_LE(needed, kMaxHandleTableSize) << "Handle table full";
+    size_t capacity = handles_.capacity();
+    while (capacity < needed) capacity *= 2;
+    handles_.reserve(std::min(capacity, kMaxHandleTableSize));
+    pools_[store_tag_] = reinterpret_cast<Address>(handles_.base());
+  }
+
+  // Fill in frames and allocate handles for them.
+  const Slot *s = slots;
+  for (int i = 0; i < count; ++i) {
+    Word size = sizes[i] * sizeof(Slot);
+    FrameDatum *frame = reinterpret_cast<FrameDatum *>(block);
+    frame->info = size | FRAME;
+    memcpy(frame->begin(), s, size);
+    DCHECK(frame->get(Handle::id()).IsNil());
+    frames[i] = AllocateHandle(frame);
+
+    // Frames in the tenured heaps can refer to objects in the nursery, so they
+    // must be remembered. The first frame in the block has already been
+    // remembered by the allocator.
+    if (i > 0) WriteBarrier(frame);
+
+    block += Align(sizeof(Datum) + size);
+    s += sizes[i];
+  }
+}
+
 void Store::UpdateFrame(Handle handle, Slot *begin, Slot *end) {
   // Make sure that handle is owned by this store.
   CHECK(Owned(handle));
 
   // Make sure that the frame has the right number of slots.
-  FrameDatum *frame = GetFrame(handle);
+  FrameDatum *frame = Mutable(handle)->AsFrame();
   CHECK(frame->IsFrame());
   CHECK_EQ(end - begin, frame->end() - frame->begin());
 
@@ -341,6 +843,7 @@ void Store::UpdateFrame(Handle handle, Slot *begin, Slot *end) {
 
   // Copy new slots to the frame.
   Slot *t = frame->begin();
+  WriteBarrier(frame);
   for (Slot *s = begin; s < end; ++s, ++t) {
     // Get slot name and value.
     Handle name = s->name;
@@ -355,7 +858,7 @@ void Store::UpdateFrame(Handle handle, Slot *begin, Slot *end) {
       // The value of an id slot must be a symbol.
       DCHECK(!value.IsNil());
       DCHECK(value.IsRef());
-      Datum *id = Deref(value);
+      Datum *id = Mutable(value);
       DCHECK(id->IsSymbol());
       SymbolDatum *symbol = id->AsSymbol();
 
@@ -369,6 +872,7 @@ void Store::UpdateFrame(Handle handle, Slot *begin, Slot *end) {
 
       // Bind symbol to frame.
       symbol->value = handle;
+      WriteBarrier(symbol);
       frame->AddFlags(NAMED);
     }
   }
@@ -406,12 +910,18 @@ void Store::Set(Handle frame, Handle name, Handle value) {
   // Try to find slot with name.
   FrameDatum *datum = GetFrame(frame);
   CHECK(datum->IsFrame());
-  for (Slot *s = datum->begin(); s < datum->end(); ++s) {
-    if (s->name == name) {
-      // Update slot and return.
-      s->value = value;
-      return;
+  Slot *slot = datum->find(name);
+  if (slot != nullptr) {
+    // Update slot and return. Frames shared with the parent of a forked store
+    // are copied before they are updated.
+    if (IsShared(frame)) {
+      int index = slot - datum->begin();
+      datum = CopyOnWrite(frame)->AsFrame();
+      slot = datum->begin() + index;
     }
+    slot->value = value;
+    WriteBarrier(datum);
+    return;
   }
 
   // Slot not found. Allocate a new replacement frame with an additional slot.
@@ -523,7 +1033,6 @@ Handle Store::AllocateSymbol(Handle name, Handle hash) {
   // Allocate symbol object.
   SymbolDatum *symbol = AllocateDatum(SYMBOL, SymbolDatum::kSize)->AsSymbol();
   symbol->hash = hash;
-  symbol->next = Handle::nil();
   symbol->name = name;
   Handle sym = AllocateHandle(symbol);
   symbol->value = sym;
@@ -546,53 +1055,156 @@ Handle Store::AllocateSymbol(Text name, Handle hash) {
   return sym;
 }
 
+void Store::InitSymbolTable() {
+  LockGC();
+  num_buckets_ = MapCapacity(options_->map_buckets);
+  Handle map = AllocateHandle(AllocateMap(num_buckets_));
+  symbols_ = AllocateArray(&map, &map + 1);
+  roots_.handle_ = symbols_;
+  segment_bits_ = 0;
+  segment_symbols_.assign(1, 0);
+  UnlockGC();
+}
+
+MapDatum *Store::AllocateMap(Word capacity) {
+  Word size = capacity * sizeof(MapDatum::Entry);
+  MapDatum *map = AllocateDatum(ARRAY, size)->AsMap();
+  for (MapDatum::Entry *e = map->begin(); e < map->end(); ++e) {
+    e->hash = Handle::nil();
+    e->symbol = Handle::nil();
+  }
+  return map;
+}
+
 void Store::InsertSymbol(SymbolDatum *symbol) {
-  // Insert symbol in symbol table.
-  GetMap(symbols_)->insert(symbol);
+  // Insert symbol in symbol table segment.
+  int segment = SymbolSegment(symbol->hash);
+  Handle map = GetArray(symbols_)->get(segment);
+  MapDatum *symbols = GetMap(map);
+  symbols->insert(symbol->hash, symbol->self);
+  WriteBarrier(symbols);
   num_symbols_++;
 
-  // Resize symbol table if fill factor is more than 1:1.
-  if (num_symbols_ > num_buckets_) {
-    // Double the number of buckets.
-    num_buckets_ *= 2;
-
-    // Allocate new bucket array.
-    int size = num_buckets_ * sizeof(Handle);
-    MapDatum *map = AllocateDatum(ARRAY, size)->AsMap();
-    for (Handle *h = map->begin(); h < map->end(); ++h) *h = Handle::nil();
-
-    // Move all the symbols to the new symbol map.
-    MapDatum *symbols = GetMap(symbols_);
-    for (Handle *bucket = symbols->begin(); bucket < symbols->end(); ++bucket) {
-      Handle h = *bucket;
-      while (!h.IsNil()) {
-        SymbolDatum *symbol = GetSymbol(h);
-        Handle next = symbol->next;
-        map->insert(symbol);
-        h = next;
-      }
+  // Resize segment if fill factor is more than 3:4. Segments that have
+  // reached the maximum size are split instead.
+  int size = ++segment_symbols_[segment];
+  Word capacity = GetMap(map)->capacity();
+  if (size * 4 > capacity * 3) {
+    if (capacity < kMaxMapCapacity) {
+      GrowSymbolSegment(segment);
+    } else {
+      SplitSymbolTable();
     }
+  }
+}
 
-    // Replace the old symbol table with the new one.
-    Replace(symbols_, map);
+void Store::GrowSymbolSegment(int segment) {
+  // Allocate new map with double the number of entries.
+  Handle handle = GetArray(symbols_)->get(segment);
+  Word capacity = GetMap(handle)->capacity();
+  MapDatum *map = AllocateMap(capacity * 2);
+  num_buckets_ += capacity;
+
+  // Move all the symbols to the new symbol map. The hash values are stored
+  // in the entries, so the symbols themselves are not accessed.
+  MapDatum *symbols = GetMap(handle);
+  for (MapDatum::Entry *e = symbols->begin(); e < symbols->end(); ++e) {
+    if (!e->symbol.IsNil()) map->insert(e->hash, e->symbol);
   }
+
+  // Replace the old segment with the new one.
+  Replace(handle, map);
+}
+
+void Store::SplitSymbolTable() {
+  CHECK_LT(segment_bits_, kMaxSegmentBits) << "Symbol table full";
+
+  // Objects are not moved while the new segments are being set up.
+  LockGC();
+
+  // Allocate new segment array and new maps with the same capacity as the
+  // existing segments. The handles for the existing segments are reused for
+  // the even segments.
+  int num_segments = 1 << segment_bits_;
+  ArrayDatum *segments =
+      AllocateDatum(ARRAY, 2 * num_segments * sizeof(Handle))->AsArray();
+  std::vector<MapDatum *> maps(2 * num_segments);
+  for (int i = 0; i < 2 * num_segments; ++i) {
+    Word capacity = GetMap(GetArray(symbols_)->get(i / 2))->capacity();
+    maps[i] = AllocateMap(capacity);
+  }
+  num_buckets_ *= 2;
+
+  // Move all the symbols to the new segments using one more hash bit for
+  // selecting the segment.
+  segment_bits_++;
+  segment_symbols_.assign(2 * num_segments, 0);
+  ArrayDatum *old = GetArray(symbols_);
+  for (int i = 0; i < num_segments; ++i) {
+    MapDatum *symbols = GetMap(old->get(i));
+    for (MapDatum::Entry *e = symbols->begin(); e < symbols->end(); ++e) {
+      if (e->symbol.IsNil()) continue;
+      int segment = SymbolSegment(e->hash);
+      maps[segment]->insert(e->hash, e->symbol);
+      segment_symbols_[segment]++;
+    }
+  }
+
+  // Replace the old segments with the new ones.
+  for (int i = 0; i < 2 * num_segments; ++i) {
+    Handle handle;
+    if (i % 2 == 0) {
+      handle = GetArray(symbols_)->get(i / 2);
+      Replace(handle, maps[i]);
+    } else {
+      handle = AllocateHandle(maps[i]);
+    }
+    *segments->at(i) = handle;
+  }
+  Replace(symbols_, segments);
+  UnlockGC();
+
+  VLOG(1) << "Symbol table split into " << 2 * num_segments << " segments";
 }
 
 Handle Store::FindSymbol(Text name, Handle hash) const {
-  const MapDatum *symbols = GetMap(symbols_);
-  Handle h = *symbols->bucket(hash);
-  while (!h.IsNil()) {
-    const SymbolDatum *symbol = GetSymbol(h);
-    if (symbol->hash == hash) {
+  const ArrayDatum *segments = GetArray(symbols_);
+  const MapDatum *symbols = GetMap(segments->get(SymbolSegment(hash)));
+  const MapDatum::Entry *entries = symbols->begin();
+  Word b = symbols->bucket(hash);
+  while (!entries[b].symbol.IsNil()) {
+    if (entries[b].hash == hash) {
+      const SymbolDatum *symbol = GetSymbol(entries[b].symbol);
       const Datum *symname = GetObject(symbol->name);
-      if (symname->IsString() && symname->AsString()->equals(name)) return h;
+      if (symname->IsString() && symname->AsString()->equals(name)) {
+        return entries[b].symbol;
+      }
     }
-    h = symbol->next;
+    b = symbols->probe(b);
   }
 
   return Handle::nil();
 }
 
+Handle Store::FindParentSymbol(Text name, Handle hash) const {
+  for (const Store *p = parent_; p != nullptr; p = p->parent_) {
+    Handle h = p->FindSymbol(name, hash);
+    if (!h.IsNil()) return h;
+  }
+  return Handle::nil();
+}
+
+Handle Store::FindLocalSymbol(Text name, Handle hash) const {
+  // Global symbols can only be shadowed by symbols made by LocalSymbol().
+  const Store *s = this;
+  while (s != nullptr && s->num_shadows_ == 0) s = s->parent_;
+  if (s == nullptr) return Handle::nil();
+
+  Handle h = FindSymbol(name, hash);
+  if (h.IsNil()) h = FindParentSymbol(name, hash);
+  return h;
+}
+
 Handle Store::FindSymbol(Text name) const {
   Handle hash = Hash(name);
   return FindSymbol(name, hash);
@@ -606,6 +1218,10 @@ Handle Store::Symbol(Text name) {
   Handle h = FindSymbol(name, hash);
   if (!h.IsNil()) return h;
 
+  // Try to look up symbol in the parents of a forked store.
+  h = FindParentSymbol(name, hash);
+  if (!h.IsNil()) return h;
+
   // Try to look up symbol in global store.
   if (globals_ != nullptr) {
     h = globals_->FindSymbol(name, hash);
@@ -634,6 +1250,10 @@ Handle Store::Symbol(Handle name) {
     Handle h = FindSymbol(str, hash);
     if (!h.IsNil()) return h;
 
+    // Try to look up symbol in the parents of a forked store.
+    h = FindParentSymbol(str, hash);
+    if (!h.IsNil()) return h;
+
     // Try to look up symbol in global store.
     if (globals_ != nullptr) {
       h = globals_->FindSymbol(str, hash);
@@ -656,6 +1276,10 @@ Handle Store::ExistingSymbol(Text name) const {
   Handle h = FindSymbol(name, hash);
   if (!h.IsNil()) return h;
 
+  // Try to look up symbol in the parents of a forked store.
+  h = FindParentSymbol(name, hash);
+  if (!h.IsNil()) return h;
+
   // Try to look up symbol in global store.
   if (globals_ != nullptr) {
     h = globals_->FindSymbol(name, hash);
@@ -680,6 +1304,10 @@ Handle Store::ExistingSymbol(Handle name) const {
     Handle h = FindSymbol(str, hash);
     if (!h.IsNil()) return h;
 
+    // Try to look up symbol in the parents of a forked store.
+    h = FindParentSymbol(str, hash);
+    if (!h.IsNil()) return h;
+
     // Try to look up symbol in global store.
     if (globals_ != nullptr) {
       h = globals_->FindSymbol(str, hash);
@@ -703,9 +1331,13 @@ Handle Store::Lookup(Text name) {
   // proxy, so just return nil.
   if (frozen_) return Handle::nil();
 
-  // Symbol is unbound. Bind it to a new proxy.
+  // Symbol is unbound. Bind it to a new proxy. The global store is never
+  // modified, so a global symbol is bound through a local symbol instead.
+  if (globals_ != nullptr && !Owned(sym)) sym = LocalSymbol(symbol)->self;
   Handle proxy = AllocateProxy(sym);
-  GetSymbol(sym)->value = proxy;
+  SymbolDatum *local = Mutable(sym)->AsSymbol();
+  local->value = proxy;
+  WriteBarrier(local);
   return proxy;
 }
 
@@ -722,9 +1354,13 @@ Handle Store::Lookup(Handle name) {
   // proxy, so just return nil.
   if (frozen_) return Handle::nil();
 
-  // Symbol is unbound. Bind it to a new proxy.
+  // Symbol is unbound. Bind it to a new proxy. The global store is never
+  // modified, so a global symbol is bound through a local symbol instead.
+  if (globals_ != nullptr && !Owned(sym)) sym = LocalSymbol(symbol)->self;
   Handle proxy = AllocateProxy(sym);
-  GetSymbol(sym)->value = proxy;
+  SymbolDatum *local = Mutable(sym)->AsSymbol();
+  local->value = proxy;
+  WriteBarrier(local);
   return proxy;
 }
 
@@ -750,23 +1386,24 @@ Handle Store::LookupExisting(Handle name) const {
 
 SymbolDatum *Store::LocalSymbol(SymbolDatum *symbol) {
   // Return symbol itself if it is owned.
-  if (Owned(symbol->self)) return symbol;
+  if (Owned(symbol->self)) return Mutable(symbol->self)->AsSymbol();
 
   // Try to resolve symbol in the store.
   Text name = GetString(symbol->name)->str();
   Handle h = FindSymbol(name, symbol->hash);
-  if (!h.IsNil()) return GetSymbol(h);
+  if (h.IsNil()) h = FindParentSymbol(name, symbol->hash);
+  if (!h.IsNil()) return Mutable(h)->AsSymbol();
 
   // Create local symbol. The name string object from the global symbol is
   // reused in the local symbol.
   SymbolDatum *local = AllocateDatum(SYMBOL, SymbolDatum::kSize)->AsSymbol();
   local->hash = symbol->hash;
-  local->next = Handle::nil();
   local->name = symbol->name;
   local->value = AllocateHandle(local);
 
   // Add symbol to local symbol table.
   InsertSymbol(local);
+  num_shadows_++;
 
   return local;
 }
@@ -776,6 +1413,16 @@ void Store::ReplaceProxy(ProxyDatum *proxy, FrameDatum *frame) {
   CHECK(Owned(proxy->self));
   CHECK(Owned(frame->self));
 
+  // Copy proxy shared with the parent of a forked store.
+  proxy = Mutable(proxy->self)->AsProxy();
+
+  // The proxy handle is given to the frame. Tenured objects can refer to a
+  // tenured proxy, so a frame in the nursery is remembered like in Replace().
+  if (nursery_ != nullptr && nursery_->contains(frame) &&
+      !nursery_->contains(proxy)) {
+    *remembered_.push() = frame;
+  }
+
   // Swap the handles for the proxy and the frame.
   Assign(proxy->self, frame);
   Assign(frame->self, proxy);
@@ -795,9 +1442,53 @@ Datum *Store::AllocateDatumSlow(Type type, Word size) {
   // Object allocation not allowed in frozen store.
   CHECK(!frozen_);
 
+  // Without sampling, this is only called when the current heap is full.
+  if (options_->allocation_sampling == 0) return RefillHeap(type, size);
+
+  // The allocation has reached the sampling fence or the end of the heap.
+  // Sample the allocation if it is the one crossing the sampling interval.
+  DisarmSampling();
+  Word bytes = Align(sizeof(Datum) + size);
+  if ((sample_countdown_ -= bytes) < 0) SampleAllocation();
+  Datum *object;
+  if (current_heap_->consume(bytes, &object)) {
+    object->info = size | type;
+  } else {
+    object = RefillHeap(type, size);
+  }
+  ArmSampling();
+  return object;
+}
+
+Datum *Store::RefillHeap(Type type, Word size) {
   // This is called when the current heap is full.
   Word bytes = Align(sizeof(Datum) + size);
   Datum *object;
+  if (nursery_ != nullptr) {
+    // The nursery is full. Objects that fit in the nursery are allocated there
+    // after the nursery has been collected. A full garbage collection is done
+    // when the tenured heaps have grown beyond the limit.
+    bool small = bytes <= nursery_->capacity() / 2;
+    if (gc_locks_ > 0) {
+      gc_pending_ = true;
+    } else {
+      if (small) CollectNursery();
+      if (TenuredSize() > tenured_limit_) GC();
+      if (small && nursery_->consume(bytes, &object)) {
+        object->info = size | type;
+        return object;
+      }
+    }
+
+    // Large objects and objects allocated while the GC is locked are allocated
+    // directly in the tenured heaps. These objects are remembered since they
+    // can hold references to objects in the nursery.
+    object = AllocateTenured(bytes);
+    object->info = size | type;
+    *remembered_.push() = object;
+    return object;
+  }
+
   while (current_heap_->next() != nullptr) {
     // Switch to next heap.
     current_heap_ = current_heap_->next();
@@ -857,13 +1548,109 @@ Datum *Store::AllocateDatumSlow(Type type, Word size) {
   return object;
 }
 
+Datum *Store::AllocateTenured(Word bytes) {
+  // Try to allocate object in the current and remaining tenured heaps.
+  Datum *object;
+  for (;;) {
+    if (tenured_heap_->consume(bytes, &object)) return object;
+    if (tenured_heap_->next() == nursery_) break;
+    tenured_heap_ = tenured_heap_->next();
+  }
+
+  // All tenured heaps are full; compute size of new heap.
+  size_t heap_size = last_heap_->capacity() * 2;
+  if (heap_size > options_->maximum_heap_size) {
+    heap_size = options_->maximum_heap_size;
+  }
+  while (heap_size < bytes) heap_size *= 2;
+
+  // Allocate new heap and insert it before the nursery.
+  Heap *heap = new Heap();
+  heap->reserve(heap_size);
+  heap->set_next(nursery_);
+  last_heap_->set_next(heap);
+  last_heap_ = heap;
+  tenured_heap_ = heap;
+
+  // Allocate object on new heap.
+  CHECK(heap->consume(bytes, &object));
+  return object;
+}
+
+void Store::SampleAllocation() {
+  // The sample represents all the bytes allocated since the previous sample.
+  int64 weight = options_->allocation_sampling - sample_countdown_;
+
+  // Schedule next sample.
+  sample_countdown_ = options_->allocation_sampling;
+
+  // Get the call stack for the allocation without this function.
+  void *stack[AllocationSample::kMaxDepth + 1];
+  int depth = backtrace(stack, AllocationSample::kMaxDepth + 1) - 1;
+  if (depth <= 0) return;
+
+  // Add sample to call site.
+  uint64 hash = CityHash64(reinterpret_cast<const char *>(stack + 1),
+                           depth * sizeof(void *));
+  auto f = sample_index_.find(hash);
+  if (f == sample_index_.end()) {
+    sample_index_[hash] = samples_.size();
+    samples_.emplace_back();
+    AllocationSample &sample = samples_.back();
+    memcpy(sample.stack, stack + 1, depth * sizeof(void *));
+    sample.depth = depth;
+    sample.count = 1;
+    sample.bytes = weight;
+  } else {
+    AllocationSample &sample = samples_[f->second];
+    sample.count++;
+    sample.bytes += weight;
+  }
+}
+
+void Store::ArmSampling() {
+  if (options_->allocation_sampling == 0 || sample_heap_ != nullptr) return;
+  sample_heap_ = current_heap_;
+  sample_start_ = current_heap_->end();
+  current_heap_->set_fence(std::max<int64>(sample_countdown_, 0));
+}
+
+void Store::DisarmSampling() {
+  if (sample_heap_ == nullptr) return;
+  int64 allocated = reinterpret_cast<Address>(sample_heap_->end()) -
+                    reinterpret_cast<Address>(sample_start_);
+  if (allocated > 0) sample_countdown_ -= allocated;
+  sample_heap_->clear_fence();
+  sample_heap_ = nullptr;
+}
+
+void Store::GetAllocationSamples(
+    std::vector<AllocationSample> *samples) const {
+  *samples = samples_;
+  std::sort(samples->begin(), samples->end(),
+            [](const AllocationSample &a, const AllocationSample &b) {
+              return a.bytes > b.bytes;
+            });
+}
+
+int64 Store::TenuredSize() const {
+  int64 size = 0;
+  for (Heap *heap = first_heap_; heap != nursery_; heap = heap->next()) {
+    size += heap->size();
+  }
+  return size;
+}
+
 Handle Store::AllocateHandleSlow(Datum *object) {
   // Handle allocation not allowed in frozen store.
   CHECK(!frozen_);
   DCHECK(free_handle_ == nullptr);
 
-  // Expand handle table.
-  handles_.reserve(handles_.size() * 2);
+  // Expand handle table. The handle table cannot grow beyond the range of
+  // handle offsets.
+  size_t size = handles_.size();
+  CHECK_LT(size, kMaxHandleTableSize) << "Handle table full";
+  handles_.reserve(std::min(size * 2, kMaxHandleTableSize));
 
   // Update the pool pointer to handle table.
   pools_[store_tag_] = reinterpret_cast<Address>(handles_.base());
@@ -903,9 +1690,33 @@ void Store::Mark() {
     ext = ext->next_;
   } while (ext != &externals_);
 
+  // In a forked store, all the objects inherited from the parent store are
+  // live. The inherited objects that have been copied to the fork are marked
+  // and traversed as roots, and the shared objects are never traversed.
+  Reference *table = handles_.base();
+  for (int i = 0; i < shared_.size(); ++i) {
+    if (shared_[i]) continue;
+    Datum *object = table[i].object;
+    object->mark();
+    if (!object->IsBinary()) object->range(stack.push());
+  }
+
+  // Large stores can be marked in parallel.
+  if (options_->mark_threads > 1) {
+    int64 used = 0;
+    for (Heap *heap = first_heap_; heap != nullptr; heap = heap->next()) {
+      used += heap->size();
+    }
+    if (used >= kMinParallelMarkBytes) {
+      ParallelMark(&stack, options_->mark_threads);
+      return;
+    }
+  }
+
   // Traverse all the objects reachable from the roots.
   Word pool_tag = store_tag_;
   Address pool = pools_[pool_tag];
+  Word inherited = inherited_;
   while (!stack.empty()) {
     Range *top = stack.top();
     if (top->empty()) {
@@ -918,7 +1729,7 @@ void Store::Mark() {
       // Only owned objects need to be marked. Number handles (i.e. ints and
       // floats) represent themselves, and references to global objects in a
       // local store are regarded as static since the global store is frozen.
-      if (!h.IsNil() && h.tag() == pool_tag) {
+      if (!h.IsNil() && h.tag() == pool_tag && h.offset() >= inherited) {
         // Dereference the handle. Here we take advantage of the fact that the
         // object is known to be owned so we can dereference the handle directly
         // through the owned handle table for the store.
@@ -937,6 +1748,143 @@ void Store::Mark() {
   }
 }
 
+// Marking stack for parallel marking thread. Each thread traverses the ranges
+// on its private stack. When the private stack grows while other threads are
+// idle, the oldest ranges are moved to the shared stack, where the other
+// threads can steal them.
+struct MarkStack {
+  Space<Range> local;
+  std::vector<Range> shared;
+  std::atomic<int> available{0};
+  std::mutex mu;
+};
+
+// Pushes handle range onto marking stack. Large ranges are split into chunks,
+// so they can be shared between threads.
+static void PushMarkRange(Space<Range> *stack, Handle *begin, Handle *end) {
+  while (end - begin > kMarkChunk) {
+    Range *range = stack->push();
+    range->begin = begin;
+    range->end = begin + kMarkChunk;
+    begin += kMarkChunk;
+  }
+  Range *range = stack->push();
+  range->begin = begin;
+  range->end = end;
+}
+
+void Store::ParallelMark(Space<Range> *stack, int threads) {
+  // Distribute the initial ranges between the shared stacks of the threads.
+  std::vector<MarkStack> stacks(threads);
+  Space<Range> chunks;
+  for (Range *r = stack->base(); r < stack->end(); ++r) {
+    PushMarkRange(&chunks, r->begin, r->end);
+  }
+  int next = 0;
+  for (Range *r = chunks.base(); r < chunks.end(); ++r) {
+    stacks[next].shared.push_back(*r);
+    next = (next + 1) % threads;
+  }
+  for (MarkStack &s : stacks) s.available = s.shared.size();
+
+  // Number of threads that are out of work. Marking is done when all the
+  // threads are idle, since work is only added to the shared stacks by threads
+  // that are not idle, and a thread always takes back the work in its own
+  // shared stack before going idle.
+  std::atomic<int> idle{0};
+
+  // Steals half the ranges from the first non-empty shared stack, starting
+  // with the thread's own shared stack.
+  auto steal = [&](int t) {
+    Space<Range> &local = stacks[t].local;
+    for (int i = 0; i < threads; ++i) {
+      MarkStack &victim = stacks[(t + i) % threads];
+      if (victim.available == 0) continue;
+      std::lock_guard<std::mutex> lock(victim.mu);
+      int size = victim.shared.size();
+      if (size == 0) continue;
+      int begin = size / 2;
+      for (int j = begin; j < size; ++j) *local.push() = victim.shared[j];
+      victim.shared.resize(begin);
+      victim.available = begin;
+      return true;
+    }
+    return false;
+  };
+
+  // Moves the oldest half of the private stack to the shared stack.
+  auto share = [&](int t) {
+    MarkStack &s = stacks[t];
+    int half = s.local.length() / 2;
+    std::lock_guard<std::mutex> lock(s.mu);
+    s.shared.insert(s.shared.end(), s.local.base(), s.local.base() + half);
+    s.available = s.shared.size();
+    Range *rest = s.local.base() + half;
+    int remaining = s.local.end() - rest;
+    memmove(s.local.base(), rest, remaining * sizeof(Range));
+    s.local.set_end(s.local.base() + remaining);
+  };
+
+  // Traverse all the objects reachable from the roots in parallel.
+  Word pool_tag = store_tag_;
+  Address pool = pools_[pool_tag];
+  Word inherited = inherited_;
+  auto worker = [&](int t) {
+    Space<Range> &local = stacks[t].local;
+    for (;;) {
+      while (!local.empty()) {
+        Range *top = local.top();
+        if (top->empty()) {
+          local.pop();
+          continue;
+        }
+        Handle h = *top->begin++;
+        if (h.IsNil() || h.tag() != pool_tag || h.offset() < inherited) {
+          continue;
+        }
+        Datum *object = *reinterpret_cast<Datum **>(pool + h.offset());
+        if (!object->atomic_mark()) continue;
+        if (object->IsBinary()) continue;
+        Range range;
+        object->range(&range);
+        PushMarkRange(&local, range.begin, range.end);
+
+        // Share work if other threads are idle.
+        if (local.length() >= kMarkShareThreshold && idle > 0 &&
+            stacks[t].available == 0) {
+          share(t);
+        }
+      }
+
+      // Get more work from the shared stacks.
+      if (steal(t)) continue;
+
+      // Wait until more work is shared or all threads are out of work.
+      idle++;
+      for (;;) {
+        if (idle == threads) return;
+        bool more = false;
+        for (MarkStack &s : stacks) {
+          if (s.available > 0) more = true;
+        }
+        if (more) {
+          idle--;
+          if (steal(t)) break;
+          idle++;
+        } else {
+          std::this_thread::yield();
+        }
+      }
+    }
+  };
+
+  if (mark_pool_ == nullptr || mark_pool_->size() != threads) {
+    delete mark_pool_;
+    mark_pool_ = new WorkerPool(threads);
+  }
+  mark_pool_->Run(worker);
+}
+
 void Store::Compact() {
   // The handles for the garbage collected objects are added to the handle
   // free list.
@@ -950,7 +1898,11 @@ void Store::Compact() {
     Datum *end = heap->end();
     Datum *unused = object;
     while (object < end) {
+      // Frames with slot indexes are moved together with their index.
       Datum *next = object->next();
+      if (object->IsFrame() && object->AsFrame()->IsIndexed()) {
+        next = next->next();
+      }
       if (!object->IsInvalid()) {
         if (object->marked()) {
           // Object survived. Clear the mark.
@@ -977,13 +1929,143 @@ void Store::Compact() {
     heap->set_end(unused);
   }
 
-  // Start allocating from the first heap.
+  // Start allocating from the first heap, or the nursery if the store has one.
   current_heap_ = first_heap_;
+  if (nursery_ != nullptr) {
+    tenured_heap_ = first_heap_;
+    current_heap_ = nursery_;
+  }
 
   // Update the handle free list.
   free_handle_ = fh;
 }
 
+void Store::CollectNursery() {
+  Clock timer;
+  timer.start();
+
+  // The marking stack keeps track of memory regions with handles that have not
+  // yet been traversed.
+  Space<Range> stack;
+
+  // Build table with all the roots.
+  Space<Handle> root_table;
+  const Root *root = &roots_;
+  do {
+    *root_table.push() = root->handle_;
+    root = root->next_;
+  } while (root != &roots_);
+
+  // Add root table to the marking stack.
+  Range *range = stack.push();
+  range->begin = root_table.base();
+  range->end = root_table.end();
+
+  // Add all external object references to the marking stack.
+  External *ext = &externals_;
+  do {
+    ext->GetReferences(stack.push());
+    ext = ext->next_;
+  } while (ext != &externals_);
+
+  // The symbol table is a root. Tenured symbol maps and symbols are updated in
+  // place when symbols are added and bound, so these are remembered objects.
+  range = stack.push();
+  range->begin = &symbols_;
+  range->end = &symbols_ + 1;
+
+  // Add all remembered objects, i.e. tenured objects that have been updated
+  // since the last nursery collection. Nursery objects in the remembered set
+  // have replaced tenured objects, so they are marked through their handle,
+  // which might have been given yet another replacement since.
+  for (Datum **r = remembered_.base(); r < remembered_.end(); ++r) {
+    Datum *object = *r;
+    if (nursery_->contains(object)) {
+      object = Deref(object->self);
+      if (!nursery_->contains(object) || object->marked()) continue;
+      object->mark();
+    } else if (object->IsInvalid()) {
+      continue;
+    }
+    if (!object->IsBinary()) object->range(stack.push());
+  }
+
+  // Mark all the objects in the nursery reachable from the roots. Tenured
+  // objects are not traversed.
+  Word pool_tag = store_tag_;
+  Address pool = pools_[pool_tag];
+  while (!stack.empty()) {
+    Range *top = stack.top();
+    if (top->empty()) {
+      // Traversal of range has been completed.
+      stack.pop();
+    } else {
+      // Get next handle in range.
+      Handle h = *top->begin++;
+
+      // Only owned objects in the nursery need to be marked.
+      if (!h.IsNil() && h.tag() == pool_tag) {
+        Datum *object = *reinterpret_cast<Datum **>(pool + h.offset());
+        if (nursery_->contains(object) && !object->marked()) {
+          object->mark();
+          if (!object->IsBinary()) object->range(stack.push());
+        }
+      }
+    }
+  }
+  timer.stop();
+  int64 mark_time = timer.us();
+
+  // Promote the surviving objects to the tenured heaps and free the handles
+  // for the dead objects.
+  timer.start();
+  Reference *fh = free_handle_;
+  Datum *object = nursery_->base();
+  Datum *end = nursery_->end();
+  int64 promoted = 0;
+  while (object < end) {
+    Datum *next = object->next();
+    if (!object->IsInvalid()) {
+      if (object->marked()) {
+        // Object survived. Clear the mark and move it to the tenured heaps.
+        object->unmark();
+        size_t size = Region::size(object, next);
+        Datum *tenured = AllocateTenured(size);
+        memcpy(tenured, object, size);
+        Assign(tenured->self, tenured);
+        promoted += size;
+      } else {
+        // Object is dead. Free the associated handle.
+        Reference *ref = handles_.address(object->self.offset());
+        ref->next = fh;
+        fh = ref;
+      }
+    }
+    object = next;
+  }
+  free_handle_ = fh;
+
+  // The nursery is now empty, and there are no references from tenured objects
+  // to objects in the nursery.
+  nursery_->reset();
+  remembered_.reset();
+  timer.stop();
+  int64 promote_time = timer.us();
+
+  // Update statistics.
+  num_minor_gcs_++;
+  mark_time_ += mark_time;
+  promote_time_ += promote_time;
+  promoted_bytes_ += promoted;
+  gc_time_ += mark_time + promote_time;
+  gc_pauses_[MemoryUsage::PauseBucket(mark_time + promote_time)]++;
+
+  VLOG(15) << "Nursery GC " << mark_time + promote_time << " us, "
+           << "mark " << mark_time << " us, "
+           << "promote " << promote_time << " us, "
+           << promoted << " bytes promoted";
+}
+
 void Store::GC() {
   Clock timer;
 
@@ -996,6 +2078,13 @@ void Store::GC() {
     return;
   }
 
+  // Remove the sampling fence while the heaps are compacted.
+  bool sampling = sample_heap_ != nullptr;
+  DisarmSampling();
+
+  // Promote all surviving objects in the nursery before collecting the heaps.
+  if (nursery_ != nullptr) CollectNursery();
+
   // Mark all the objects reachable from the roots.
   timer.start();
   Mark();
@@ -1009,10 +2098,21 @@ void Store::GC() {
   timer.stop();
   int64 compact_time = timer.us();
 
+  // Adjust the limit for triggering full garbage collections from nursery
+  // collections.
+  if (nursery_ != nullptr) {
+    tenured_limit_ = std::max<int64>(2 * TenuredSize(),
+                                     2 * options_->initial_heap_size);
+  }
+  if (sampling) ArmSampling();
+
   // Update statistics.
   int64 total_time = mark_time + compact_time;
   gc_time_ += total_time;
+  mark_time_ += mark_time;
+  compact_time_ += compact_time;
   num_gcs_++;
+  gc_pauses_[MemoryUsage::PauseBucket(total_time)]++;
 
   VLOG(15) << "GC " << total_time << " us, "
            << "mark " << mark_time << " us, "
@@ -1071,6 +2171,20 @@ bool Store::IsValidReference(Handle handle) const {
 }
 
 void Store::ReplaceHandle(Handle handle, Handle replacement) {
+  // In a forked store, the objects shared with the parent are copied to the
+  // fork before the handle is replaced.
+  Reference *table = handles_.base();
+  for (size_t i = 0; i < shared_.size(); ++i) {
+    if (!shared_[i] || table[i].object == nullptr) continue;
+    Datum *object = table[i].object;
+    if (object->IsInvalid() || object->IsBinary()) continue;
+    Handle *begin = reinterpret_cast<Handle *>(object->payload());
+    Handle *end = reinterpret_cast<Handle *>(object->limit());
+    if (std::find(begin, end, handle) != end) {
+      CopyOnWrite(Handle::Ref(i * sizeof(Reference), store_tag_));
+    }
+  }
+
   // Scan the heaps and replace all instances of handle.
   for (Heap *heap = first_heap_; heap != nullptr; heap = heap->next()) {
     Datum *object = heap->base();
@@ -1080,7 +2194,10 @@ void Store::ReplaceHandle(Handle handle, Handle replacement) {
         Handle *begin = reinterpret_cast<Handle *>(object->payload());
         Handle *end = reinterpret_cast<Handle *>(object->limit());
         for (Handle *h = begin; h < end; ++h) {
-          if (*h == handle) *h = replacement;
+          if (*h == handle) {
+            *h = replacement;
+            WriteBarrier(object);
+          }
         }
       }
       object = object->next();
@@ -1115,8 +2232,13 @@ void Store::Freeze() {
   // Local stores cannot be frozen.
   CHECK(globals_ == nullptr);
 
+  // Build slot indexes for wide frames. The frames with slot indexes replace
+  // the original frames, which are removed by the garbage collection below.
+  if (options_->slot_index_threshold > 0) BuildSlotIndexes();
+
   // Run garbage collection to free up unused space.
   GC();
+  DisarmSampling();
 
   // Shrink all the heaps to fit the allocated data. This will force slow case
   // in object memory allocation where we check for frozen store.
@@ -1178,6 +2300,65 @@ void Store::Freeze() {
   frozen_ = true;
 }
 
+void Store::BuildSlotIndexes() {
+  // Find all frames that need a slot index.
+  std::vector<Handle> frames;
+  for (Heap *heap = first_heap_; heap != nullptr; heap = heap->next()) {
+    for (Datum *object = heap->base(); object < heap->end();
+         object = object->next()) {
+      if (!object->IsFrame() || object->IsProxy()) continue;
+      FrameDatum *frame = object->AsFrame();
+      if (frame->IsIndexed()) continue;
+      if (frame->slots() < options_->slot_index_threshold) continue;
+      frames.push_back(frame->self);
+    }
+  }
+
+  // Replace the frames with new frames followed by slot indexes.
+  LockGC();
+  for (Handle handle : frames) {
+    // Allocate heap object with room for both the frame and the index.
+    Word frame_size = GetFrame(handle)->size();
+    Word index_size = SlotIndex::IndexSize(GetFrame(handle)->slots());
+    Word size = Align(frame_size) + sizeof(Datum) + index_size;
+    Datum *object = AllocateDatum(FRAME, size);
+    FrameDatum *frame = GetFrame(handle);
+
+    // Copy frame.
+    object->info = frame_size | frame->typebits() | INDEXED;
+    memcpy(object->payload(), frame->payload(), frame_size);
+    FrameDatum *indexed = object->AsFrame();
+
+    // Build slot index.
+    SlotIndex *index = reinterpret_cast<SlotIndex *>(object->next());
+    index->info = index_size | INVALID;
+    index->self = handle;
+    SlotIndex::Entry *entries = index->entries();
+    Word capacity = index->capacity();
+    for (Word i = 0; i < capacity; ++i) {
+      entries[i].name = Handle::nil();
+      entries[i].slot = SlotIndex::kEmpty;
+    }
+    const Slot *begin = indexed->begin();
+    for (const Slot *slot = begin; slot < indexed->end(); ++slot) {
+      Word b = SlotIndex::Bucket(slot->name, capacity);
+      while (entries[b].slot != SlotIndex::kEmpty) {
+        if (entries[b].name == slot->name) break;
+        b = (b + 1) & (capacity - 1);
+      }
+      if (entries[b].slot == SlotIndex::kEmpty) {
+        entries[b].name = slot->name;
+        entries[b].slot = slot - begin;
+      }
+    }
+
+    // Replace the original frame.
+    Replace(handle, indexed);
+  }
+  UnlockGC();
+  VLOG(1) << frames.size() << " slot indexes built";
+}
+
 void Store::CoalesceStrings() {
   // Do not coalesce strings in frozen store.
   if (frozen_) return;
@@ -1231,6 +2412,7 @@ void Store::CoalesceStrings() {
             // Replace string with the cached string. The original string will
             // be removed during the next GC.
             *cell = intern->self;
+            WriteBarrier(object);
             num_replaced++;
           }
         }
@@ -1243,6 +2425,239 @@ void Store::CoalesceStrings() {
   VLOG(1) << num_replaced << " strings coalesced";
 }
 
+void Store::CoalesceFrames() {
+  // Do not coalesce frames in frozen store.
+  if (frozen_) return;
+
+  // Find all anonymous frames in the heaps. The frame index table maps handles
+  // for anonymous frames to their position in the frame list.
+  std::vector<Handle> frames;
+  std::vector<int> index(handles_.size() / sizeof(Reference), -1);
+  for (Heap *heap = first_heap_; heap != nullptr; heap = heap->next()) {
+    Datum *object = heap->base();
+    Datum *end = heap->end();
+    while (object < end) {
+      if (object->IsFrame() && object->AsFrame()->IsAnonymous()) {
+        index[object->self.offset() / sizeof(Reference)] = frames.size();
+        frames.push_back(object->self);
+      }
+      object = object->next();
+    }
+  }
+  if (frames.empty()) return;
+
+  // Canonical frame for each anonymous frame. This is nil until the frame has
+  // been visited.
+  std::vector<Handle> canonical(frames.size(), Handle::nil());
+  auto frame_index = [&](Handle h) {
+    if (!h.IsRef() || h.IsNil() || h.tag() != store_tag_) return -1;
+    Word i = h.offset() / sizeof(Reference);
+    return i < index.size() ? index[i] : -1;
+  };
+  auto canon = [&](Handle h) {
+    int f = frame_index(h);
+    return f == -1 || canonical[f].IsNil() ? h : canonical[f];
+  };
+
+  // Hash table with canonical frames. The table uses open addressing, and each
+  // entry is the index of a canonical frame plus one.
+  Word num_buckets = 1;
+  while (num_buckets < frames.size() * 2) num_buckets <<= 1;
+  std::vector<int> table(num_buckets);
+  std::vector<uint64> hashes(frames.size());
+
+  // Frames are visited bottom-up, so that the canonical frames for all the
+  // anonymous frames referenced from a frame are known before the frame itself
+  // is hashed. Frames that are part of a reference cycle are never coalesced.
+  enum State : char {UNVISITED, VISITING, DONE};
+  std::vector<State> state(frames.size(), UNVISITED);
+  std::vector<int> stack;
+  std::vector<Handle> slots;
+  int num_coalesced = 0;
+  int64 bytes_saved = 0;
+  for (int root = 0; root < frames.size(); ++root) {
+    if (state[root] != UNVISITED) continue;
+    stack.push_back(root);
+    while (!stack.empty()) {
+      int f = stack.back();
+      FrameDatum *frame = GetFrame(frames[f]);
+      if (state[f] == UNVISITED) {
+        // Visit the anonymous frames referenced by the frame first.
+        state[f] = VISITING;
+        for (Slot *s = frame->begin(); s < frame->end(); ++s) {
+          int n = frame_index(s->name);
+          if (n != -1 && state[n] == UNVISITED) stack.push_back(n);
+          int v = frame_index(s->value);
+          if (v != -1 && state[v] == UNVISITED) stack.push_back(v);
+        }
+        continue;
+      }
+      stack.pop_back();
+      if (state[f] == DONE) continue;
+      state[f] = DONE;
+
+      // Replace references to anonymous frames with their canonical frames.
+      bool cyclic = false;
+      slots.clear();
+      for (Slot *s = frame->begin(); s < frame->end(); ++s) {
+        for (Handle h : {s->name, s->value}) {
+          int r = frame_index(h);
+          if (r != -1 && canonical[r].IsNil()) cyclic = true;
+          slots.push_back(canon(h));
+        }
+      }
+      if (cyclic) {
+        canonical[f] = frames[f];
+        continue;
+      }
+
+      // Look up frame in the table of canonical frames.
+      uint64 hash = HashBytes(slots.data(), slots.size() * sizeof(Handle));
+      hash ^= frame->typebits();
+      hashes[f] = hash;
+      Word b = hash & (num_buckets - 1);
+      for (;;) {
+        int c = table[b] - 1;
+        if (c == -1) {
+          // New canonical frame.
+          table[b] = f + 1;
+          canonical[f] = frames[f];
+          break;
+        }
+        if (hashes[c] == hash) {
+          // Compare frame with the canonical frame.
+          FrameDatum *other = GetFrame(frames[c]);
+          bool equal = other->info == frame->info;
+          const Handle *h = slots.data();
+          for (Slot *s = other->begin(); equal && s < other->end(); ++s) {
+            if (canon(s->name) != *h++ || canon(s->value) != *h++) {
+              equal = false;
+            }
+          }
+          if (equal) {
+            // Duplicate frame.
+            canonical[f] = frames[c];
+            num_coalesced++;
+            bytes_saved += Align(sizeof(Datum) + frame->size());
+            break;
+          }
+        }
+        b = (b + 1) & (num_buckets - 1);
+      }
+    }
+  }
+
+  // Run through all objects and replace references to duplicate frames with
+  // references to the canonical frames. The duplicates will be removed during
+  // the next GC unless they are referenced from roots or externals.
+  for (Heap *heap = first_heap_; heap != nullptr; heap = heap->next()) {
+    Datum *object = heap->base();
+    Datum *end = heap->end();
+    while (object < end) {
+      if (!object->IsInvalid() && !object->IsBinary()) {
+        bool updated = false;
+        Handle *begin = reinterpret_cast<Handle *>(object->payload());
+        Handle *end = reinterpret_cast<Handle *>(object->limit());
+        for (Handle *cell = begin; cell < end; ++cell) {
+          Handle h = canon(*cell);
+          if (h != *cell) {
+            *cell = h;
+            updated = true;
+          }
+        }
+        if (updated) WriteBarrier(object);
+      }
+      object = object->next();
+    }
+  }
+
+  coalesced_bytes_ += bytes_saved;
+  VLOG(1) << num_coalesced << " frames coalesced, " << bytes_saved
+          << " bytes saved";
+}
+
+Status Store::WriteSnapshot(const string &filename,
+                            const string &source) const {
+  // Only frozen global stores can be written to snapshots.
+  CHECK(frozen_);
+  CHECK(globals_ == nullptr);
+
+  // Compute snapshot layout.
+  SnapshotHeader header;
+  memset(&header, 0, sizeof(header));
+  header.magic = kSnapshotMagic;
+  header.version = kSnapshotVersion;
+  header.base = kSnapshotBase;
+  header.heap_offset = kSnapshotPageSize;
+  for (Heap *heap = first_heap_; heap != nullptr; heap = heap->next()) {
+    header.heap_size += heap->size();
+  }
+  header.handles_offset = header.heap_offset + header.heap_size;
+  header.handles_size = handles_.size();
+  header.symbols = symbols_.raw();
+  header.num_symbols = num_symbols_;
+  header.num_buckets = num_buckets_;
+  header.num_dead_handles = num_dead_handles_;
+  header.handle_size = sizeof(Handle);
+  if (!source.empty()) {
+    struct stat st;
+    if (stat(source.c_str(), &st) != 0) {
+      return Status(errno, source.c_str(), strerror(errno));
+    }
+    header.source_size = st.st_size;
+    header.source_mtime = st.st_mtime;
+  }
+
+  // Build handle table with object addresses relative to the preferred
+  // mapping address. Dead handles are left as null pointers.
+  std::vector<uint64> table(handles_.size() / sizeof(Reference));
+  table[0] = kNilTrap;
+  uint64 address = header.base + header.heap_offset;
+  for (Heap *heap = first_heap_; heap != nullptr; heap = heap->next()) {
+    for (Datum *object = heap->base(); object < heap->end();
+         object = object->next()) {
+      if (object->IsInvalid()) continue;
+      uint64 offset = Region::size(heap->base(), object);
+      table[object->self.offset() / sizeof(Reference)] = address + offset;
+    }
+    address += heap->size();
+  }
+
+  // Write header, heaps, and handle table to snapshot file.
+  FILE *f = fopen(filename.c_str(), "w");
+  if (f == nullptr) return Status(errno, filename.c_str(), strerror(errno));
+  std::vector<char> padding(header.heap_offset - sizeof(header));
+  bool ok = fwrite(&header, sizeof(header), 1, f) == 1;
+  ok = ok && fwrite(padding.data(), padding.size(), 1, f) == 1;
+  for (Heap *heap = first_heap_; ok && heap != nullptr; heap = heap->next()) {
+    if (heap->empty()) continue;
+    ok = fwrite(heap->base(), heap->size(), 1, f) == 1;
+  }
+  ok = ok && fwrite(table.data(), header.handles_size, 1, f) == 1;
+  if (fclose(f) != 0) ok = false;
+  if (!ok) return Status(EIO, filename.c_str(), "Error writing snapshot");
+
+  return Status::OK;
+}
+
+bool Store::ValidSnapshot(const string &filename, const string &source) {
+  FILE *f = fopen(filename.c_str(), "r");
+  if (f == nullptr) return false;
+  SnapshotHeader header;
+  bool valid = fread(&header, sizeof(header), 1, f) == 1 &&
+               header.magic == kSnapshotMagic &&
+               header.version == kSnapshotVersion &&
+               header.handle_size == sizeof(Handle);
+  fclose(f);
+  if (!valid || source.empty()) return valid;
+
+  // Check that the source file has not changed since the snapshot was made.
+  struct stat st;
+  if (stat(source.c_str(), &st) != 0) return false;
+  return header.source_size == st.st_size &&
+         header.source_mtime == st.st_mtime;
+}
+
 string Store::DebugString(Handle handle) const {
   if (handle.IsRef()) {
     if (handle.IsNil()) return "nil";
@@ -1298,7 +2713,7 @@ void Store::GetMemoryUsage(MemoryUsage *usage, bool quick) const {
   usage->num_dead_handles = num_dead_handles_;
 
   // Count the number of free elements in the handle table.
-  int n = 0;
+  int64 n = 0;
   if (!quick) {
     Reference *ref = free_handle_;
     while (ref != nullptr) {
@@ -1315,11 +2730,12 @@ void Store::GetMemoryUsage(MemoryUsage *usage, bool quick) const {
   if (quick) {
     bound = num_symbols_;
   } else {
-    const MapDatum *symbols = GetMap(symbols_);
-    for (Handle *bucket = symbols->begin(); bucket < symbols->end(); ++bucket) {
-      Handle h = *bucket;
-      while (!h.IsNil()) {
-        const SymbolDatum *symbol = GetSymbol(h);
+    const ArrayDatum *segments = GetArray(symbols_);
+    for (Handle *s = segments->begin(); s < segments->end(); ++s) {
+      const MapDatum *symbols = GetMap(*s);
+      for (MapDatum::Entry *e = symbols->begin(); e < symbols->end(); ++e) {
+        if (e->symbol.IsNil()) continue;
+        const SymbolDatum *symbol = GetSymbol(e->symbol);
         if (symbol->unbound()) {
           unbound++;
         } else {
@@ -1330,7 +2746,6 @@ void Store::GetMemoryUsage(MemoryUsage *usage, bool quick) const {
             bound++;
           }
         }
-        h = symbol->next;
       }
     }
   }
@@ -1342,6 +2757,63 @@ void Store::GetMemoryUsage(MemoryUsage *usage, bool quick) const {
   // Garbage collection statistics.
   usage->num_gcs = num_gcs_;
   usage->gc_time = gc_time_;
+  usage->num_minor_gcs = num_minor_gcs_;
+  usage->mark_time = mark_time_;
+  usage->compact_time = compact_time_;
+  usage->promote_time = promote_time_;
+  usage->promoted_bytes = promoted_bytes_;
+  usage->num_remembered = remembered_.length();
+  usage->nursery_size = nursery_ != nullptr ? nursery_->capacity() : 0;
+  usage->coalesced_bytes = coalesced_bytes_;
+  for (int i = 0; i < MemoryUsage::kPauseBuckets; ++i) {
+    usage->gc_pauses[i] = gc_pauses_[i];
+  }
+
+  // Object statistics by type.
+  for (auto &stats : usage->frames) stats.count = stats.bytes = 0;
+  MemoryUsage::ObjectStats *all[] = {
+    &usage->proxies, &usage->strings, &usage->arrays,
+    &usage->symbols, &usage->indexes, &usage->invalid,
+  };
+  for (MemoryUsage::ObjectStats *stats : all) stats->count = stats->bytes = 0;
+  if (quick) return;
+  auto add = [](MemoryUsage::ObjectStats *stats,
+                const Datum *begin, const Datum *end) {
+    stats->count++;
+    stats->bytes += reinterpret_cast<const Byte *>(end) -
+                    reinterpret_cast<const Byte *>(begin);
+  };
+  for (Heap *heap = first_heap_; heap != nullptr; heap = heap->next()) {
+    const Datum *object = heap->base();
+    const Datum *end = heap->end();
+    while (object < end) {
+      const Datum *next = object->next();
+      if (object->IsFrame()) {
+        const FrameDatum *frame = object->AsFrame();
+        if (frame->IsProxy()) {
+          add(&usage->proxies, object, next);
+        } else {
+          add(&usage->frames[MemoryUsage::FrameBucket(frame->slots())],
+              object, next);
+        }
+        if (frame->IsIndexed()) {
+          // The slot index follows the frame in the heap.
+          const Datum *index = next;
+          next = index->next();
+          add(&usage->indexes, index, next);
+        }
+      } else if (object->IsString()) {
+        add(&usage->strings, object, next);
+      } else if (object->IsArray()) {
+        add(&usage->arrays, object, next);
+      } else if (object->IsSymbol()) {
+        add(&usage->symbols, object, next);
+      } else {
+        add(&usage->invalid, object, next);
+      }
+      object = next;
+    }
+  }
 }
 
 }  // namespace sling
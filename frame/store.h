@@ -17,19 +17,28 @@
 
 #include <stdlib.h>
 #include <string>
+#include <unordered_map>
 #include <utility>
+#include <vector>
 
 #include "base/bitcast.h"
 #include "base/logging.h"
 #include "base/macros.h"
+#include "base/status.h"
 #include "base/types.h"
 #include "string/text.h"
 
 namespace sling {
 
-// Basic low-level data types.
+// Basic low-level data types. Handles and object preambles are made of words.
+// Words are 32 bits unless the store is built with SLING_WIDE_HANDLES, where
+// 64-bit words make room for more than 2^29 objects in each pool.
 typedef uint8 Byte;
+#ifdef SLING_WIDE_HANDLES
+typedef uint64 Word;
+#else
 typedef uint32 Word;
+#endif
 typedef Byte *Address;
 
 // A region is an allocated memory area. The region has a two parts. The space
@@ -59,6 +68,30 @@ class Region {
   // Mark whole region as unused.
   void reset() { end_ = base_; }
 
+  // Attaches the region to external memory, e.g. a memory-mapped file. The
+  // region does not take ownership of the memory, and it must be detached
+  // before the region is destroyed. The whole region is marked as used.
+  void attach(void *data, size_t bytes) {
+    base_ = static_cast<Address>(data);
+    end_ = limit_ = base_ + bytes;
+  }
+
+  // Detaches the region from external memory without deallocating it.
+  void detach() { base_ = end_ = limit_ = nullptr; }
+
+  // Exchanges the memory of two regions.
+  void swap(Region *other) {
+    std::swap(base_, other->base_);
+    std::swap(end_, other->end_);
+    std::swap(limit_, other->limit_);
+  }
+
+  // Checks if address is inside the region.
+  bool contains(const void *ptr) const {
+    const Byte *addr = static_cast<const Byte *>(ptr);
+    return addr >= base_ && addr < limit_;
+  }
+
   // Returns the number of bytes used in the region.
   size_t size() const { return end_ - base_; }
 
@@ -123,7 +156,7 @@ template<typename T> class Space : public Region {
 
   // Allocates n elements from the unused portion of the memory region expanding
   // it if needed.
-  T *add(int n) {
+  T *add(size_t n) {
     Address ptr = end_;
     Address next = ptr + n * sizeof(T);
     if (next > limit_) {
@@ -135,7 +168,7 @@ template<typename T> class Space : public Region {
   }
 
   // Removes n elements from the end of the used portion.
-  T *remove(int n) {
+  T *remove(size_t n) {
     DCHECK(end_ - n * sizeof(T) >= base_);
     return reinterpret_cast<T *>(end_ -= n * sizeof(T));
   }
@@ -199,6 +232,15 @@ inline Word Align(Word n) {
 // Bit 2 is used as mark bit for reachable heap objects during garbage
 // collection.
 //
+// Each handle table entry is eight bytes, so a pool can contain at most 2^29
+// objects. The heaps themselves are not limited by the handle size, since the
+// handle table entries are 64-bit pointers.
+//
+// In stores built with SLING_WIDE_HANDLES, handles are 64-bit words and the
+// object references have 61 bits for the handle table offset. Numbers still
+// use the lower 32 bits with the upper 32 bits cleared, so integer, float and
+// index values are the same in both modes.
+//
 // The handle class is implemented as a POD type to make it efficient to pass by
 // value.
 struct Handle {
@@ -274,7 +316,8 @@ struct Handle {
   // Returns value as floating-point number.
   float AsFloat() const {
     DCHECK(IsNumber());
-    return IsFloat() ? bit_cast<float>(bits & ~kTagMask) : AsInt();
+    return IsFloat() ? bit_cast<float>(static_cast<uint32>(bits & ~kTagMask))
+                     : AsInt();
   }
 
   // Returns raw handle value.
@@ -291,12 +334,12 @@ struct Handle {
 
   // Constructs integer handle.
   static constexpr Handle Integer(int n) {
-    return Handle{static_cast<Word>(n << kIntShift) | kIntTag};
+    return Handle{static_cast<uint32>(n << kIntShift) | kIntTag};
   }
 
   // Constructs float handle.
   static Handle Float(float n) {
-    return Handle{(bit_cast<Word>(n) & ~kTagMask) | kFloatTag};
+    return Handle{(bit_cast<uint32>(n) & ~kTagMask) | kFloatTag};
   }
 
   // Constructs boolean handle.
@@ -336,7 +379,7 @@ struct Handle {
 
   // Constructs index handle.
   static Handle Index(int n) {
-    return Handle{static_cast<Word>(n << kIntShift) | kIndexMask};
+    return Handle{static_cast<uint32>(n << kIntShift) | kIndexMask};
   }
 
   // Equality testing.
@@ -346,11 +389,11 @@ struct Handle {
   // Integer operations.
   void Add(int n) {
     DCHECK(IsInt());
-    bits += (n << kIntShift);
+    bits = static_cast<uint32>(bits + (n << kIntShift));
   }
   void Subtract(int n) {
     DCHECK(IsInt());
-    bits -= (n << kIntShift);
+    bits = static_cast<uint32>(bits - (n << kIntShift));
   }
   void Increment() { Add(1); }
   void Decrement() { Subtract(1); }
@@ -363,8 +406,8 @@ struct Handle {
   static constexpr Handle zero() { return Handle{kZero}; }
   static constexpr Handle one() { return Handle{kOne}; }
 
-  // Handle is represented as an 32-bit unsigned integer where the lower bit are
-  // used as tag bits to encode the handle type.
+  // Handle is represented as an unsigned word where the lower bit are used as
+  // tag bits to encode the handle type.
   Word bits;
 };
 
@@ -377,6 +420,7 @@ struct HandleHash {
 
 // Forward declarations.
 class Store;
+class WorkerPool;
 struct StringDatum;
 struct FrameDatum;
 struct SymbolDatum;
@@ -396,9 +440,15 @@ struct Range {
 // preamble. The top-most bit is 1 for frames and 0 for other object types. For
 // frames, the lower three bits of the type are used for encoding identifier
 // information like whether the frame has an id and if the frame is a proxy.
+// With wide handles, objects can be up to 2 GB, which is the most the object
+// API can address with int sizes and indices.
+#ifdef SLING_WIDE_HANDLES
+const Word kSizeBits = 31;
+#else
 const Word kSizeBits = 28;
-const Word kSizeMask = (1 << kSizeBits) - 1;
-const Word kTypeMask = 0xF0000000;
+#endif
+const Word kSizeMask = (static_cast<Word>(1) << kSizeBits) - 1;
+const Word kTypeMask = static_cast<Word>(0xF) << kSizeBits;
 
 // Types.
 enum Type : Word {
@@ -419,12 +469,13 @@ enum Type : Word {
 enum FrameFlags : Word {
   PROXY   = 0x1UL << kSizeBits,  // frame is a proxy (i.e. only has an id slot)
   NAMED   = 0x2UL << kSizeBits,  // frame has an id
-  UNUSED_FRAME_FLAG = 0x4UL << kSizeBits,
+  INDEXED = 0x4UL << kSizeBits,  // frame is followed by a slot index
 };
 
 // All heap objects starts with an 8 byte preamble that contains the handle for
 // the object, the object size, and the object type. The object type is stored
-// in the upper bits of the size field.
+// in the upper bits of the size field. With wide handles, the preamble is two
+// 64-bit words.
 //
 //    33222222222211111111110000000000
 //    10987654321098765432109876543210
@@ -465,6 +516,16 @@ struct Datum {
   void mark() { self = Handle{self.raw() | Handle::kMark}; }
   void unmark() { self = Handle{self.raw() & ~Handle::kMark}; }
 
+  // Marks heap object atomically. Returns false if the object was already
+  // marked. This is used when several threads are marking objects in parallel.
+  bool atomic_mark() {
+    if (__atomic_load_n(&self.bits, __ATOMIC_RELAXED) & Handle::kMark) {
+      return false;
+    }
+    Word old = __atomic_fetch_or(&self.bits, Handle::kMark, __ATOMIC_RELAXED);
+    return (old & Handle::kMark) == 0;
+  }
+
   // Invalidate heap object by setting the type to INVALID.
   void invalidate() { info = size() | INVALID; }
 
@@ -588,7 +649,16 @@ struct Slot {
   Handle value;  // slot value
 };
 
+// Finds the first slot with a name in a range of slots. Returns null if there
+// is no slot with this name. The slot scanner is selected at runtime from the
+// CPU features, so wide frames are scanned with SIMD instructions if possible.
+typedef const Slot *(*SlotScanner)(const Slot *begin, const Slot *end,
+                                   Handle name);
+extern SlotScanner ScanSlots;
+
 // A frame consists of an array of slots with names and values.
+struct SlotIndex;
+
 struct FrameDatum : public Datum {
   // Range of slots for object.
   const Slot *begin() const {
@@ -607,22 +677,49 @@ struct FrameDatum : public Datum {
   // Returns the number of slots in the frame.
   int slots() const { return size() / sizeof(Slot); }
 
+  // Finds first slot with name. Returns null if the frame has no slot with
+  // this name. Narrow frames are scanned inline, and wider frames are scanned
+  // using the slot scanner.
+  const Slot *find(Handle name) const {
+    if (IsIndexed()) return lookup(name);
+    if (size() < kMinScanSlots * sizeof(Slot)) {
+      for (const Slot *slot = begin(); slot < end(); ++slot) {
+        if (slot->name == name) return slot;
+      }
+      return nullptr;
+    }
+    return ScanSlots(begin(), end(), name);
+  }
+  Slot *find(Handle name) {
+    return const_cast<Slot *>(static_cast<const FrameDatum *>(this)->find(name));
+  }
+
   // Finds first value of named slot.
   Handle get(Handle name) const {
-    for (const Slot *slot = begin(); slot < end(); ++slot) {
-      if (slot->name == name) return slot->value;
-    }
-    return Handle::nil();
+    const Slot *slot = find(name);
+    return slot != nullptr ? slot->value : Handle::nil();
   }
 
   // Checks if frame has named slot.
-  bool has(Handle name) const {
-    for (const Slot *slot = begin(); slot < end(); ++slot) {
-      if (slot->name == name) return true;
-    }
-    return false;
+  bool has(Handle name) const { return find(name) != nullptr; }
+
+  // Returns true if the frame has a slot index.
+  bool IsIndexed() const { return (info & INDEXED) != 0; }
+
+  // Returns the slot index for the frame. The slot index is stored right after
+  // the frame in the heap.
+  const SlotIndex *index() const {
+    DCHECK(IsIndexed());
+    return reinterpret_cast<const SlotIndex *>(next());
   }
 
+  // Finds the first slot with the name using the slot index. Returns null if
+  // the frame has no slot with this name.
+  inline const Slot *lookup(Handle name) const;
+
+  // Minimum number of slots for using the slot scanner.
+  static const int kMinScanSlots = 8;
+
   // Updates the named flag for frame.
   void AddFlags(Word flags) { info |= (flags & NAMED); }
 
@@ -633,14 +730,65 @@ struct FrameDatum : public Datum {
   bool IsAnonymous() const { return (info & NAMED) == 0; }
 };
 
+// Wide frames in frozen stores can have a slot index for fast slot lookup. The
+// slot index is stored as an invalid heap object right after the frame, so it is
+// skipped by all heap traversals. It is an open-addressing hash table with a
+// power-of-two number of entries that maps slot names to the position of the
+// first slot in the frame with that name.
+struct SlotIndex : public Datum {
+  // Hash table entry. Empty entries have a nil name and an empty position.
+  struct Entry {
+    Handle name;  // slot name
+    Word slot;    // position of first slot with name
+  };
+
+  // Position for empty hash table entries.
+  static const Word kEmpty = 0xFFFFFFFF;
+
+  // Returns the hash table entries.
+  const Entry *entries() const {
+    return reinterpret_cast<const Entry *>(payload());
+  }
+  Entry *entries() { return reinterpret_cast<Entry *>(payload()); }
+
+  // Returns the number of entries in the hash table.
+  Word capacity() const { return size() / sizeof(Entry); }
+
+  // Returns the bucket for a slot name.
+  static Word Bucket(Handle name, Word capacity) {
+    Word h = (name.raw() >> 3) * 0x9E3779B1;
+    return (h ^ (h >> 16)) & (capacity - 1);
+  }
+
+  // Returns the number of bytes needed for a slot index for a frame with the
+  // given number of slots.
+  static Word IndexSize(int slots) {
+    Word capacity = 1;
+    while (capacity < 2 * slots) capacity <<= 1;
+    return capacity * sizeof(Entry);
+  }
+};
+
+const Slot *FrameDatum::lookup(Handle name) const {
+  const SlotIndex *idx = index();
+  const SlotIndex::Entry *entries = idx->entries();
+  Word mask = idx->capacity() - 1;
+  Word b = SlotIndex::Bucket(name, idx->capacity());
+  for (;;) {
+    const SlotIndex::Entry &e = entries[b];
+    if (e.slot == SlotIndex::kEmpty) return nullptr;
+    if (e.name == name) return begin() + e.slot;
+    b = (b + 1) & mask;
+  }
+}
+
 // A symbol links a name to a value. Symbols are usually stored in maps which
 // can be used for symbol lookup. The symbol also contains a hash value for the
-// name for fast symbol lookup and a next pointer for linking the symbols in
-// the map buckets. A symbol can either be bound or unbound. An unbound symbol
-// has itself as the value and is just a symbolic name. A bound symbol can
-// either be resolved or unresolved. A resolved symbol references another
-// object, but an unresolved symbol points to a proxy object, which can later
-// be replaced when the symbol is resolved, so this gives three kinds of
+// name for fast symbol lookup. A symbol can either be bound or unbound. An
+// unbound symbol has itself as the value and is just a symbolic name. A bound
+// symbol can either be resolved or unresolved. A resolved symbol references
+// another object, but an unresolved symbol points to a proxy object, which can
+// later be replaced when the symbol is resolved, so this gives three kinds of
 // symbols:
 //   1) if the symbol is unbound the value is the symbol itself.
 //   2) if the symbol is bound and resolved, the value is the bound object.
@@ -651,10 +799,9 @@ struct SymbolDatum : public Datum {
   bool bound() const { return value != self; }
 
   // Size of payload of symbol object.
-  static const int kSize = 4 * sizeof(Handle);
+  static const int kSize = 3 * sizeof(Handle);
 
   Handle hash;   // hash value for name encoded as a tagged integer
-  Handle next;   // pointer to next symbol in map bucket
   Handle name;   // symbol name; a string object with the name of the symbol
   Handle value;  // symbol value; either a frame, a proxy, or the symbol itself
 };
@@ -690,21 +837,41 @@ struct ArrayDatum : public Datum {
   Handle get(int index) const { return *at(index); }
 };
 
-// A map is an array used for storing symbols. It is implemented as a hash table
-// with an array of buckets pointing to linked lists of symbols. Each linked
-// list is terminated by nil.
+// A map is an array used for storing symbols. It is implemented as an
+// open-addressing hash table with linear probing. Each entry holds the hash
+// value of the symbol name next to the symbol, so a probe only needs to
+// dereference the symbol when the hash values match. The number of entries is
+// a power of two, and empty entries have a nil symbol.
 struct MapDatum : public ArrayDatum {
-  // Returns a pointer to the bucket for the hash value.
-  Handle *bucket(Handle hash) const {
+  // Hash table entry.
+  struct Entry {
+    Handle hash;    // hash value for symbol name
+    Handle symbol;  // symbol or nil if entry is empty
+  };
+
+  // Range of entries in the map.
+  Entry *begin() const { return reinterpret_cast<Entry *>(payload()); }
+  Entry *end() const { return reinterpret_cast<Entry *>(limit()); }
+
+  // Returns the number of entries in the map.
+  Word capacity() const { return size() / sizeof(Entry); }
+
+  // Returns the first entry to probe for the hash value.
+  Word bucket(Handle hash) const {
     DCHECK(hash.IsInt());
-    return reinterpret_cast<Handle *>(payload() + (hash.untagged() % size()));
+    return (hash.untagged() >> Handle::kTagBits) & (capacity() - 1);
   }
 
-  // Inserts symbol in map.
-  void insert(SymbolDatum *symbol) {
-    Handle *b = bucket(symbol->hash);
-    symbol->next = *b;
-    *b = symbol->self;
+  // Returns the next entry in the probe sequence.
+  Word probe(Word b) const { return (b + 1) & (capacity() - 1); }
+
+  // Inserts symbol in map. The map must have at least one empty entry.
+  void insert(Handle hash, Handle symbol) {
+    Entry *entries = begin();
+    Word b = bucket(hash);
+    while (!entries[b].symbol.IsNil()) b = probe(b);
+    entries[b].hash = hash;
+    entries[b].symbol = symbol;
   }
 };
 
@@ -809,7 +976,7 @@ struct MemoryUsage {
   }
 
   // Number of handles used.
-  int used_handles() const {
+  int64 used_handles() const {
     return num_handles - num_unused_handles -
            num_free_handles - num_dead_handles;
   }
@@ -823,10 +990,10 @@ struct MemoryUsage {
   int64 unused_heap_bytes;  // number of unused bytes in heaps
   int num_heaps;            // number of heaps in store
 
-  int num_handles;          // number of handles in handle table
-  int num_unused_handles;   // number of unused handles
-  int num_free_handles;     // number of free handles
-  int num_dead_handles;     // number of dead handles
+  int64 num_handles;        // number of handles in handle table
+  int64 num_unused_handles; // number of unused handles
+  int64 num_free_handles;   // number of free handles
+  int64 num_dead_handles;   // number of dead handles
 
   int num_bound_symbols;    // number of bound symbols
   int num_unbound_symbols;  // number of unbound symbols
@@ -835,6 +1002,72 @@ struct MemoryUsage {
 
   int num_gcs;              // number of garbage collections
   int64 gc_time;            // garbage collection time in microseconds
+
+  int num_minor_gcs;        // number of nursery collections
+  int64 mark_time;          // time spent marking objects in microseconds
+  int64 compact_time;       // time spent compacting heaps in microseconds
+  int64 promote_time;       // time spent promoting nursery objects in us
+  int64 promoted_bytes;     // number of bytes promoted from the nursery
+  int num_remembered;       // number of objects in the remembered set
+  int64 nursery_size;       // size of nursery in bytes (zero if disabled)
+
+  int64 coalesced_bytes;    // bytes in duplicate frames removed by coalescing
+
+  // Number of objects and bytes used by a category of heap objects. The bytes
+  // include the object headers and alignment.
+  struct ObjectStats {
+    int64 count;
+    int64 bytes;
+  };
+
+  // Frames are divided into buckets by the number of slots. Bucket 0 has the
+  // empty frames, and bucket i has the frames with 2^(i-1) to 2^i-1 slots. The
+  // last bucket also has all larger frames.
+  static const int kFrameBuckets = 8;
+  static int FrameBucket(int slots) {
+    int bucket = 0;
+    while (slots > 0 && bucket < kFrameBuckets - 1) {
+      slots >>= 1;
+      bucket++;
+    }
+    return bucket;
+  }
+
+  // Object statistics by type. These are only computed for full memory usage
+  // statistics, i.e. when quick is false.
+  ObjectStats frames[kFrameBuckets];  // frames by number of slots
+  ObjectStats proxies;                // proxy frames
+  ObjectStats strings;                // string objects
+  ObjectStats arrays;                 // arrays and symbol tables
+  ObjectStats symbols;                // symbol objects
+  ObjectStats indexes;                // slot indexes for frames
+  ObjectStats invalid;                // invalidated objects
+
+  // Histogram of garbage collection pause times for both full and nursery
+  // collections. Bucket 0 has the pauses below one microsecond and bucket i
+  // has the pauses from 2^(i-1) to 2^i-1 microseconds. The last bucket also
+  // has all longer pauses.
+  static const int kPauseBuckets = 24;
+  static int PauseBucket(int64 us) {
+    int bucket = 0;
+    while (us > 0 && bucket < kPauseBuckets - 1) {
+      us >>= 1;
+      bucket++;
+    }
+    return bucket;
+  }
+  int64 gc_pauses[kPauseBuckets];
+};
+
+// Allocation call site sampled by the store. When sampling is enabled, the
+// store samples one allocation every allocation_sampling bytes, and all the
+// bytes allocated since the previous sample are attributed to the call site.
+struct AllocationSample {
+  static const int kMaxDepth = 6;
+  void *stack[kMaxDepth];  // return addresses for call site
+  int depth;               // number of return addresses in call stack
+  int64 count;             // number of samples for call site
+  int64 bytes;             // estimated number of bytes allocated at call site
 };
 
 // The data for objects are stored in object heaps. An object heap is a
@@ -843,18 +1076,54 @@ struct MemoryUsage {
 // garbage collection, the reachable objects in the heap are identified and the
 // objects that are still alive are compacted into the beginning of the heap
 // leaving a contiguous area at the end of the heap for allocating new objects.
+// New objects are allocated below the fence, which is normally at the end of
+// the heap. The fence can be moved down to make allocation stop early.
 class Heap : public Space<Datum> {
  public:
-  Heap() : next_(nullptr) {}
+  Heap() : next_(nullptr), fence_(nullptr) {}
 
   Heap *next() const { return next_; }
   void set_next(Heap *next) { next_ = next; }
 
+  // Allocates space for object below the fence. Returns false if there is not
+  // enough space left before the fence.
+  bool consume(size_t bytes, Datum **ptr) {
+    Address next = end_ + bytes;
+    if (next > fence_) return false;
+    *ptr = end();
+    end_ = next;
+    return true;
+  }
+
+  // Resizes heap and moves the fence to the end of the heap.
+  void reserve(size_t bytes) {
+    Space<Datum>::reserve(bytes);
+    fence_ = limit_;
+  }
+
+  // Allocates n datum units expanding the heap if needed.
+  Datum *add(size_t n) {
+    Datum *ptr = Space<Datum>::add(n);
+    fence_ = limit_;
+    return ptr;
+  }
+
+  // Sets the fence so at most the requested number of bytes can be allocated.
+  void set_fence(size_t bytes) {
+    fence_ = bytes < available() ? end_ + bytes : limit_;
+  }
+
+  // Moves the fence back to the end of the heap.
+  void clear_fence() { fence_ = limit_; }
+
  private:
   // Next heap for store. All the heaps for a store are linked together in a
   // linked list.
   Heap *next_;
 
+  // Allocation fence. No objects are allocated at or beyond the fence.
+  Address fence_;
+
   DISALLOW_COPY_AND_ASSIGN(Heap);
 };
 
@@ -875,7 +1144,11 @@ class Store {
       map_buckets = 1024;
       string_buckets = 1 << 20; //1 << 16;
       expansion_free_fraction = 20;
+      nursery_size = 0;
+      slot_index_threshold = 0;
       symbol_rebinding = false;
+      allocation_sampling = 0;
+      mark_threads = 1;
       local = this;
     }
 
@@ -888,7 +1161,8 @@ class Store {
     // Initial number of handles.
     int initial_handles;
 
-    // Initial number of bucket in symbol hash table.
+    // Initial number of entries in symbol hash table. This is rounded up to a
+    // power of two.
     int map_buckets;
 
     // Number of buckets for coalescing strings.
@@ -897,9 +1171,28 @@ class Store {
     // Minimum fraction of free memory after GC to skip expansion.
     int expansion_free_fraction;
 
+    // Size of the young-generation nursery in bytes. New objects in local
+    // stores are bump-allocated in the nursery, and objects surviving a
+    // nursery collection are promoted to the heaps. Zero disables the nursery.
+    int nursery_size;
+
+    // Minimum number of slots for building slot indexes for frames when the
+    // store is frozen. Lookups in indexed frames use a hash table instead of
+    // a linear scan over the slots. Zero disables slot indexes.
+    int slot_index_threshold;
+
     // Allow symbols to be bound.
     bool symbol_rebinding;
 
+    // Number of bytes allocated between sampled allocation call sites. Zero
+    // disables allocation sampling.
+    int allocation_sampling;
+
+    // Number of threads for marking reachable objects in full garbage
+    // collections. Stores with small heaps are always marked by the calling
+    // thread.
+    int mark_threads;
+
     // Options for local store.
     Options *local;
   };
@@ -913,9 +1206,36 @@ class Store {
   // Initializes local store.
   explicit Store(const Store *globals);
 
+  // Initializes frozen global store from a snapshot file written with
+  // WriteSnapshot(). The heap is memory-mapped read-only, so loading is almost
+  // instantaneous and all processes on a host that load the same snapshot share
+  // the physical memory pages for the store objects.
+  Store(const Options *options, const string &snapshot);
+  explicit Store(const string &snapshot) : Store(&kDefaultOptions, snapshot) {}
+
   // Deletes all objects in the store.
   ~Store();
 
+  // Deletes all objects in a local store, but keeps the memory allocated for
+  // the heaps and the handle table, so the store can be reused. All roots and
+  // external references to the store must have been released before the store
+  // is reset.
+  void Reset();
+
+  // Creates a fork of a local store. The fork shares all the objects in this
+  // store, and objects are only copied to the fork when they are modified in
+  // the fork. The handle table of this store is copied to the fork, so forking
+  // takes time proportional to the number of handles in this store, but not to
+  // the size of the objects. This store must not be modified while it has
+  // forks. The caller takes ownership of the fork.
+  Store *Fork();
+
+  // Commits the changes in a forked store to its parent store. All roots and
+  // external references to the fork must have been released, and the parent
+  // must not have any other forks. The fork is empty after the commit and must
+  // be deleted.
+  void Commit();
+
   // Looks up symbol. A new unbound symbol is created if the symbol does not
   // already exist.
   Handle Symbol(Text name);
@@ -936,6 +1256,14 @@ class Store {
   Handle LookupExisting(Text name) const;
   Handle LookupExisting(Handle name) const;
 
+  // Looks up the local symbol shadowing a global symbol in the store and in
+  // the parents of a forked store using a pre-computed hash value for the
+  // name. Returns nil if the global symbol is not shadowed.
+  Handle FindLocalSymbol(Text name, Handle hash) const;
+
+  // Computes the hash value for a string and returns it as an integer handle.
+  static Handle Hash(Text str);
+
   // Sets value for slot in  frame. If the frame has an existing slot with this
   // name, its value is updated. Otherwise a new slot is added to the frame. It
   // is not possible to update id slots of a frame with this method. If there
@@ -989,18 +1317,56 @@ class Store {
   // to find all identical strings.
   void CoalesceStrings();
 
+  // Merges identical anonymous frames. Frames are compared structurally
+  // bottom-up, so anonymous frames that only differ in references to other
+  // identical anonymous frames are also merged. References to duplicate frames
+  // are redirected to one canonical frame, and the duplicates are removed by
+  // the next GC. Strings are compared by handle, so CoalesceStrings() should be
+  // run first.
+  void CoalesceFrames();
+
   // Computes memory usage for store.
   void GetMemoryUsage(MemoryUsage *usage, bool quick = false) const;
 
+  // Returns the sampled allocation call sites with the most sampled bytes
+  // first. Allocations are only sampled if allocation_sampling is enabled in
+  // the store options.
+  void GetAllocationSamples(std::vector<AllocationSample> *samples) const;
+
+  // Writes a snapshot of a frozen global store to a file. The snapshot
+  // contains the heaps, the handle table, and the symbol table of the store in
+  // their in-memory layout, so it can be loaded without decoding. If 'source'
+  // is the file the store was loaded from, its size and modification time are
+  // recorded in the snapshot.
+  Status WriteSnapshot(const string &filename,
+                       const string &source = string()) const;
+
+  // Checks if a file contains a snapshot that can be loaded by this version of
+  // the store. If 'source' is given, the snapshot is only valid if it was
+  // written for the current version of the source file.
+  static bool ValidSnapshot(const string &filename,
+                            const string &source = string());
+
+  // Returns true if the store has been loaded from a memory-mapped snapshot.
+  bool mapped() const { return mapping_ != nullptr; }
+
   // Returns true if the store has been frozen.
   bool frozen() const { return frozen_; }
 
   // Global store for this store, or null if this is a global store.
   const Store *globals() const { return globals_; }
 
-  // Returns handle for symbol table.
+  // Parent store for a forked store, or null if this is not a fork.
+  const Store *parent() const { return parent_; }
+
+  // Returns handle for symbol table. The symbol table is an array of symbol
+  // map segments.
   Handle symbols() const { return symbols_; }
 
+  // Returns the number of entries in the handle table, including free entries.
+  // All handles owned by the store refer to entries below this number.
+  size_t num_handles() const { return handles_.size() / sizeof(Reference); }
+
   // Checks if this handle is owned by this store.
   bool Owned(Handle handle) const {
     return handle.tag() == store_tag_;
@@ -1027,6 +1393,15 @@ class Store {
   // Allocates empty frame.
   Handle AllocateFrame(Word slots);
 
+  // Allocates a batch of anonymous frames. The slots for all the frames are
+  // stored consecutively in the slot array, and sizes[i] is the number of slots
+  // in frame i. Heap space and handles for all the frames are reserved up front
+  // and the frames are filled in one pass. The handles for the new frames are
+  // returned in frames. The slots cannot contain ids, and the slot values must
+  // be protected from garbage collection by the caller, e.g. using Slots.
+  void AllocateFrames(const Slot *slots, const int *sizes, int count,
+                      Handle *frames);
+
   // Updates all the slots in the frame.
   void UpdateFrame(Handle handle, Slot *begin, Slot *end);
 
@@ -1048,6 +1423,13 @@ class Store {
     return *reinterpret_cast<const Datum **>(table + handle.offset());
   }
 
+  // Dereferences a handle for an object that is going to be modified. In a
+  // forked store, objects shared with the parent store are copied first.
+  Datum *Mutable(Handle handle) {
+    if (IsShared(handle)) return CopyOnWrite(handle);
+    return Deref(handle);
+  }
+
   // Checks basic type of object. This will return false for number types.
   bool IsType(Handle handle, Type type) const {
     DCHECK_EQ(type & Handle::kSimple, 0);
@@ -1087,6 +1469,15 @@ class Store {
   // Replaces proxy with a frame.
   void ReplaceProxy(ProxyDatum *proxy, FrameDatum *frame);
 
+  // Write barrier for updating objects in place. This must be called when
+  // handles are stored in an existing object, so the object is tracked as a
+  // root for nursery collections.
+  void WriteBarrier(Datum *object) {
+    if (nursery_ != nullptr && !nursery_->contains(object)) {
+      *remembered_.push() = object;
+    }
+  }
+
   // Registers external objects.
   void RegisterExternal(External *external) {
     if (frozen_) {
@@ -1163,10 +1554,29 @@ class Store {
     }
   }
 
-  // Allocates memory for heap object when there is no more space in the current
-  // heap.
+  // Allocates memory for heap object when there is no more space before the
+  // fence in the current heap.
   Datum *AllocateDatumSlow(Type type, Word size);
 
+  // Allocates memory for heap object when the current heap is full.
+  Datum *RefillHeap(Type type, Word size);
+
+  // Records the call site for a sampled allocation.
+  void SampleAllocation();
+
+  // Sets the fence in the current heap at the next sampled allocation. The
+  // allocation fast path does not track sampling, so the allocation that
+  // reaches the fence takes the slow path where it is sampled.
+  void ArmSampling();
+
+  // Charges the bytes allocated since the sampling fence was set to the
+  // sampling countdown and removes the fence.
+  void DisarmSampling();
+
+  // Allocates memory for object in the tenured heaps when the store has a
+  // nursery. This never triggers a garbage collection.
+  Datum *AllocateTenured(Word bytes);
+
   // Allocates handle for object.
   Handle AllocateHandle(Datum *object) {
     Reference *ref;
@@ -1194,8 +1604,22 @@ class Store {
 
   // Replaces heap object for a handle with a new object.
   void Replace(Handle handle, Datum *object) {
-    // Mark old object as invalid.
-    Deref(handle)->invalidate();
+    // Tenured objects can refer to the handle of a tenured object, so a
+    // replacement in the nursery is remembered to keep it alive in nursery
+    // collections.
+    Datum *old = Deref(handle);
+    if (nursery_ != nullptr && nursery_->contains(object) &&
+        !nursery_->contains(old)) {
+      *remembered_.push() = object;
+    }
+
+    // Mark old object as invalid. Objects shared with the parent of a forked
+    // store are left untouched.
+    if (IsShared(handle)) {
+      shared_[handle.offset() / sizeof(Reference)] = false;
+    } else {
+      old->invalidate();
+    }
 
     // Update handle to point to new object.
     Assign(handle, object);
@@ -1204,9 +1628,6 @@ class Store {
     object->self = handle;
   }
 
-  // Computes the hash value for a string and returns it as an integer handle.
-  static Handle Hash(Text str);
-
   // Allocates proxy object for symbol.
   Handle AllocateProxy(Handle symbol);
 
@@ -1222,9 +1643,42 @@ class Store {
   Handle FindSymbol(Text name) const;
   Handle FindSymbol(Text name, Handle hash) const;
 
+  // Finds symbol in the parent stores of a forked store.
+  Handle FindParentSymbol(Text name, Handle hash) const;
+
+  // Initializes a fork of a local store.
+  Store(const Store *globals, Store *parent);
+
+  // Checks if the object for a handle is shared with the parent store of a
+  // forked store.
+  bool IsShared(Handle handle) const {
+    return handle.offset() < inherited_ && handle.IsLocalRef() &&
+           shared_[handle.offset() / sizeof(Reference)];
+  }
+
+  // Copies a shared object to the forked store.
+  Datum *CopyOnWrite(Handle handle);
+
   // Inserts symbol in symbol table.
   void InsertSymbol(SymbolDatum *symbol);
 
+  // Allocates symbol table with one empty segment.
+  void InitSymbolTable();
+
+  // Returns the symbol table segment for a hash value.
+  int SymbolSegment(Handle hash) const {
+    return (hash.untagged() >> Handle::kTagBits) >> (30 - segment_bits_);
+  }
+
+  // Allocates an empty symbol map with room for a number of entries.
+  MapDatum *AllocateMap(Word capacity);
+
+  // Doubles the capacity of symbol table segment.
+  void GrowSymbolSegment(int segment);
+
+  // Splits each symbol table segment into two segments.
+  void SplitSymbolTable();
+
   // Checks if a handle is valid reference.
   bool IsValidReference(Handle handle) const;
 
@@ -1235,9 +1689,24 @@ class Store {
   // Mark reachable objects.
   void Mark();
 
+  // Marks reachable objects from the ranges on the marking stack using several
+  // threads.
+  void ParallelMark(Space<Range> *stack, int threads);
+
   // Compact heaps.
   void Compact();
 
+  // Builds slot indexes for all wide frames in the store.
+  void BuildSlotIndexes();
+
+  // Collects the nursery by marking young objects reachable from the roots,
+  // externals, remembered objects, and symbols, and then promoting the
+  // surviving objects to the tenured heaps.
+  void CollectNursery();
+
+  // Returns the number of bytes used in the tenured heaps.
+  int64 TenuredSize() const;
+
   // Pointers to the global and local handle tables. These must be first in
   // the store object for fast dereferencing of object handles. These will be
   // pointers to the handle tables of the global and local stores.
@@ -1262,6 +1731,20 @@ class Store {
   Heap *first_heap_;
   Heap *last_heap_;
 
+  // Young-generation nursery for local stores. The nursery is linked into the
+  // heap list after the last tenured heap, and new objects are allocated in
+  // the nursery, i.e. the current heap is always the nursery. The tenured heap
+  // is the heap where promoted objects are allocated. Old objects that have
+  // been updated in place are kept in the remembered set until the next
+  // nursery collection.
+  Heap *nursery_ = nullptr;
+  Heap *tenured_heap_ = nullptr;
+  Space<Datum *> remembered_;
+
+  // Size of tenured heaps that triggers a full garbage collection after a
+  // nursery collection.
+  int64 tenured_limit_ = 0;
+
   // The handle table is used for storing references to objects. All access to
   // objects go through the handle table, which provides a level of indirection
   // that allows object to move dynamically, e.g. during garbage collection and
@@ -1274,15 +1757,27 @@ class Store {
   Root roots_;
   External externals_;
 
-  // Symbol table.
+  // Symbol table. The symbol table is an array of symbol maps, where the
+  // segment for a symbol is selected by the high bits of its hash value. This
+  // keeps each map below the maximum object size for very large stores.
   Handle symbols_;
 
   // Number of symbols in symbol table.
   int num_symbols_ = 0;
 
+  // Number of local symbols made for global symbols.
+  int num_shadows_ = 0;
+
   // Number of hash buckets in the symbol table.
   int num_buckets_;
 
+  // Number of hash bits used for selecting the symbol table segment.
+  int segment_bits_ = 0;
+
+  // Number of symbols in each symbol table segment. This is not tracked for
+  // stores loaded from snapshots since these are frozen.
+  std::vector<int> segment_symbols_;
+
   // Number of GC locks. No garbage collection is performed as long as the
   // lock count is non-zero.
   int gc_locks_ = 0;
@@ -1294,12 +1789,59 @@ class Store {
   // Time spent on garbage collection in microseconds.
   int64 gc_time_ = 0;
 
+  // Detailed garbage collection statistics.
+  int num_minor_gcs_ = 0;
+  int64 mark_time_ = 0;
+  int64 compact_time_ = 0;
+  int64 promote_time_ = 0;
+  int64 promoted_bytes_ = 0;
+
+  // Number of bytes in duplicate frames removed by frame coalescing.
+  int64 coalesced_bytes_ = 0;
+
+  // Histogram of garbage collection pause times.
+  int64 gc_pauses_[MemoryUsage::kPauseBuckets] = {};
+
+  // Number of bytes left to allocate before the next allocation is sampled.
+  int64 sample_countdown_ = kint64max;
+
+  // Heap with sampling fence and the end of the heap when the fence was set.
+  Heap *sample_heap_ = nullptr;
+  Datum *sample_start_ = nullptr;
+
+  // Sampled allocation call sites and index of call sites by stack hash.
+  std::vector<AllocationSample> samples_;
+  std::unordered_map<uint64, int> sample_index_;
+
   // Number of dead handles after store has been frozen.
-  int num_dead_handles_ = 0;
+  int64 num_dead_handles_ = 0;
 
   // Configuration options for store.
   const Options *options_;
 
+  // Memory-mapped snapshot file for store, or null if the store has not been
+  // loaded from a snapshot.
+  void *mapping_ = nullptr;
+  size_t mapping_size_ = 0;
+
+  // Parent store for a forked store. The first part of the handle table in the
+  // fork is a copy of the handle table in the parent, and the objects for these
+  // handles are shared with the parent until they are modified in the fork.
+  Store *parent_ = nullptr;
+
+  // Size of the part of the handle table inherited from the parent store.
+  size_t inherited_ = 0;
+
+  // Inherited handles that still refer to objects in the parent store.
+  std::vector<bool> shared_;
+
+  // Number of forks of this store.
+  int forks_ = 0;
+
+  // Worker threads for parallel marking. The threads are started by the first
+  // parallel mark and reused for all later garbage collections.
+  WorkerPool *mark_pool_ = nullptr;
+
   // Default configuration options.
   static const Options kDefaultOptions;
 };
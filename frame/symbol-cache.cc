@@ -0,0 +1,88 @@
+// Copyright 2017 Google Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "frame/symbol-cache.h"
+
+#include "base/logging.h"
+
+namespace sling {
+
+SymbolCache::SymbolCache(const Store *globals, int capacity)
+    : globals_(globals), limit_(capacity) {
+  CHECK(globals->frozen()) << "Symbol cache requires a frozen global store";
+
+  // Keep the hash table at most half full.
+  int buckets = 16;
+  while (buckets < capacity * 2) buckets *= 2;
+  table_ = new std::atomic<Entry *>[buckets];
+  for (int i = 0; i < buckets; ++i) table_[i] = nullptr;
+  mask_ = buckets - 1;
+}
+
+SymbolCache::~SymbolCache() {
+  for (int i = 0; i <= mask_; ++i) delete table_[i].load();
+  delete [] table_;
+}
+
+int SymbolCache::Bucket(Handle hash) const {
+  // The low bits of the hash value hold the integer tag, so these are stripped
+  // like in MapDatum::bucket().
+  return (hash.untagged() >> Handle::kTagBits) & mask_;
+}
+
+const SymbolCache::Entry *SymbolCache::Find(Text name, Handle hash) const {
+  int b = Bucket(hash);
+  for (;;) {
+    const Entry *e = table_[b].load(std::memory_order_acquire);
+    if (e == nullptr) return nullptr;
+    if (e->hash == hash && Text(e->name) == name) return e;
+    b = (b + 1) & mask_;
+  }
+}
+
+void SymbolCache::Insert(Handle symbol) {
+  if (!symbol.IsGlobalRef() || size() >= limit_) return;
+  const SymbolDatum *sym = globals_->GetSymbol(symbol);
+  if (!sym->IsSymbol()) return;
+
+  // Make new entry for symbol unless it is already in the cache.
+  Text name = globals_->GetString(sym->name)->str();
+  if (Find(name, sym->hash) != nullptr) return;
+  Entry *entry = new Entry();
+  entry->name = name.str();
+  entry->hash = sym->hash;
+  entry->symbol = symbol;
+  entry->value = sym->bound() ? sym->value : Handle::nil();
+
+  // Add entry to the first empty bucket. Another thread might add the same
+  // symbol concurrently, in which case the first entry is kept.
+  int b = Bucket(entry->hash);
+  for (;;) {
+    Entry *e = table_[b].load(std::memory_order_acquire);
+    if (e == nullptr) {
+      if (table_[b].compare_exchange_strong(e, entry,
+                                            std::memory_order_release)) {
+        size_.fetch_add(1, std::memory_order_relaxed);
+        return;
+      }
+    }
+    if (e->hash == entry->hash && e->name == entry->name) {
+      delete entry;
+      return;
+    }
+    b = (b + 1) & mask_;
+  }
+}
+
+}  // namespace sling
@@ -0,0 +1,103 @@
+// Copyright 2017 Google Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef FRAME_SYMBOL_CACHE_H_
+#define FRAME_SYMBOL_CACHE_H_
+
+#include <atomic>
+#include <string>
+
+#include "base/macros.h"
+#include "base/types.h"
+#include "frame/store.h"
+#include "string/text.h"
+
+namespace sling {
+
+// Cache for resolving symbol names against a frozen global store. Decoding a
+// document into a local store looks up every symbol name in the global symbol
+// table, and documents in a corpus tend to use the same schema symbols over
+// and over again. The symbol cache keeps the global symbols resolved by the
+// decoders in a small table keyed on the raw name bytes, so these can be
+// resolved without probing the (potentially huge) global symbol table. Symbols
+// are added until the cache is full and are never evicted, so the cache holds
+// the first symbols seen rather than the most frequent ones. Since the common
+// schema symbols are used by almost every document, these are normally among
+// the first. The cache can be shared by decoders for all local stores of the
+// same global store, including decoders running in different threads.
+class SymbolCache {
+ public:
+  // Cached global symbol.
+  struct Entry {
+    string name;     // symbol name
+    Handle hash;     // hash value for symbol name
+    Handle symbol;   // global symbol
+    Handle value;    // value of global symbol, or nil if it is unbound
+  };
+
+  // Initializes symbol cache for global store. The cache holds at most
+  // 'capacity' symbols.
+  explicit SymbolCache(const Store *globals, int capacity = 4096);
+  ~SymbolCache();
+
+  // Finds symbol in the cache. The hash value for the name must be computed
+  // with Store::Hash(). Returns null if the symbol is not in the cache.
+  const Entry *Find(Text name, Handle hash) const;
+
+  // Adds global symbol to the cache. Symbols that are not in the global store
+  // are ignored, and no more symbols are added once the cache is full.
+  void Insert(Handle symbol);
+
+  // Adds hit and miss counts from a decoder to the cache statistics.
+  void AddStats(int64 hits, int64 misses) {
+    hits_.fetch_add(hits, std::memory_order_relaxed);
+    misses_.fetch_add(misses, std::memory_order_relaxed);
+  }
+
+  // Global store for cache.
+  const Store *globals() const { return globals_; }
+
+  // Number of symbols in cache.
+  int size() const { return size_.load(std::memory_order_relaxed); }
+
+  // Number of cache hits and misses.
+  int64 hits() const { return hits_.load(std::memory_order_relaxed); }
+  int64 misses() const { return misses_.load(std::memory_order_relaxed); }
+
+ private:
+  // Returns hash table bucket for symbol name hash.
+  int Bucket(Handle hash) const;
+
+  // Global store for cached symbols.
+  const Store *globals_;
+
+  // Hash table with cached symbols. Entries are never changed or removed once
+  // they have been added to the table, so lookups do not need any locking.
+  std::atomic<Entry *> *table_;
+  int mask_;
+
+  // Number of entries in table and maximum number of entries.
+  std::atomic<int> size_{0};
+  int limit_;
+
+  // Cache statistics.
+  std::atomic<int64> hits_{0};
+  std::atomic<int64> misses_{0};
+
+  DISALLOW_COPY_AND_ASSIGN(SymbolCache);
+};
+
+}  // namespace sling
+
+#endif  // FRAME_SYMBOL_CACHE_H_
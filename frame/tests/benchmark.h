@@ -0,0 +1,46 @@
+// Copyright 2017 Google Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef FRAME_TESTS_BENCHMARK_H_
+#define FRAME_TESTS_BENCHMARK_H_
+
+#include <stdio.h>
+
+#include "base/clock.h"
+#include "base/types.h"
+
+namespace sling {
+
+// Simple linear congruential random number generator for generating
+// reproducible benchmark data.
+inline uint32 Random(uint32 *seed) {
+  *seed = *seed * 1103515245 + 12345;
+  return *seed >> 8;
+}
+
+// Prints the average time per item for a benchmark.
+inline void ReportTime(const char *test, const Clock &clock, int64 n,
+                       const char *item) {
+  printf("%-24s %8.2f ns per %s\n", test, clock.ns() / n, item);
+}
+
+// Prints the throughput for a benchmark.
+inline void ReportThroughput(const char *test, const Clock &clock,
+                             int64 bytes) {
+  printf("%-24s %8.1f MB/s\n", test, bytes / clock.us());
+}
+
+}  // namespace sling
+
+#endif  // FRAME_TESTS_BENCHMARK_H_
@@ -0,0 +1,142 @@
+// Copyright 2017 Google Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <stdio.h>
+#include <string>
+
+#include "base/clock.h"
+#include "base/flags.h"
+#include "base/init.h"
+#include "base/logging.h"
+#include "base/types.h"
+#include "file/file.h"
+#include "frame/decoder.h"
+#include "frame/object.h"
+#include "frame/serialization.h"
+#include "frame/store.h"
+#include "frame/tests/benchmark.h"
+#include "stream/file.h"
+#include "stream/input.h"
+#include "string/strcat.h"
+
+DEFINE_string(input, "", "Encoded store file");
+DEFINE_string(scratch, "/tmp/file-input-benchmark.enc",
+              "File for generated store");
+DEFINE_int32(frames, 1000000, "Number of frames in generated store");
+DEFINE_int32(repeat, 5, "Number of times the file is read");
+
+using namespace sling;
+
+// Generates store with frames linked to each other and saves it to a file.
+static void GenerateStore(const string &filename) {
+  Store store;
+  uint32 seed = 12345;
+  for (int i = 0; i < FLAGS_frames; ++i) {
+    Builder b(&store);
+    b.AddId(StrCat("/kb/Q", i));
+    b.Add("name", StrCat("entity ", Random(&seed)));
+    b.Add("next", store.Lookup(StrCat("/kb/Q", Random(&seed) % FLAGS_frames)));
+    b.Add("weight", (Random(&seed) % 1000) / 1000.0f);
+    b.Create();
+  }
+  SaveStore(&store, filename);
+}
+
+// Opens file either as a memory-mapped stream or a buffered file stream.
+static InputStream *OpenStream(const string &filename, bool mapped) {
+  File *file = File::OpenOrDie(filename, "r");
+  if (mapped) {
+    InputStream *stream = MappedInputStream::Open(file);
+    CHECK(stream != nullptr) << "Cannot map " << filename;
+    CHECK(file->Close());
+    return stream;
+  } else {
+    return new FileInputStream(file);
+  }
+}
+
+// Reads all blocks from the stream and returns a checksum of the contents.
+static uint64 ReadStream(InputStream *stream) {
+  uint64 checksum = 0;
+  const void *data;
+  int size;
+  while (stream->Next(&data, &size)) {
+    const uint8 *p = static_cast<const uint8 *>(data);
+    for (int i = 0; i < size; i += 64) checksum += p[i];
+  }
+  return checksum;
+}
+
+// Decodes all objects in the stream and returns the number of objects.
+static int64 DecodeStream(InputStream *stream) {
+  Store store;
+  Input input(stream);
+  Decoder decoder(&store, &input);
+  store.LockGC();
+  decoder.DecodeAll();
+  store.UnlockGC();
+  MemoryUsage usage;
+  store.GetMemoryUsage(&usage, true);
+  return usage.used_handles();
+}
+
+int main(int argc, char **argv) {
+  InitProgram(&argc, &argv);
+
+  // Generate store file unless an input file is given.
+  string filename = FLAGS_input;
+  if (filename.empty()) {
+    filename = FLAGS_scratch;
+    GenerateStore(filename);
+  }
+  uint64 bytes;
+  CHECK(File::GetSize(filename, &bytes));
+  Clock clock;
+
+  // Read the file with and without memory mapping.
+  uint64 checksum[2] = {0, 0};
+  for (int mapped = 0; mapped < 2; ++mapped) {
+    clock.start();
+    for (int r = 0; r < FLAGS_repeat; ++r) {
+      InputStream *stream = OpenStream(filename, mapped);
+      checksum[mapped] += ReadStream(stream);
+      delete stream;
+    }
+    clock.stop();
+    const char *test =
+        mapped ? "MappedInputStream read" : "FileInputStream read";
+    ReportThroughput(test, clock, bytes * FLAGS_repeat);
+  }
+  CHECK_EQ(checksum[0], checksum[1]);
+
+  // Decode the file with and without memory mapping.
+  int64 handles[2] = {0, 0};
+  for (int mapped = 0; mapped < 2; ++mapped) {
+    clock.start();
+    for (int r = 0; r < FLAGS_repeat; ++r) {
+      InputStream *stream = OpenStream(filename, mapped);
+      handles[mapped] += DecodeStream(stream);
+      delete stream;
+    }
+    clock.stop();
+    const char *test =
+        mapped ? "MappedInputStream decode" : "FileInputStream decode";
+    ReportThroughput(test, clock, bytes * FLAGS_repeat);
+  }
+  CHECK_EQ(handles[0], handles[1]);
+  printf("%lld bytes\n", bytes);
+
+  if (FLAGS_input.empty()) CHECK(File::Delete(filename));
+  return 0;
+}
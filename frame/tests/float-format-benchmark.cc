@@ -0,0 +1,158 @@
+// Copyright 2017 Google Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <float.h>
+#include <stdio.h>
+#include <string.h>
+#include <string>
+#include <vector>
+
+#include "base/clock.h"
+#include "base/flags.h"
+#include "base/init.h"
+#include "base/logging.h"
+#include "base/types.h"
+#include "frame/object.h"
+#include "frame/serialization.h"
+#include "frame/store.h"
+#include "frame/tests/benchmark.h"
+#include "string/numbers.h"
+
+DEFINE_int32(numbers, 1000000, "Number of floats in conversion benchmark");
+DEFINE_int32(frames, 10000, "Number of frames in printer/reader benchmark");
+DEFINE_int32(dims, 64, "Number of floats in each frame");
+
+using namespace sling;
+
+// Returns random float. Most numbers are scores in [0;1] and embedding values
+// around zero, but some have large or small exponents.
+static float RandomFloat(uint32 *seed) {
+  float value = (Random(seed) & 0xFFFFF) / 1048576.0f;
+  switch (Random(seed) % 4) {
+    case 0: return value;
+    case 1: return value - 0.5f;
+    case 2: return (value - 0.5f) * 0.01f;
+    default: return value * (Random(seed) % 1000) * 1e6f;
+  }
+}
+
+// Previous conversion of floats to text, which first tries printing with
+// FLT_DIG digits and falls back to FLT_DIG + 2 digits if the number does not
+// parse back to the same float.
+static char *SnprintfFloatToBuffer(float value, char *buffer) {
+  snprintf(buffer, kFloatToBufferSize, "%.*g", FLT_DIG, value);
+  if (strtof(buffer, nullptr) != value) {
+    snprintf(buffer, kFloatToBufferSize, "%.*g", FLT_DIG + 2, value);
+  }
+  return buffer;
+}
+
+// Benchmarks conversion of floats to text and back.
+static void BenchmarkConversion() {
+  uint32 seed = 12345;
+  std::vector<float> numbers;
+  for (int i = 0; i < FLAGS_numbers; ++i) {
+    numbers.push_back(RandomFloat(&seed));
+  }
+  Clock clock;
+  char buffer[kFloatToBufferSize];
+
+  // Convert floats to text.
+  std::vector<string> texts;
+  int64 bytes = 0;
+  clock.start();
+  for (float value : numbers) {
+    bytes += strlen(SnprintfFloatToBuffer(value, buffer));
+  }
+  clock.stop();
+  ReportTime("snprintf", clock, numbers.size(), "float");
+
+  int64 shortest_bytes = 0;
+  clock.start();
+  for (float value : numbers) {
+    shortest_bytes += FastFloatToBufferLeft(value, buffer) - buffer;
+  }
+  clock.stop();
+  ReportTime("FastFloatToBufferLeft", clock, numbers.size(), "float");
+  printf("%.2f vs. %.2f bytes/float\n",
+         static_cast<double>(bytes) / numbers.size(),
+         static_cast<double>(shortest_bytes) / numbers.size());
+
+  // Convert text back to floats.
+  for (float value : numbers) {
+    texts.emplace_back(buffer, FastFloatToBufferLeft(value, buffer) - buffer);
+  }
+  float value;
+  clock.start();
+  for (const string &text : texts) {
+    CHECK(safe_strtof(text.c_str(), &value));
+  }
+  clock.stop();
+  ReportTime("strtof", clock, texts.size(), "float");
+
+  clock.start();
+  for (const string &text : texts) {
+    CHECK(safe_strtof(text.data(), text.size(), &value));
+  }
+  clock.stop();
+  ReportTime("safe_strtof", clock, texts.size(), "float");
+
+  // Check that all numbers are converted back to the same float.
+  for (int i = 0; i < texts.size(); ++i) {
+    CHECK(safe_strtof(texts[i].data(), texts[i].size(), &value));
+    CHECK_EQ(value, numbers[i]) << texts[i];
+  }
+}
+
+// Benchmarks printing and reading of frames with float vectors.
+static void BenchmarkPrinterAndReader() {
+  Store store;
+  uint32 seed = 12345;
+  Handles frames(&store);
+  for (int i = 0; i < FLAGS_frames; ++i) {
+    Handles values(&store);
+    for (int j = 0; j < FLAGS_dims; ++j) {
+      values.push_back(Handle::Float(RandomFloat(&seed)));
+    }
+    Builder b(&store);
+    b.Add("score", RandomFloat(&seed));
+    b.Add("embedding", Array(&store, values));
+    frames.push_back(b.Create().handle());
+  }
+  Array all(&store, frames);
+  int64 count = FLAGS_frames * (FLAGS_dims + 1);
+  Clock clock;
+
+  clock.start();
+  string text = ToText(all);
+  clock.stop();
+  ReportTime("Printer", clock, count, "float");
+
+  clock.start();
+  Store target;
+  Object result = FromText(&target, text);
+  clock.stop();
+  CHECK(result.IsArray());
+  ReportTime("Reader", clock, count, "float");
+  printf("%lld bytes of text\n", static_cast<int64>(text.size()));
+}
+
+int main(int argc, char **argv) {
+  InitProgram(&argc, &argv);
+
+  BenchmarkConversion();
+  BenchmarkPrinterAndReader();
+
+  return 0;
+}
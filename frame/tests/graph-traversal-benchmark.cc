@@ -0,0 +1,157 @@
+// Copyright 2017 Google Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <stdio.h>
+#include <string>
+#include <vector>
+
+#include "base/clock.h"
+#include "base/flags.h"
+#include "base/init.h"
+#include "base/logging.h"
+#include "base/types.h"
+#include "frame/object.h"
+#include "frame/store.h"
+#include "frame/tests/benchmark.h"
+#include "frame/traversal.h"
+#include "string/strcat.h"
+
+DEFINE_int32(frames, 1000000, "Number of frames in generated graph");
+DEFINE_int32(types, 10000, "Number of types in generated type hierarchy");
+DEFINE_int32(links, 4, "Number of links from each frame");
+DEFINE_int32(queries, 1000, "Number of queries per measurement");
+DEFINE_int32(threads, 8, "Number of threads for parallel traversal");
+
+using namespace sling;
+
+// Builds a frozen store with a type hierarchy and a random graph of frames.
+// Each type is a subtype of a random type with a lower number, and each frame
+// is an instance of a random type with random links to other frames.
+static void BuildGraph(Store *store, Handle link) {
+  uint32 seed = 12345;
+  for (int i = 0; i < FLAGS_types; ++i) {
+    Builder b(store);
+    b.AddId(StrCat("/t/", i));
+    if (i > 0) b.AddIsA(StrCat("/t/", Random(&seed) % i));
+    b.Create();
+  }
+  for (int i = 0; i < FLAGS_frames; ++i) {
+    Builder b(store);
+    b.AddId(StrCat("/f/", i));
+    b.AddIsA(StrCat("/t/", Random(&seed) % FLAGS_types));
+    for (int j = 0; j < FLAGS_links; ++j) {
+      b.Add(link, store->Lookup(StrCat("/f/", Random(&seed) % FLAGS_frames)));
+    }
+    b.Create();
+  }
+  store->Freeze();
+}
+
+// Computes isa closure with hand-written recursion over frame objects.
+static void RecursiveClosure(const Frame &frame, HandleSet *closure) {
+  if (!closure->insert(frame.handle()).second) return;
+  for (const Slot &slot : frame) {
+    if (slot.name == Handle::isa()) {
+      RecursiveClosure(Frame(frame.store(), slot.value), closure);
+    }
+  }
+}
+
+// Returns random frame from the graph.
+static Handle RandomFrame(Store *store, uint32 *seed) {
+  return store->Lookup(StrCat("/f/", Random(seed) % FLAGS_frames));
+}
+
+int main(int argc, char **argv) {
+  InitProgram(&argc, &argv);
+
+  Clock clock;
+  clock.start();
+  Store store;
+  Handle link = store.Lookup("link");
+  BuildGraph(&store, link);
+  clock.stop();
+  printf("Graph with %d frames built in %.1f ms\n", FLAGS_frames, clock.ms());
+
+  // Select random start frames.
+  uint32 seed = 54321;
+  std::vector<Handle> starts;
+  for (int i = 0; i < FLAGS_queries; ++i) {
+    starts.push_back(RandomFrame(&store, &seed));
+  }
+
+  // Transitive isa closures.
+  std::vector<Handle> result;
+  Traversal isa(&store);
+  isa.set_roles({Handle::isa()});
+  int64 recursive_size = 0;
+  clock.start();
+  for (Handle start : starts) {
+    HandleSet closure;
+    RecursiveClosure(Frame(&store, start), &closure);
+    recursive_size += closure.size();
+  }
+  clock.stop();
+  double recursive_time = clock.us() / FLAGS_queries;
+  int64 closure_size = 0;
+  clock.start();
+  for (Handle start : starts) {
+    isa.Closure({start}, &result);
+    closure_size += result.size();
+  }
+  clock.stop();
+  double closure_time = clock.us() / FLAGS_queries;
+  CHECK_EQ(recursive_size, closure_size);
+  printf("isa closure: recursive %.2f us, traversal %.2f us\n",
+         recursive_time, closure_time);
+
+  // Neighborhoods and reachability along links.
+  for (int threads : {1, FLAGS_threads}) {
+    Traversal links(&store, threads);
+    links.set_roles({link});
+    for (int hops : {2, 4, 6}) {
+      int64 size = 0;
+      int queries = FLAGS_queries / (1 << hops) + 1;
+      clock.start();
+      for (int i = 0; i < queries; ++i) {
+        links.Neighborhood({starts[i]}, hops, &result);
+        size += result.size();
+      }
+      clock.stop();
+      printf("%d threads: %d-hop neighborhood %.2f us, %.1f frames\n",
+             threads, hops, clock.us() / queries,
+             static_cast<double>(size) / queries);
+    }
+
+    clock.start();
+    links.Closure({starts[0]}, &result);
+    clock.stop();
+    printf("%d threads: reachable set with %d frames in %.2f ms\n",
+           threads, static_cast<int>(result.size()), clock.ms());
+
+    int64 length = 0;
+    int paths = FLAGS_queries / 10 + 1;
+    clock.start();
+    for (int i = 0; i < paths; ++i) {
+      if (links.ShortestPath(starts[i], starts[i + 1], &result)) {
+        length += result.size() - 1;
+      }
+    }
+    clock.stop();
+    printf("%d threads: shortest path %.2f us, %.2f hops\n",
+           threads, clock.us() / paths, static_cast<double>(length) / paths);
+  }
+
+  return 0;
+}
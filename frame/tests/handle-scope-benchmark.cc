@@ -0,0 +1,143 @@
+// Copyright 2017 Google Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <stdio.h>
+
+#include "base/clock.h"
+#include "base/flags.h"
+#include "base/init.h"
+#include "base/logging.h"
+#include "base/types.h"
+#include "frame/object.h"
+#include "frame/store.h"
+#include "frame/tests/benchmark.h"
+
+DEFINE_int32(frames, 100000, "Number of frames in benchmark store");
+DEFINE_int32(repeat, 20, "Number of passes over the frames per measurement");
+
+using namespace sling;
+
+// Builds a chain of frames in an unfrozen store, where each frame has a value,
+// a type, and a link to the next frame.
+static void BuildChain(Store *store, Handle type, Handle value, Handle next,
+                       Handles *frames) {
+  Frame last;
+  for (int i = FLAGS_frames - 1; i >= 0; --i) {
+    Builder b(store);
+    b.AddIsA(type);
+    b.Add(value, i);
+    if (last.valid()) b.Add(next, last);
+    last = b.Create();
+    frames->push_back(last.handle());
+  }
+}
+
+int main(int argc, char **argv) {
+  InitProgram(&argc, &argv);
+
+  Store store;
+  Handle type = store.Lookup("type");
+  Handle value = store.Lookup("value");
+  Handle next = store.Lookup("next");
+  Handles frames(&store);
+  BuildChain(&store, type, value, next, &frames);
+  int64 n = static_cast<int64>(FLAGS_frames) * FLAGS_repeat;
+  Clock clock;
+
+  // Read slot value from each frame.
+  int64 frame_sum = 0;
+  clock.start();
+  for (int r = 0; r < FLAGS_repeat; ++r) {
+    for (Handle h : frames) {
+      Frame f(&store, h);
+      frame_sum += f.GetInt(value);
+    }
+  }
+  clock.stop();
+  ReportTime("Frame get", clock, n, "frame");
+
+  int64 scoped_sum = 0;
+  clock.start();
+  HandleScope scope(&store);
+  for (int r = 0; r < FLAGS_repeat; ++r) {
+    for (Handle h : frames) {
+      ScopedFrame f(&scope, h);
+      scoped_sum += f.GetInt(value);
+      scope.Release(0);
+    }
+  }
+  clock.stop();
+  ReportTime("Scoped get", clock, n, "frame");
+  CHECK_EQ(frame_sum, scoped_sum);
+
+  // Follow links from the head of the chain.
+  int64 frame_length = 0;
+  clock.start();
+  for (int r = 0; r < FLAGS_repeat; ++r) {
+    Frame f(&store, frames.back());
+    while (f.valid()) {
+      frame_length++;
+      f = f.GetFrame(next);
+    }
+  }
+  clock.stop();
+  ReportTime("Frame walk", clock, n, "frame");
+
+  int64 scoped_length = 0;
+  clock.start();
+  for (int r = 0; r < FLAGS_repeat; ++r) {
+    ScopedFrame f(&scope, frames.back());
+    while (f.valid()) {
+      scoped_length++;
+      f = f.GetFrame(next);
+    }
+    scope.Release(0);
+  }
+  clock.stop();
+  ReportTime("Scoped walk", clock, n, "frame");
+  CHECK_EQ(frame_length, scoped_length);
+
+  // Iterate over slots and check types.
+  int64 frame_slots = 0;
+  clock.start();
+  for (int r = 0; r < FLAGS_repeat; ++r) {
+    for (Handle h : frames) {
+      Frame f(&store, h);
+      if (!f.IsA(type)) continue;
+      for (const Slot &slot : f) {
+        if (slot.value.IsInt()) frame_slots++;
+      }
+    }
+  }
+  clock.stop();
+  ReportTime("Frame slots", clock, n, "frame");
+
+  int64 scoped_slots = 0;
+  clock.start();
+  for (int r = 0; r < FLAGS_repeat; ++r) {
+    for (Handle h : frames) {
+      ScopedFrame f(&scope, h);
+      if (!f.IsA(type)) continue;
+      for (const Slot &slot : f) {
+        if (slot.value.IsInt()) scoped_slots++;
+      }
+    }
+    scope.Release(0);
+  }
+  clock.stop();
+  ReportTime("Scoped slots", clock, n, "frame");
+  CHECK_EQ(frame_slots, scoped_slots);
+
+  return 0;
+}
@@ -0,0 +1,128 @@
+// Copyright 2017 Google Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <stdio.h>
+#include <string>
+
+#include "base/clock.h"
+#include "base/flags.h"
+#include "base/init.h"
+#include "base/logging.h"
+#include "base/types.h"
+#include "frame/reader.h"
+#include "frame/store.h"
+#include "frame/tests/benchmark.h"
+#include "frame/tokenizer.h"
+#include "stream/file-input.h"
+#include "stream/memory.h"
+#include "string/strcat.h"
+
+DEFINE_string(input, "", "JSON file with a sequence of JSON objects");
+DEFINE_int32(megabytes, 256, "Size of generated JSON input in megabytes");
+
+using namespace sling;
+
+// Generates indented JSON objects resembling a knowledge base dump.
+static void GenerateJSON(string *json, int64 size) {
+  uint32 seed = 12345;
+  int64 id = 0;
+  while (json->size() < size) {
+    StrAppend(json, "{\n  \"id\": \"Q", id++, "\",\n");
+    StrAppend(json, "  \"labels\": {\n");
+    StrAppend(json, "    \"en\": {\"language\": \"en\", \"value\": \"Entity ",
+              Random(&seed), " with a somewhat longer label\"},\n");
+    StrAppend(json, "    \"de\": {\"language\": \"de\", \"value\": \"Ding ",
+              Random(&seed), " mit \\\"Zitat\\\" und \\u00e9\"}\n  },\n");
+    StrAppend(json, "  \"claims\": [\n");
+    int claims = 1 + Random(&seed) % 8;
+    for (int i = 0; i < claims; ++i) {
+      StrAppend(json, "    {\"property\": \"P", Random(&seed) % 3000,
+                "\", \"value\": ", Random(&seed) % 1000000,
+                ", \"weight\": ", (Random(&seed) % 1000) / 1000.0,
+                i + 1 < claims ? "},\n" : "}\n");
+    }
+    StrAppend(json, "  ]\n}\n");
+  }
+}
+
+// Tokenizes the input and returns the number of tokens.
+static int64 Tokenize(Input *input) {
+  Tokenizer tokenizer(input);
+  int64 tokens = 0;
+  while (!tokenizer.done()) {
+    CHECK(!tokenizer.error()) << tokenizer.error_message();
+    tokenizer.NextToken();
+    tokens++;
+  }
+  return tokens;
+}
+
+// Reads the JSON objects in the input and returns the number of objects.
+static int64 Read(Input *input) {
+  Store store;
+  Reader reader(&store, input);
+  reader.set_json(true);
+  int64 objects = 0;
+  while (!reader.done()) {
+    reader.Read();
+    CHECK(!reader.error()) << reader.error_message();
+    objects++;
+  }
+  return objects;
+}
+
+int main(int argc, char **argv) {
+  InitProgram(&argc, &argv);
+
+  string json;
+  int64 bytes = 0;
+  if (FLAGS_input.empty()) {
+    GenerateJSON(&json, static_cast<int64>(FLAGS_megabytes) << 20);
+    bytes = json.size();
+  }
+  Clock clock;
+
+  // Tokenize input. The size of an input file is the number of bytes read,
+  // i.e. after decompression.
+  clock.start();
+  int64 tokens;
+  if (FLAGS_input.empty()) {
+    StringInputStream stream(json);
+    Input input(&stream);
+    tokens = Tokenize(&input);
+  } else {
+    FileInput input(FLAGS_input);
+    tokens = Tokenize(&input);
+    bytes = input.stream()->ByteCount();
+  }
+  clock.stop();
+  ReportThroughput("Tokenizer", clock, bytes);
+
+  // Read JSON objects from input.
+  clock.start();
+  int64 objects;
+  if (FLAGS_input.empty()) {
+    StringInputStream stream(json);
+    Input input(&stream);
+    objects = Read(&input);
+  } else {
+    FileInput input(FLAGS_input);
+    objects = Read(&input);
+  }
+  clock.stop();
+  ReportThroughput("Reader", clock, bytes);
+
+  printf("%lld bytes, %lld tokens, %lld objects\n", bytes, tokens, objects);
+  return 0;
+}
@@ -0,0 +1,206 @@
+// Copyright 2017 Google Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <algorithm>
+#include <string>
+#include <vector>
+
+#include "base/flags.h"
+#include "base/init.h"
+#include "base/logging.h"
+#include "base/types.h"
+#include "file/file.h"
+#include "frame/object.h"
+#include "frame/role-index.h"
+#include "frame/store.h"
+#include "string/strcat.h"
+
+DEFINE_string(scratch, "/tmp/role-index-test.idx", "Scratch file for index");
+
+using namespace sling;
+
+// Number of person frames in test store.
+static const int kPersons = 100;
+
+// Builds a frozen store with person frames. Each person has a type, an age, a
+// name string shared by every fifth person, and one or two tags.
+static void BuildStore(Store *store) {
+  Handle type = store->Lookup("type");
+  Handle age = store->Lookup("age");
+  Handle name = store->Lookup("name");
+  Handle tag = store->Lookup("tag");
+  for (int i = 0; i < kPersons; ++i) {
+    Builder b(store);
+    b.AddId(StrCat("/p/", i));
+    b.Add(type, store->Lookup(i % 2 == 0 ? "/t/even" : "/t/odd"));
+    b.Add(age, i % 10);
+    b.Add(name, StrCat("person ", i % 5));
+    b.Add(tag, store->Lookup(StrCat("/tag/", i % 3)));
+    if (i % 4 == 0) b.Add(tag, store->Lookup("/tag/quad"));
+    b.Create();
+  }
+  store->Freeze();
+}
+
+// Returns the person numbers in a posting list and checks that the list is
+// sorted by handle.
+static std::vector<int> Persons(Store *store,
+                                const RoleIndex::Postings &postings) {
+  std::vector<int> persons;
+  for (const Handle *h = postings.begin; h < postings.end; ++h) {
+    if (h > postings.begin) CHECK_LT(h[-1].raw(), h->raw());
+    Text id = Frame(store, *h).Id();
+    CHECK(id.starts_with("/p/")) << id;
+    persons.push_back(std::stoi(id.substr(3).str()));
+  }
+  std::sort(persons.begin(), persons.end());
+  return persons;
+}
+
+// Returns the persons in 0..kPersons-1 matching a predicate.
+template<class P> static std::vector<int> Expected(P predicate) {
+  std::vector<int> persons;
+  for (int i = 0; i < kPersons; ++i) {
+    if (predicate(i)) persons.push_back(i);
+  }
+  return persons;
+}
+
+// Checks lookups for handle, integer, and string values.
+static void TestLookup(Store *store, const RoleIndex &index) {
+  Handle type = store->LookupExisting("type");
+  Handle age = store->LookupExisting("age");
+  Handle name = store->LookupExisting("name");
+  Handle even = store->LookupExisting("/t/even");
+
+  auto postings = index.Lookup(type, even);
+  CHECK_EQ(postings.size(), kPersons / 2);
+  auto persons = Expected([](int i) { return i % 2 == 0; });
+  CHECK(Persons(store, postings) == persons);
+
+  postings = index.Lookup(age, Handle::Integer(3));
+  persons = Expected([](int i) { return i % 10 == 3; });
+  CHECK(Persons(store, postings) == persons);
+
+  // Names are separate string objects, but they are indexed by content.
+  persons = Expected([](int i) { return i % 5 == 2; });
+  postings = index.Lookup(name, "person 2");
+  CHECK(Persons(store, postings) == persons);
+  Frame p7(store, store->LookupExisting("/p/7"));
+  postings = index.Lookup(name, p7.GetHandle("name"));
+  CHECK(Persons(store, postings) == persons);
+
+  // Missing values and roles have empty posting lists.
+  CHECK(index.Lookup(name, "nobody").empty());
+  CHECK(index.Lookup(age, Handle::Integer(10)).empty());
+  CHECK(index.Lookup(store->LookupExisting("/p/0"), even).empty());
+  CHECK(index.Lookup(type, Handle::nil()).empty());
+}
+
+// Checks that frames with several values for a role are in the posting lists
+// for each of the values.
+static void TestSetValuedRoles(Store *store, const RoleIndex &index) {
+  Handle tag = store->LookupExisting("tag");
+  auto quad = index.Lookup(tag, store->LookupExisting("/tag/quad"));
+  CHECK(Persons(store, quad) == Expected([](int i) { return i % 4 == 0; }));
+  for (int t = 0; t < 3; ++t) {
+    Handle value = store->LookupExisting(StrCat("/tag/", t));
+    auto postings = index.Lookup(tag, value);
+    CHECK(Persons(store, postings) ==
+          Expected([t](int i) { return i % 3 == t; }));
+  }
+}
+
+// Checks intersection of posting lists.
+static void TestIntersect(Store *store, const RoleIndex &index) {
+  Handle type = store->LookupExisting("type");
+  Handle age = store->LookupExisting("age");
+  Handle name = store->LookupExisting("name");
+  Handle tag = store->LookupExisting("tag");
+  std::vector<Handle> result;
+
+  std::vector<RoleIndex::Postings> lists;
+  lists.push_back(index.Lookup(type, store->LookupExisting("/t/even")));
+  lists.push_back(index.Lookup(age, Handle::Integer(4)));
+  lists.push_back(index.Lookup(tag, store->LookupExisting("/tag/quad")));
+  RoleIndex::Intersect(lists, &result);
+  RoleIndex::Postings matches{result.data(), result.data() + result.size()};
+  CHECK(Persons(store, matches) == Expected([](int i) {
+    return i % 10 == 4 && i % 4 == 0;
+  }));
+
+  // A single list is returned as is.
+  lists.resize(1);
+  RoleIndex::Intersect(lists, &result);
+  CHECK_EQ(result.size(), kPersons / 2);
+
+  // Disjoint lists and empty lists give no frames.
+  lists.push_back(index.Lookup(type, store->LookupExisting("/t/odd")));
+  RoleIndex::Intersect(lists, &result);
+  CHECK(result.empty());
+  lists.push_back(index.Lookup(name, "nobody"));
+  RoleIndex::Intersect(lists, &result);
+  CHECK(result.empty());
+  RoleIndex::Intersect(std::vector<RoleIndex::Postings>(), &result);
+  CHECK(result.empty());
+}
+
+// Checks that only the requested roles are indexed.
+static void TestRoles(Store *store) {
+  Handle type = store->LookupExisting("type");
+  Handle age = store->LookupExisting("age");
+  RoleIndex index(store);
+  index.Build({type});
+  CHECK_EQ(index.num_keys(), 2);
+  CHECK_EQ(index.num_postings(), kPersons);
+  CHECK_EQ(index.Lookup(type, store->LookupExisting("/t/odd")).size(),
+           kPersons / 2);
+  CHECK(index.Lookup(age, Handle::Integer(3)).empty());
+}
+
+// Checks that a saved index can be loaded for the same store only.
+static void TestSaveLoad(Store *store, const RoleIndex &index) {
+  CHECK(index.Save(FLAGS_scratch));
+  RoleIndex loaded(store);
+  CHECK(loaded.Load(FLAGS_scratch));
+  CHECK_EQ(loaded.num_keys(), index.num_keys());
+  CHECK_EQ(loaded.num_postings(), index.num_postings());
+  TestLookup(store, loaded);
+  TestSetValuedRoles(store, loaded);
+
+  Store other;
+  other.Freeze();
+  RoleIndex mismatch(&other);
+  CHECK(!mismatch.Load(FLAGS_scratch));
+  CHECK(File::Delete(FLAGS_scratch));
+  CHECK(!mismatch.Load(FLAGS_scratch));
+}
+
+int main(int argc, char **argv) {
+  InitProgram(&argc, &argv);
+
+  Store store;
+  BuildStore(&store);
+  RoleIndex index(&store);
+  index.Build();
+
+  TestLookup(&store, index);
+  TestSetValuedRoles(&store, index);
+  TestIntersect(&store, index);
+  TestRoles(&store);
+  TestSaveLoad(&store, index);
+
+  LOG(INFO) << "PASS";
+  return 0;
+}
@@ -0,0 +1,118 @@
+// Copyright 2017 Google Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "base/clock.h"
+#include "base/flags.h"
+#include "base/init.h"
+#include "base/logging.h"
+#include "base/types.h"
+#include "frame/object.h"
+#include "frame/store.h"
+#include "string/strcat.h"
+
+DEFINE_int32(lookups, 1000000, "Number of slot lookups per measurement");
+DEFINE_int32(threshold, 16, "Slot index threshold for indexed store");
+
+using namespace sling;
+
+// Builds a frozen store with one frame for each frame width and returns the
+// frame handles.
+static void BuildStore(Store *store, const std::vector<int> &widths,
+                       Handles *frames,
+                       std::vector<std::vector<Handle>> *names) {
+  for (int width : widths) {
+    Builder b(store);
+    std::vector<Handle> slots;
+    for (int i = 0; i < width; ++i) {
+      Handle name = store->Lookup(StrCat("/b/name", i));
+      b.Add(name, i);
+      slots.push_back(name);
+    }
+    frames->push_back(b.Create().handle());
+    names->push_back(slots);
+  }
+  store->Freeze();
+}
+
+// Finds slot value with a plain linear scan over the slots.
+static Handle LinearScan(const FrameDatum *frame, Handle name) {
+  for (const Slot *slot = frame->begin(); slot < frame->end(); ++slot) {
+    if (slot->name == name) return slot->value;
+  }
+  return Handle::nil();
+}
+
+// Looks up random slots in frame and returns the elapsed time in nanoseconds
+// per lookup. If linear is true, the slots are found with a linear scan instead
+// of FrameDatum::get().
+static double Benchmark(Store *store, Handle frame, bool linear,
+                        const std::vector<Handle> &names, int64 *checksum) {
+  FrameDatum *datum = store->GetFrame(frame);
+  uint32 seed = 12345;
+  int64 sum = 0;
+  Clock clock;
+  clock.start();
+  for (int i = 0; i < FLAGS_lookups; ++i) {
+    seed = seed * 1103515245 + 12345;
+    Handle name = names[(seed >> 8) % names.size()];
+    if (linear) {
+      sum += LinearScan(datum, name).AsInt();
+    } else {
+      sum += datum->get(name).AsInt();
+    }
+  }
+  clock.stop();
+  *checksum = sum;
+  return clock.ns() / FLAGS_lookups;
+}
+
+// Compares slot lookup time for linear scanning, SIMD scanning, and frames
+// with slot indexes.
+int main(int argc, char **argv) {
+  InitProgram(&argc, &argv);
+
+  std::vector<int> widths = {4, 8, 16, 32, 64, 128, 256, 512, 1024};
+
+  Store plain;
+  Handles plain_frames(&plain);
+  std::vector<std::vector<Handle>> plain_names;
+  BuildStore(&plain, widths, &plain_frames, &plain_names);
+
+  Store::Options options;
+  options.slot_index_threshold = FLAGS_threshold;
+  Store indexed(&options);
+  Handles indexed_frames(&indexed);
+  std::vector<std::vector<Handle>> indexed_names;
+  BuildStore(&indexed, widths, &indexed_frames, &indexed_names);
+
+  std::cout << "slots linear ns   scan ns  index ns\n";
+  for (int i = 0; i < widths.size(); ++i) {
+    int64 linear_sum, scan_sum, indexed_sum;
+    double linear = Benchmark(&plain, plain_frames[i], true, plain_names[i],
+                              &linear_sum);
+    double scan = Benchmark(&plain, plain_frames[i], false, plain_names[i],
+                            &scan_sum);
+    double index = Benchmark(&indexed, indexed_frames[i], false,
+                             indexed_names[i], &indexed_sum);
+    CHECK_EQ(linear_sum, scan_sum);
+    CHECK_EQ(linear_sum, indexed_sum);
+    printf("%5d %11.2f %9.2f %9.2f\n", widths[i], linear, scan, index);
+  }
+
+  return 0;
+}
@@ -0,0 +1,428 @@
+// Copyright 2017 Google Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <string>
+
+#include "base/flags.h"
+#include "base/init.h"
+#include "base/logging.h"
+#include "base/types.h"
+#include "file/file.h"
+#include "frame/object.h"
+#include "frame/serialization.h"
+#include "frame/store-pool.h"
+#include "frame/store.h"
+#include "frame/tests/benchmark.h"
+#include "string/strcat.h"
+
+DEFINE_string(scratch, "/tmp/store-test", "Prefix for scratch files");
+
+using namespace sling;
+
+// Number of frames and frames per block in graph for parallel marking test.
+static const int kFrames = 1000000;
+static const int kBlock = 1000;
+
+// Builds a store with blocks of randomly linked frames where only some of the
+// blocks are reachable from named frames. The heap is larger than the minimum
+// size for parallel marking.
+static void BuildGraph(Store *store) {
+  uint32 seed = 12345;
+  Handles frames(store);
+  for (int i = 0; i < kFrames; ++i) {
+    int base = i - i % kBlock;
+    Builder b(store);
+    b.Add("index", i);
+    if (i > base) b.Add("prev", frames[i - 1]);
+    if (i > base) b.Add("link", frames[base + Random(&seed) % (i - base)]);
+    if (i % 16 == 0) b.Add("text", StrCat("frame ", i));
+    frames.push_back(b.Create().handle());
+  }
+
+  // Frames are only reachable through named frames, so the blocks that are
+  // not referenced by a named frame become garbage.
+  for (int i = 0; i < kFrames; i += kBlock) {
+    if (Random(&seed) % 3 == 0) continue;
+    Builder b(store);
+    b.AddId(StrCat("root", i));
+    b.Add("frame", frames[i + kBlock - 1 - Random(&seed) % 10]);
+    b.Create();
+  }
+}
+
+// Builds graph in a store marking with a number of threads, and collects it.
+// Returns the memory usage after collection and the sums of the indices in the
+// surviving chains.
+static void CollectGraph(int threads, MemoryUsage *usage, string *sums) {
+  Store::Options options;
+  options.mark_threads = threads;
+  Store store(&options);
+  BuildGraph(&store);
+  MemoryUsage before;
+  store.GetMemoryUsage(&before);
+  CHECK_GE(before.used_heap_bytes(), 16 << 20);
+
+  // Collect twice to reuse the marking threads.
+  store.GC();
+  store.GC();
+  store.GetMemoryUsage(usage);
+  CHECK_LT(usage->used_handles(), before.used_handles());
+
+  sums->clear();
+  for (int i = 0; i < kFrames; i += kBlock) {
+    Handle root = store.LookupExisting(StrCat("root", i));
+    if (root.IsNil()) continue;
+    Frame f = Frame(&store, root).GetFrame("frame");
+    int64 sum = 0;
+    while (f.valid()) {
+      sum += f.GetInt("index");
+      f = f.GetFrame("prev");
+    }
+    sums->append(StrCat(sum, " "));
+  }
+}
+
+// Checks that garbage collection with parallel marking keeps the same objects
+// as marking with one thread.
+static void TestParallelMark() {
+  MemoryUsage reference;
+  string expected;
+  CollectGraph(1, &reference, &expected);
+  for (int threads : {2, 4, 8}) {
+    MemoryUsage usage;
+    string sums;
+    CollectGraph(threads, &usage, &sums);
+    CHECK_EQ(usage.used_handles(), reference.used_handles()) << threads;
+    CHECK_EQ(usage.used_heap_bytes(), reference.used_heap_bytes()) << threads;
+    CHECK_EQ(sums, expected) << threads;
+  }
+}
+
+// Checks that a store loaded from a snapshot has the same frames as the
+// original store, and that local stores can use it as their global store.
+static void TestSnapshot() {
+  string source = FLAGS_scratch + ".sling";
+  string snapshot = FLAGS_scratch + ".snap";
+  Store global;
+  for (int i = 0; i < 10000; ++i) {
+    Builder b(&global);
+    b.AddId(StrCat("/kb/Q", i));
+    b.Add("name", StrCat("entity ", i));
+    b.Add("rank", i);
+    if (i > 0) b.Add("parent", global.Lookup(StrCat("/kb/Q", i / 2)));
+    b.Create();
+  }
+  global.Symbol("unbound");
+  global.Freeze();
+  CHECK(File::WriteContents(source, "source"));
+  CHECK(global.WriteSnapshot(snapshot, source));
+  CHECK(Store::ValidSnapshot(snapshot));
+  CHECK(Store::ValidSnapshot(snapshot, source));
+
+  {
+    Store::Options options;
+    Store mapped(&options, snapshot);
+    CHECK(mapped.mapped());
+    CHECK(mapped.frozen());
+    for (int i = 0; i < 10000; ++i) {
+      string id = StrCat("/kb/Q", i);
+      Handle h = mapped.LookupExisting(id);
+      CHECK(!h.IsNil()) << id;
+      CHECK_EQ(ToText(&mapped, h), ToText(&global, global.LookupExisting(id)));
+    }
+
+    // Looking up unbound global symbols binds local symbols and leaves the
+    // read-only global store unchanged.
+    Store local(&mapped);
+    Builder b(&local);
+    b.Add("ref", local.Lookup("/kb/Q42"));
+    b.Add("unbound", local.Lookup("unbound"));
+    Frame f = b.Create();
+    CHECK_EQ(f.GetFrame("ref").GetInt("rank"), 42);
+    CHECK(local.IsProxy(f.GetHandle("unbound")));
+    CHECK(local.Lookup("unbound") == f.GetHandle("unbound"));
+    CHECK(mapped.LookupExisting("unbound").IsNil());
+  }
+
+  // The snapshot is stale once the source file changes.
+  CHECK(File::WriteContents(source, "rebuilt source"));
+  CHECK(Store::ValidSnapshot(snapshot));
+  CHECK(!Store::ValidSnapshot(snapshot, source));
+
+  CHECK(File::Delete(source));
+  CHECK(File::Delete(snapshot));
+}
+
+// Allocates short-lived frames until the store has collected the nursery.
+static void FillNursery(Store *store) {
+  MemoryUsage usage;
+  store->GetMemoryUsage(&usage);
+  int collections = usage.num_minor_gcs;
+  for (int i = 0; i < 20000; ++i) {
+    Builder b(store);
+    b.Add("junk", i);
+    b.Create();
+  }
+  store->GetMemoryUsage(&usage);
+  CHECK_GT(usage.num_minor_gcs, collections);
+}
+
+// Checks that nursery objects only referenced from tenured objects survive
+// nursery collections.
+static void TestNursery() {
+  Store::Options options;
+  options.nursery_size = 64 * 1024;
+  Store global(&options);
+  global.Freeze();
+  Store store(&global);
+
+  // Named frames are promoted and anonymous frames are discarded.
+  Builder bb(&store);
+  bb.Add("x", 1);
+  Handle b = bb.Create().handle();
+  Builder ab(&store);
+  ab.AddId("a");
+  ab.Add("child", b);
+  Handle a = ab.Create().handle();
+  FillNursery(&store);
+  MemoryUsage usage;
+  store.GetMemoryUsage(&usage);
+  CHECK_GT(usage.nursery_size, 0);
+  CHECK_GT(usage.promoted_bytes, 0);
+  CHECK_LT(usage.promoted_bytes, 20000 * 16);
+  CHECK_EQ(Frame(&store, a).GetFrame("child").GetInt("x"), 1);
+  store.GC();
+
+  // Adding a slot to a tenured frame replaces it with a frame in the nursery.
+  Frame(&store, b).Add("y", 2);
+  store.GetMemoryUsage(&usage);
+  CHECK_GT(usage.num_remembered, 0);
+  FillNursery(&store);
+  Frame child = Frame(&store, a).GetFrame("child");
+  CHECK(child.handle() == b);
+  CHECK_EQ(child.GetInt("x"), 1);
+  CHECK_EQ(child.GetInt("y"), 2);
+
+  // The remembered set is cleared by the nursery collection.
+  store.GetMemoryUsage(&usage);
+  CHECK_EQ(usage.num_remembered, 0);
+
+  // Extended frames stored in a tenured frame.
+  Handle c = store.Extend(b, store.Lookup("z"), Handle::Integer(3));
+  Frame(&store, a).Set("extended", c);
+  FillNursery(&store);
+  Frame extended = Frame(&store, a).GetFrame("extended");
+  CHECK_EQ(extended.GetInt("x"), 1);
+  CHECK_EQ(extended.GetInt("y"), 2);
+  CHECK_EQ(extended.GetInt("z"), 3);
+
+  // Nursery frames stored in a tenured array.
+  Array array(&store, 1);
+  Frame(&store, a).Set("array", array);
+  store.GC();
+  Builder eb(&store);
+  eb.Add("element", 4);
+  array.set(0, eb.Create().handle());
+  FillNursery(&store);
+  Frame element(&store, Array(&store, Frame(&store, a).GetHandle("array")).get(0));
+  CHECK_EQ(element.GetInt("element"), 4);
+}
+
+// Checks that local stores from a store pool are reset and keep the memory for
+// the handle table and the heaps.
+// Checks that allocation sampling accounts for all the allocated bytes with
+// and without a nursery.
+static void TestAllocationSampling() {
+  for (int nursery_size : {0, 64 * 1024}) {
+    Store::Options options;
+    options.allocation_sampling = 4096;
+    options.nursery_size = nursery_size;
+    Store global(&options);
+    global.Freeze();
+    Store store(&global);
+    Handle junk = store.Lookup("junk");
+    for (int i = 0; i < 20000; ++i) {
+      Builder b(&store);
+      b.Add(junk, i);
+      b.Create();
+      if (i == 10000) store.GC();
+    }
+
+    std::vector<AllocationSample> samples;
+    store.GetAllocationSamples(&samples);
+    int64 count = 0;
+    int64 bytes = 0;
+    for (const AllocationSample &sample : samples) {
+      count += sample.count;
+      bytes += sample.bytes;
+    }
+    int64 expected = 20000 * (sizeof(Datum) + sizeof(Slot));
+    CHECK_GE(count, expected / 4096 - 1);
+    CHECK_LE(count, expected / 4096 + 1);
+    CHECK_GT(bytes, expected - 4096);
+    CHECK_LE(bytes, expected);
+  }
+}
+
+static void TestStorePool() {
+  Store global;
+  Builder gb(&global);
+  gb.AddId("global");
+  gb.Create();
+  global.Freeze();
+
+  StorePool pool(&global, 1);
+  Store *store = pool.Acquire();
+  for (int i = 0; i < 100000; ++i) {
+    Builder b(store);
+    b.AddId(StrCat("local", i));
+    b.Add("index", i);
+    b.Create();
+  }
+  MemoryUsage before;
+  store->GetMemoryUsage(&before);
+  CHECK_GE(before.used_handles(), 100000);
+  pool.Release(store);
+  CHECK_EQ(pool.num_free(), 1);
+
+  // The reset store is handed out again with its memory but no objects.
+  {
+    PooledStore reused(&pool);
+    CHECK(reused.store() == store);
+    CHECK_EQ(pool.num_free(), 0);
+    MemoryUsage after;
+    reused->GetMemoryUsage(&after);
+    CHECK_EQ(after.num_handles, before.num_handles);
+    CHECK_EQ(after.total_heap_size, before.total_heap_size);
+    CHECK_LT(after.used_handles(), 100);
+    CHECK(reused->LookupExisting("local0").IsNil());
+    CHECK(!reused->LookupExisting("global").IsNil());
+
+    Builder b(reused.store());
+    b.AddId("local0");
+    b.Add("index", 0);
+    CHECK_EQ(b.Create().GetInt("index"), 0);
+  }
+  CHECK_EQ(pool.num_free(), 1);
+
+  // Stores beyond the size of the free list are deleted.
+  Store *first = pool.Acquire();
+  Store *second = pool.Acquire();
+  CHECK(first == store);
+  CHECK(second != store);
+  pool.Release(first);
+  pool.Release(second);
+  CHECK_EQ(pool.num_free(), 1);
+}
+
+// Checks that changes in a fork are only visible in the parent store after
+// they have been committed.
+static void TestFork() {
+  Store global;
+  global.Freeze();
+  Store store(&global);
+  Handle handles[100];
+  for (int i = 0; i < 100; ++i) {
+    Builder b(&store);
+    b.AddId(StrCat("item", i));
+    b.Add("value", i);
+    handles[i] = b.Create().handle();
+  }
+
+  // Discarded fork.
+  Store *fork = store.Fork();
+  {
+    Frame f(fork, handles[0]);
+    f.Set("value", 1000);
+    CHECK_EQ(f.GetInt("value"), 1000);
+    CHECK_EQ(Frame(&store, handles[0]).GetInt("value"), 0);
+  }
+  delete fork;
+  CHECK_EQ(Frame(&store, handles[0]).GetInt("value"), 0);
+
+  // Committed fork with modified, new and garbage objects.
+  fork = store.Fork();
+  Handle added;
+  {
+    Frame f(fork, handles[1]);
+    f.Set("value", 1001);
+    for (int i = 0; i < 1000; ++i) {
+      Builder junk(fork);
+      junk.Add("junk", i);
+      junk.Create();
+    }
+    Builder b(fork);
+    b.AddId("added");
+    b.Add("item", handles[2]);
+    added = b.Create().handle();
+    f.Set("next", added);
+    fork->GC();
+    CHECK_EQ(Frame(&store, handles[1]).GetInt("value"), 1);
+    CHECK(Frame(fork, handles[0]).GetInt("value") == 0);
+  }
+  fork->Commit();
+  delete fork;
+  Frame f1(&store, handles[1]);
+  CHECK_EQ(f1.GetInt("value"), 1001);
+  CHECK(f1.GetHandle("next") == added);
+  CHECK(store.Lookup("added") == added);
+  CHECK(Frame(&store, added).GetHandle("item") == handles[2]);
+  for (int i = 2; i < 100; ++i) {
+    CHECK_EQ(Frame(&store, handles[i]).GetInt("value"), i);
+  }
+  store.GC();
+  CHECK_EQ(Frame(&store, handles[99]).GetInt("value"), 99);
+}
+
+// Checks that identical anonymous frames are merged.
+static void TestCoalesce() {
+  Store store;
+  for (int i = 0; i < 10; ++i) {
+    Builder inner(&store);
+    inner.Add("kind", "inner");
+    inner.Add("n", i % 2);
+    Builder b(&store);
+    b.AddId(StrCat("outer", i));
+    b.Add("inner", inner.Create());
+    b.Create();
+  }
+  store.CoalesceStrings();
+  store.CoalesceFrames();
+  store.GC();
+
+  for (int i = 2; i < 10; ++i) {
+    Frame outer(&store, store.Lookup(StrCat("outer", i)));
+    Frame same(&store, store.Lookup(StrCat("outer", i % 2)));
+    CHECK(outer.GetHandle("inner") == same.GetHandle("inner"));
+    CHECK_EQ(outer.GetFrame("inner").GetInt("n"), i % 2);
+  }
+  Frame even(&store, store.Lookup("outer0"));
+  Frame odd(&store, store.Lookup("outer1"));
+  CHECK(even.GetHandle("inner") != odd.GetHandle("inner"));
+}
+
+int main(int argc, char **argv) {
+  InitProgram(&argc, &argv);
+
+  TestParallelMark();
+  TestSnapshot();
+  TestNursery();
+  TestAllocationSampling();
+  TestStorePool();
+  TestFork();
+  TestCoalesce();
+
+  LOG(INFO) << "PASS";
+  return 0;
+}
@@ -0,0 +1,225 @@
+// Copyright 2017 Google Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <algorithm>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "base/init.h"
+#include "base/logging.h"
+#include "base/types.h"
+#include "frame/object.h"
+#include "frame/serialization.h"
+#include "frame/store.h"
+#include "frame/unifier.h"
+
+using namespace sling;
+
+// Parses frame in text format.
+static Frame Parse(Store *store, const string &text) {
+  return FromText(store, text).AsFrame();
+}
+
+// Unifies two frames in text format and returns the result.
+static Frame Unify(Store *store, const string &a, const string &b) {
+  Unifier unifier(store);
+  Handle result = unifier.Unify(Parse(store, a).handle(),
+                                Parse(store, b).handle());
+  return Frame(store, result);
+}
+
+// Returns the values for all the slots with a role in a frame.
+static std::vector<Handle> Values(const Frame &frame, Handle name) {
+  std::vector<Handle> values;
+  for (const Slot &slot : frame) {
+    if (slot.name == name) values.push_back(slot.value);
+  }
+  return values;
+}
+
+// Checks that the features of complex feature structures are merged.
+static void TestMerge() {
+  Store store;
+  Frame f = Unify(&store, "{a: 1 b: {c: 2}}", "{b: {d: 3} e: 4}");
+  CHECK(f.valid());
+  CHECK_EQ(f.size(), 3);
+  CHECK_EQ(f.GetInt("a"), 1);
+  CHECK_EQ(f.GetInt("e"), 4);
+  Frame b = f.GetFrame("b");
+  CHECK_EQ(b.size(), 2);
+  CHECK_EQ(b.GetInt("c"), 2);
+  CHECK_EQ(b.GetInt("d"), 3);
+
+  // Frames with ids are atomic values and are not copied.
+  Frame entity = Parse(&store, "{=/e/x name: \"x\"}");
+  f = Unify(&store, "{ref: /e/x}", "{ref: {}}");
+  CHECK(f.GetHandle("ref") == entity.handle());
+  f = Unify(&store, "{ref: /e/x}", "{ref: /e/x other: 1}");
+  CHECK(f.GetHandle("ref") == entity.handle());
+}
+
+// Checks that conflicting atomic values do not unify.
+static void TestConflicts() {
+  Store store;
+  Unifier unifier(&store);
+  Handle a = Parse(&store, "{a: 1}").handle();
+  Handle b = Parse(&store, "{a: 2}").handle();
+  CHECK(!unifier.Unifiable(a, b));
+  CHECK(unifier.Unify(a, b).IsNil());
+
+  CHECK(!Unify(&store, "{b: {c: 1}}", "{b: {c: 2}}").valid());
+  CHECK(!Unify(&store, "{ref: /e/x}", "{ref: /e/y}").valid());
+  CHECK(!Unify(&store, "{v: \"x\"}", "{v: {c: 1}}").valid());
+  CHECK(Unify(&store, "{v: /e/x}", "{v: /e/x}").valid());
+}
+
+// Checks that nil unifies with any value.
+static void TestNil() {
+  Store store;
+  Builder ab(&store);
+  ab.Add("a", Handle::nil());
+  ab.Add("b", 2);
+  Frame a = ab.Create();
+  Builder bb(&store);
+  bb.Add("a", 1);
+  bb.Add("b", Handle::nil());
+  Frame b = bb.Create();
+
+  Unifier unifier(&store);
+  Frame f(&store, unifier.Unify(a.handle(), b.handle()));
+  CHECK_EQ(f.GetInt("a"), 1);
+  CHECK_EQ(f.GetInt("b"), 2);
+
+  Handle frame = Parse(&store, "{a: 1}").handle();
+  Frame result(&store, unifier.Unify(Handle::nil(), frame));
+  CHECK_EQ(result.GetInt("a"), 1);
+  CHECK(unifier.Unify(Handle::nil(), Handle::nil()).IsNil());
+  CHECK(unifier.Unifiable(Handle::nil(), Handle::nil()));
+}
+
+// Checks that isa:, is:, and repeated roles are merged as sets.
+static void TestSetValuedRoles() {
+  Store store;
+  Handle ta = store.Lookup("/t/a");
+  Handle tb = store.Lookup("/t/b");
+  Unifier unifier(&store);
+  Builder ab(&store);
+  ab.AddIsA(ta);
+  Frame a = ab.Create();
+  Builder bb(&store);
+  bb.AddIsA(tb);
+  Frame b = bb.Create();
+  Frame f(&store, unifier.Unify(a.handle(), b.handle()));
+  CHECK_EQ(Values(f, Handle::isa()).size(), 2);
+  f = Frame(&store, unifier.Unify(a.handle(), a.handle()));
+  CHECK_EQ(Values(f, Handle::isa()).size(), 1);
+
+  Handle tag = store.Lookup("tag");
+  f = Unify(&store, "{tag: 1 tag: 2}", "{tag: 2 tag: 3}");
+  std::vector<Handle> tags = Values(f, tag);
+  CHECK_EQ(tags.size(), 3);
+  for (int i = 1; i <= 3; ++i) {
+    CHECK(std::find(tags.begin(), tags.end(), Handle::Integer(i)) !=
+          tags.end()) << i;
+  }
+
+  // A role is set-valued if it is repeated in either frame.
+  f = Unify(&store, "{tag: 1}", "{tag: 2 tag: 3}");
+  CHECK_EQ(Values(f, tag).size(), 3);
+}
+
+// Checks unification of cyclic feature structures.
+static void TestCycles() {
+  Store store;
+  Builder ab(&store);
+  ab.Add("name", "cycle");
+  Frame a = ab.Create();
+  a.Add("self", a);
+  Builder bb(&store);
+  bb.Add("other", 1);
+  Frame b = bb.Create();
+  b.Add("self", b);
+
+  Unifier unifier(&store);
+  Frame f(&store, unifier.Unify(a.handle(), b.handle()));
+  CHECK(f.valid());
+  CHECK(f.GetHandle("self") == f.handle());
+  CHECK_EQ(f.GetString("name"), "cycle");
+  CHECK_EQ(f.GetInt("other"), 1);
+
+  // A cycle unified with a chain collapses the chain into the cycle.
+  Builder cb(&store);
+  Frame c = cb.Create();
+  c.Add("next", c);
+  Frame chain = Parse(&store, "{next: {next: {v: 1}}}");
+  f = Frame(&store, unifier.Unify(c.handle(), chain.handle()));
+  CHECK(f.GetHandle("next") == f.handle());
+  CHECK_EQ(f.GetInt("v"), 1);
+
+  // Conflicts are found through cycles.
+  Frame conflict = Parse(&store, "{next: {next: {name: \"other\"}}}");
+  Builder db(&store);
+  db.Add("name", "cycle");
+  Frame d = db.Create();
+  d.Add("next", d);
+  CHECK(!unifier.Unifiable(d.handle(), conflict.handle()));
+  CHECK(unifier.Unify(d.handle(), conflict.handle()).IsNil());
+}
+
+// Checks the batch API and that input frames can be in the global store.
+static void TestBatch() {
+  Store global;
+  Handle x = Parse(&global, "{a: 1}").handle();
+  Handle y = Parse(&global, "{b: 2}").handle();
+  Handle z = Parse(&global, "{a: 3}").handle();
+  Frame root(&global, Parse(&global, "{=/roots x: 1}").handle());
+  root.Add("x", x);
+  root.Add("y", y);
+  root.Add("z", z);
+  global.Freeze();
+
+  Store store(&global);
+  Unifier unifier(&store);
+  std::vector<std::pair<Handle, Handle>> pairs = {{x, y}, {x, z}, {y, z}};
+  Handles results(&store);
+  CHECK_EQ(unifier.Unify(pairs, &results), 2);
+  CHECK_EQ(results.size(), 3);
+  Frame xy(&store, results[0]);
+  CHECK(xy.IsLocal());
+  CHECK_EQ(xy.GetInt("a"), 1);
+  CHECK_EQ(xy.GetInt("b"), 2);
+  CHECK(results[1].IsNil());
+  Frame yz(&store, results[2]);
+  CHECK_EQ(yz.GetInt("a"), 3);
+  CHECK_EQ(yz.GetInt("b"), 2);
+
+  // Results are kept alive by the caller across garbage collections.
+  store.GC();
+  CHECK_EQ(Frame(&store, results[0]).GetInt("b"), 2);
+}
+
+int main(int argc, char **argv) {
+  InitProgram(&argc, &argv);
+
+  TestMerge();
+  TestConflicts();
+  TestNil();
+  TestSetValuedRoles();
+  TestCycles();
+  TestBatch();
+
+  LOG(INFO) << "PASS";
+  return 0;
+}
@@ -0,0 +1,151 @@
+// Copyright 2017 Google Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <stdio.h>
+#include <string>
+#include <vector>
+
+#include "base/clock.h"
+#include "base/flags.h"
+#include "base/init.h"
+#include "base/logging.h"
+#include "base/types.h"
+#include "frame/object.h"
+#include "frame/serialization.h"
+#include "frame/store.h"
+#include "frame/tests/benchmark.h"
+#include "frame/wire.h"
+#include "stream/record.h"
+#include "string/strcat.h"
+
+DEFINE_string(commons, "", "Global store for documents");
+DEFINE_string(input, "", "Record file with encoded documents");
+DEFINE_int32(documents, 1000, "Maximum number of documents in benchmark");
+DEFINE_int32(repeat, 10, "Number of times each document is decoded");
+
+using namespace sling;
+
+// Builds a global store with a schema and a set of entities for the generated
+// documents.
+static void BuildCommons(Store *store) {
+  for (int i = 0; i < 100000; ++i) {
+    Builder b(store);
+    b.AddId(StrCat("/kb/Q", i));
+    b.Add("name", StrCat("entity ", i));
+    b.Create();
+  }
+}
+
+// Generates a document with tokens and mentions evoking entities.
+static Handle GenerateDocument(Store *store, uint32 *seed) {
+  Handles tokens(store);
+  Handles mentions(store);
+  int length = 100 + Random(seed) % 400;
+  for (int i = 0; i < length; ++i) {
+    Builder token(store);
+    token.AddIsA("/s/token");
+    token.Add("/s/token/index", i);
+    token.Add("/s/token/text", StrCat("w", Random(seed) % 10000));
+    token.Add("/s/token/start", i * 5);
+    token.Add("/s/token/length", 4);
+    tokens.push_back(token.Create().handle());
+    if (i % 8 == 0) {
+      Builder mention(store);
+      mention.AddIsA("/s/phrase");
+      mention.Add("/s/phrase/begin", i);
+      mention.Add("/s/phrase/evokes",
+                  store->Lookup(StrCat("/kb/Q", Random(seed) % 100000)));
+      mentions.push_back(mention.Create().handle());
+    }
+  }
+  Builder document(store);
+  document.AddIsA("/s/document");
+  document.Add("/s/document/tokens", Array(store, tokens));
+  document.Add("/s/document/mention", Array(store, mentions));
+  return document.Create().handle();
+}
+
+// Encodes document with wire format version.
+static string EncodeDocument(Store *store, Handle document, int version) {
+  StringEncoder encoder(store);
+  encoder.encoder()->set_version(version);
+  encoder.Encode(document);
+  return encoder.buffer();
+}
+
+// Decodes the documents and returns the time per document in microseconds.
+static double Benchmark(Store *commons, const std::vector<string> &documents) {
+  Clock clock;
+  clock.start();
+  for (int r = 0; r < FLAGS_repeat; ++r) {
+    for (const string &encoded : documents) {
+      Store store(commons);
+      StringDecoder decoder(&store, encoded);
+      decoder.Decode();
+    }
+  }
+  clock.stop();
+  return clock.us() / (documents.size() * FLAGS_repeat);
+}
+
+int main(int argc, char **argv) {
+  InitProgram(&argc, &argv);
+
+  // Initialize global store.
+  Store commons;
+  if (!FLAGS_commons.empty()) {
+    LoadStore(FLAGS_commons, &commons);
+  } else if (FLAGS_input.empty()) {
+    BuildCommons(&commons);
+  }
+  commons.Freeze();
+
+  // Encode the documents in all wire format versions.
+  const int kVersions[] = {WIRE_VERSION_1, WIRE_VERSION_2, WIRE_VERSION_3};
+  std::vector<string> encoded[3];
+  if (!FLAGS_input.empty()) {
+    RecordReader input(FLAGS_input);
+    Record record;
+    while (encoded[0].size() < FLAGS_documents && input.Read(&record)) {
+      Store store(&commons);
+      Object document = Decode(&store, record.value);
+      for (int v = 0; v < 3; ++v) {
+        encoded[v].push_back(
+            EncodeDocument(&store, document.handle(), kVersions[v]));
+      }
+    }
+    CHECK(input.status().ok()) << input.status();
+  } else {
+    uint32 seed = 12345;
+    for (int i = 0; i < FLAGS_documents; ++i) {
+      Store store(&commons);
+      Handle document = GenerateDocument(&store, &seed);
+      for (int v = 0; v < 3; ++v) {
+        encoded[v].push_back(EncodeDocument(&store, document, kVersions[v]));
+      }
+    }
+  }
+
+  // Report size and decoding time for all versions.
+  printf("%d documents\n", static_cast<int>(encoded[0].size()));
+  for (int v = 0; v < 3; ++v) {
+    int64 bytes = 0;
+    for (const string &document : encoded[v]) bytes += document.size();
+    printf("Version %d: %8.1f bytes %8.2f us per document\n", kVersions[v],
+           static_cast<double>(bytes) / encoded[v].size(),
+           Benchmark(&commons, encoded[v]));
+  }
+
+  return 0;
+}
@@ -0,0 +1,193 @@
+// Copyright 2017 Google Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <string>
+#include <vector>
+
+#include "base/flags.h"
+#include "base/init.h"
+#include "base/logging.h"
+#include "base/types.h"
+#include "file/file.h"
+#include "frame/object.h"
+#include "frame/serialization.h"
+#include "frame/store.h"
+#include "frame/tests/benchmark.h"
+#include "frame/wire.h"
+#include "frame/wire-view.h"
+#include "string/strcat.h"
+
+DEFINE_string(scratch, "/tmp/wire-format-test.sling", "Scratch file for store");
+
+using namespace sling;
+
+// Builds a global store with entities for documents to refer to.
+static void BuildCommons(Store *store) {
+  for (int i = 0; i < 1000; ++i) {
+    Builder b(store);
+    b.AddId(StrCat("/kb/Q", i));
+    b.Add("name", StrCat("entity ", i));
+    b.Create();
+  }
+}
+
+// Generates a document with tokens and mentions evoking entities. The tokens
+// share slot names, so they are encoded as shapes in version 3.
+static Handle GenerateDocument(Store *store, uint32 *seed) {
+  Handles tokens(store);
+  Handles mentions(store);
+  int length = 10 + Random(seed) % 100;
+  for (int i = 0; i < length; ++i) {
+    Builder token(store);
+    token.AddIsA("/s/token");
+    token.Add("/s/token/index", i);
+    token.Add("/s/token/text", StrCat("w", Random(seed) % 50));
+    token.Add("/s/token/score", (Random(seed) % 1000) / 8.0f);
+    tokens.push_back(token.Create().handle());
+    if (i % 4 == 0) {
+      Builder mention(store);
+      mention.AddIsA("/s/phrase");
+      mention.Add("/s/phrase/begin", i);
+      mention.Add("/s/phrase/evokes",
+                  store->Lookup(StrCat("/kb/Q", Random(seed) % 1000)));
+      mentions.push_back(mention.Create().handle());
+    }
+  }
+  Builder document(store);
+  document.AddId(StrCat("/doc/", Random(seed)));
+  document.AddIsA("/s/document");
+  document.Add("/s/document/tokens", Array(store, tokens));
+  document.Add("/s/document/mention", Array(store, mentions));
+  return document.Create().handle();
+}
+
+// Encodes object with wire format version.
+static string EncodeVersion(Store *store, Handle handle, int version) {
+  StringEncoder encoder(store);
+  encoder.encoder()->set_version(version);
+  encoder.Encode(handle);
+  return encoder.buffer();
+}
+
+// Checks that documents decode to the same frames in all wire format versions,
+// both with the decoder and through a wire view.
+static void TestVersions(Store *commons) {
+  const int kVersions[] = {WIRE_VERSION_1, WIRE_VERSION_2, WIRE_VERSION_3};
+  uint32 seed = 12345;
+  for (int d = 0; d < 20; ++d) {
+    Store store(commons);
+    Handle document = GenerateDocument(&store, &seed);
+    string expected = ToText(&store, document);
+    for (int version : kVersions) {
+      string encoded = EncodeVersion(&store, document, version);
+
+      Store decoded(commons);
+      Object object = Decode(&decoded, encoded);
+      CHECK_EQ(ToText(object), expected) << "version " << version;
+
+      WireView view(encoded);
+      WireObject wire = view.last();
+      CHECK(wire.IsFrame());
+      CHECK(wire.IsA("/s/document"));
+      Frame frame(&store, document);
+      Array tokens = frame.Get("/s/document/tokens").AsArray();
+      int i = 0;
+      for (WireObject token : wire.Get("/s/document/tokens").elements()) {
+        Frame t(&store, tokens.get(i));
+        CHECK(token.GetString("/s/token/text") == t.GetText("/s/token/text"));
+        CHECK_EQ(token.GetInt("/s/token/index"), i);
+        i++;
+      }
+      CHECK_EQ(i, tokens.length());
+
+      Store materialized(commons);
+      CHECK_EQ(ToText(wire.Materialize(&materialized)), expected)
+          << "version " << version;
+    }
+
+    // Token frames are only encoded with their slot names once with shapes.
+    CHECK_LT(EncodeVersion(&store, document, WIRE_VERSION_3).size(),
+             EncodeVersion(&store, document, WIRE_VERSION_2).size());
+
+    // Documents are encoded in the original format by default.
+    StringEncoder encoder(&store);
+    encoder.Encode(document);
+    CHECK(encoder.buffer() == EncodeVersion(&store, document, WIRE_VERSION_1));
+  }
+}
+
+// Checks that a global store encoded in streaming mode decodes to a store
+// with the same frames. The store has more frames than fit in one section, and
+// frames refer to frames in both earlier and later sections.
+static void TestStreaming() {
+  Store original;
+  BuildCommons(&original);
+  for (int i = 0; i < 3000; ++i) {
+    Builder b(&original);
+    b.AddId(StrCat("/kb/P", i));
+    b.Add("prev", original.Lookup(StrCat("/kb/P", (i + 2999) % 3000)));
+    b.Add("entity", original.Lookup(StrCat("/kb/Q", i % 1000)));
+    b.Create();
+  }
+  uint32 seed = 6789;
+  Handle document = GenerateDocument(&original, &seed);
+  string expected = ToText(&original, document);
+
+  StringEncoder encoder(&original);
+  encoder.encoder()->set_streaming(true);
+  encoder.EncodeAll();
+  Store decoded;
+  StringDecoder decoder(&decoded, encoder.buffer());
+  decoder.DecodeAll();
+
+  // Save and load the store through a file.
+  SaveStore(&original, FLAGS_scratch);
+  Store loaded;
+  LoadStore(FLAGS_scratch, &loaded);
+  CHECK(File::Delete(FLAGS_scratch));
+
+  for (Store *store : {&decoded, &loaded}) {
+    for (int i = 0; i < 1000; ++i) {
+      string id = StrCat("/kb/Q", i);
+      Handle h = store->LookupExisting(id);
+      CHECK(!h.IsNil()) << id;
+      CHECK_EQ(ToText(store, h), ToText(&original, original.Lookup(id)));
+    }
+    for (int i = 0; i < 3000; ++i) {
+      string id = StrCat("/kb/P", i);
+      Frame f(store, store->LookupExisting(id));
+      CHECK(f.valid()) << id;
+      CHECK_EQ(f.GetFrame("prev").Id(), StrCat("/kb/P", (i + 2999) % 3000));
+      CHECK_EQ(f.GetFrame("entity").Id(), StrCat("/kb/Q", i % 1000));
+    }
+    Frame doc(&original, document);
+    Handle h = store->LookupExisting(doc.Id());
+    CHECK(!h.IsNil());
+    CHECK_EQ(ToText(store, h), expected);
+  }
+}
+
+int main(int argc, char **argv) {
+  InitProgram(&argc, &argv);
+
+  Store commons;
+  BuildCommons(&commons);
+  commons.Freeze();
+
+  TestVersions(&commons);
+  TestStreaming();
+
+  LOG(INFO) << "PASS";
+  return 0;
+}
@@ -14,14 +14,91 @@
 
 #include "frame/tokenizer.h"
 
+#include <string.h>
+#include <immintrin.h>
 #include <string>
 
 #include "string/ctype.h"
 #include "string/numbers.h"
 #include "string/strcat.h"
+#include "third_party/jit/cpu.h"
 
 namespace sling {
 
+// Scanners for runs of characters in the input buffer. The string scanner
+// returns the first string delimiter, escape, or newline character, and the
+// space scanner returns the first non-whitespace character. Both return 'end'
+// if the whole range has been scanned.
+typedef const char *(*StringScanner)(const char *p, const char *end,
+                                     char delimiter);
+typedef const char *(*SpaceScanner)(const char *p, const char *end);
+
+// Scans string one character at a time.
+static const char *ScanStringGeneric(const char *p, const char *end,
+                                     char delimiter) {
+  while (p < end && *p != delimiter && *p != '\\' && *p != '\n') p++;
+  return p;
+}
+
+// Scans whitespace one character at a time.
+static const char *ScanSpaceGeneric(const char *p, const char *end) {
+  while (p < end && ascii_isspace(*p)) p++;
+  return p;
+}
+
+// Scans string 32 characters at a time using AVX2.
+__attribute__((target("avx2")))
+static const char *ScanStringAVX2(const char *p, const char *end,
+                                  char delimiter) {
+  const __m256i quote = _mm256_set1_epi8(delimiter);
+  const __m256i escape = _mm256_set1_epi8('\\');
+  const __m256i newline = _mm256_set1_epi8('\n');
+  while (p + 32 <= end) {
+    __m256i v = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(p));
+    __m256i special = _mm256_or_si256(
+        _mm256_or_si256(_mm256_cmpeq_epi8(v, quote),
+                        _mm256_cmpeq_epi8(v, escape)),
+        _mm256_cmpeq_epi8(v, newline));
+    uint32 mask = _mm256_movemask_epi8(special);
+    if (mask != 0) return p + __builtin_ctz(mask);
+    p += 32;
+  }
+  return ScanStringGeneric(p, end, delimiter);
+}
+
+// Scans whitespace 32 characters at a time using AVX2. Whitespace characters
+// are space and the control characters from tab (9) to carriage return (13).
+__attribute__((target("avx2")))
+static const char *ScanSpaceAVX2(const char *p, const char *end) {
+  const __m256i space = _mm256_set1_epi8(' ');
+  const __m256i low = _mm256_set1_epi8('\t' - 1);
+  const __m256i high = _mm256_set1_epi8('\r' + 1);
+  while (p + 32 <= end) {
+    __m256i v = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(p));
+    __m256i control = _mm256_and_si256(_mm256_cmpgt_epi8(v, low),
+                                       _mm256_cmpgt_epi8(high, v));
+    __m256i white = _mm256_or_si256(_mm256_cmpeq_epi8(v, space), control);
+    uint32 mask = ~static_cast<uint32>(_mm256_movemask_epi8(white));
+    if (mask != 0) return p + __builtin_ctz(mask);
+    p += 32;
+  }
+  return ScanSpaceGeneric(p, end);
+}
+
+// Selects scanners from the CPU features when the program is initialized.
+// Tokenizers used by earlier static initializers use the generic scanners, and
+// the scanners are never changed after initialization.
+static StringScanner ScanString = ScanStringGeneric;
+static SpaceScanner ScanSpace = ScanSpaceGeneric;
+static struct ScannerSelector {
+  ScannerSelector() {
+    if (jit::CPU::Enabled(jit::AVX2)) {
+      ScanString = ScanStringAVX2;
+      ScanSpace = ScanSpaceAVX2;
+    }
+  }
+} scanner_selector;
+
 // Converts hexadecimal character to digit value.
 static int HexToDigit(int ch) {
   if (ch >= '0' && ch <= '9') return ch - '0';
@@ -38,19 +115,49 @@ Tokenizer::Tokenizer(Input *input) : input_(input) {
   NextToken();
 }
 
-void Tokenizer::NextChar() {
-  char ch;
+Tokenizer::~Tokenizer() {
+  // Consume the characters that have been read from the input buffer. The
+  // rest of the buffered input is left for other readers.
+  input_->Skip(ptr_ - start_);
+}
 
-  if (current_ != -1 && input_->Next(&ch)) {
-    current_ = ch;
+bool Tokenizer::Fill() {
+  // Consume the current block before reading the next one.
+  input_->Skip(ptr_ - start_);
+  const char *data;
+  int size = input_->Peek(&data);
+  if (size == 0) return false;
+  start_ = ptr_ = data;
+  end_ = data + size;
+  return true;
+}
+
+void Tokenizer::Advance(const char *end) {
+  // Update line and column for the consumed characters.
+  const char *nl = static_cast<const char *>(memchr(ptr_, '\n', end - ptr_));
+  if (nl == nullptr) {
+    column_ += end - ptr_;
   } else {
-    current_ = -1;
+    for (;;) {
+      line_++;
+      const char *next = static_cast<const char *>(memchr(nl + 1, '\n',
+                                                          end - nl - 1));
+      if (next == nullptr) break;
+      nl = next;
+    }
+    column_ = end - nl - 1;
   }
-  if (current_ == '\n') {
-    line_++;
-    column_ = 0;
-  } else {
-    column_++;
+  ptr_ = end;
+}
+
+void Tokenizer::SkipWhitespace() {
+  while (current_ != -1 && ascii_isspace(current_)) {
+    // Whitespace runs are usually short, so only long runs are scanned in
+    // bulk.
+    if (end_ - ptr_ >= 32 && ascii_isspace(ptr_[0]) && ascii_isspace(ptr_[1])) {
+      Advance(ScanSpace(ptr_, end_));
+    }
+    NextChar();
   }
 }
 
@@ -71,7 +178,7 @@ int Tokenizer::NextToken() {
   // Keep reading until we either read a token or reach the end of the input.
   for (;;) {
     // Skip whitespace.
-    while (current_ != -1 && ascii_isspace(current_)) NextChar();
+    SkipWhitespace();
 
     // Parse next token (or comment).
     switch (current_) {
@@ -298,8 +405,15 @@ int Tokenizer::ParseString() {
           NextChar();
       }
     } else {
-      // Add character to string.
+      // Add character to string together with the following run of plain
+      // characters in the input buffer.
       Append(current_);
+      const char *end = ScanString(ptr_, end_, delimiter);
+      if (end > ptr_) {
+        token_text_.append(ptr_, end - ptr_);
+        column_ += end - ptr_;
+        ptr_ = end;
+      }
       NextChar();
     }
   }
@@ -367,9 +481,15 @@ int Tokenizer::ParseNumber(bool negative, bool fractional) {
 int Tokenizer::ParseDigits() {
   int digits = 0;
   while (current_ != -1 && ascii_isdigit(current_)) {
+    // Add digit together with the following digits in the input buffer.
     Append(current_);
+    const char *end = ptr_;
+    while (end < end_ && ascii_isdigit(*end)) end++;
+    digits += end - ptr_ + 1;
+    token_text_.append(ptr_, end - ptr_);
+    column_ += end - ptr_;
+    ptr_ = end;
     NextChar();
-    digits++;
   }
   return digits;
 }
@@ -446,10 +566,22 @@ bool Tokenizer::ParseName(int first) {
         NextChar();
         break;
 
-      default:
+      default: {
         if (!ascii_isalnum(current_)) return true;
+
+        // Add character together with the following alphanumeric characters
+        // and separators in the input buffer.
         Append(current_);
+        const char *end = ptr_;
+        while (end < end_ &&
+               (ascii_isalnum(*end) || *end == '_' || *end == '/')) {
+          end++;
+        }
+        token_text_.append(ptr_, end - ptr_);
+        column_ += end - ptr_;
+        ptr_ = end;
         NextChar();
+      }
     }
   }
 }
@@ -88,8 +88,12 @@ class Tokenizer {
     FALSE_TOKEN,
   };
 
-  // Initializes tokenizer with input.
+  // Initializes tokenizer with input. The tokenizer reads directly from the
+  // input buffer, so the input must not be used by others while the tokenizer
+  // is alive. Only the characters up to the current character are consumed
+  // from the input when the tokenizer is destroyed.
   explicit Tokenizer(Input *input);
+  ~Tokenizer();
 
   // Checks if all input has been read.
   bool done() const { return token_ == END; }
@@ -128,7 +132,30 @@ class Tokenizer {
 
  private:
   // Gets the next input character.
-  void NextChar();
+  void NextChar() {
+    if (current_ != -1 && (ptr_ < end_ || Fill())) {
+      current_ = *ptr_++;
+    } else {
+      current_ = -1;
+    }
+    if (current_ == '\n') {
+      line_++;
+      column_ = 0;
+    } else {
+      column_++;
+    }
+  }
+
+  // Consumes the current block of buffered data and reads the next block from
+  // the input. Returns false at the end of the input.
+  bool Fill();
+
+  // Skips whitespace in the input.
+  void SkipWhitespace();
+
+  // Consumes the characters in the input buffer after the current character
+  // up to 'end'. This is used for consuming runs of characters in bulk.
+  void Advance(const char *end);
 
   // Sets current token and returns it.
   int Token(int token) { token_ = token; return token; }
@@ -167,6 +194,14 @@ class Tokenizer {
   // Input for reader.
   Input *input_;
 
+  // Block of input data after the current character. Characters are read
+  // directly from the input buffer, so runs of characters can be scanned in
+  // bulk. The block is not consumed from the input until the next block is
+  // read, and 'start_' points to the start of the block in the input buffer.
+  const char *start_ = nullptr;
+  const char *ptr_ = nullptr;
+  const char *end_ = nullptr;
+
   // Current input character or -1 if end of input has been reached.
   int current_;
 
@@ -0,0 +1,161 @@
+// Copyright 2017 Google Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "frame/traversal.h"
+
+#include <algorithm>
+
+#include "base/logging.h"
+
+namespace sling {
+
+// Frontiers smaller than this are expanded by the calling thread, since the
+// cost of waking up the worker threads would exceed the gain.
+static const int kMinParallelFrontier = 4096;
+
+Traversal::Traversal(const Store *store, int num_threads)
+    : store_(store), num_threads_(num_threads) {
+  // Handles are only stable in a frozen store.
+  CHECK(store->frozen());
+  CHECK_GE(num_threads, 1);
+
+  // Allocate visited bitmap with one bit per handle.
+  MemoryUsage usage;
+  store->GetMemoryUsage(&usage, true);
+  num_handles_ = usage.num_handles;
+  Word words = (num_handles_ + 63) / 64;
+  visited_.reset(new std::atomic<uint64>[words]);
+  for (Word i = 0; i < words; ++i) visited_[i] = 0;
+
+  // Start worker threads for expanding large frontiers.
+  if (num_threads > 1) pool_.reset(new WorkerPool(num_threads));
+}
+
+void Traversal::Closure(const std::vector<Handle> &start,
+                        std::vector<Handle> *result) {
+  Search(start, -1, Handle::nil(), false, result);
+}
+
+void Traversal::Neighborhood(const std::vector<Handle> &start, int hops,
+                             std::vector<Handle> *result) {
+  Search(start, hops, Handle::nil(), false, result);
+}
+
+bool Traversal::ShortestPath(Handle source, Handle target,
+                             std::vector<Handle> *path) {
+  path->clear();
+  if (parent_.empty()) parent_.resize(num_handles_);
+  std::vector<Handle> visited;
+  Search({source}, -1, target, true, &visited);
+
+  // Follow parent links back from the target to the source.
+  bool found = found_;
+  if (found) {
+    Handle h = target;
+    while (h != source) {
+      path->push_back(h);
+      h = parent_[h.offset() / sizeof(Datum *)];
+    }
+    path->push_back(source);
+    std::reverse(path->begin(), path->end());
+  }
+  return found;
+}
+
+void Traversal::Search(const std::vector<Handle> &start, int hops,
+                       Handle target, bool parents,
+                       std::vector<Handle> *result) {
+  // Visit the start frames.
+  result->clear();
+  target_ = target;
+  found_ = false;
+  for (Handle h : start) {
+    if (!h.IsGlobalRef() || h.IsNil()) continue;
+    if (!store_->GetObject(h)->IsFrame()) continue;
+    if (!Visit(h)) continue;
+    if (parents) parent_[h.offset() / sizeof(Datum *)] = Handle::nil();
+    if (h == target) found_ = true;
+    result->push_back(h);
+  }
+
+  // Expand frontiers level by level. The current frontier is the part of the
+  // result added in the previous round.
+  size_t begin = 0;
+  std::vector<std::vector<Handle>> next(num_threads_);
+  for (int level = 0; hops == -1 || level < hops; ++level) {
+    if (found_) break;
+    size_t end = result->size();
+    size_t size = end - begin;
+    if (size == 0) break;
+    const Handle *frontier = result->data() + begin;
+    if (num_threads_ == 1 || size < kMinParallelFrontier) {
+      Expand(frontier, frontier + size, parents, &next[0]);
+      result->insert(result->end(), next[0].begin(), next[0].end());
+      next[0].clear();
+    } else {
+      // Split frontier between worker threads.
+      size_t chunk = (size + num_threads_ - 1) / num_threads_;
+      pool_->Run([&](int t) {
+        const Handle *b = frontier + std::min(size, t * chunk);
+        const Handle *e = frontier + std::min(size, (t + 1) * chunk);
+        Expand(b, e, parents, &next[t]);
+      });
+      for (std::vector<Handle> &n : next) {
+        result->insert(result->end(), n.begin(), n.end());
+        n.clear();
+      }
+    }
+    begin = end;
+  }
+
+  // Clear visited marks for the next search.
+  Clear(*result);
+}
+
+void Traversal::Expand(const Handle *begin, const Handle *end, bool parents,
+                       std::vector<Handle> *next) {
+  bool all = roles_.empty();
+  for (const Handle *h = begin; h < end && !found_; ++h) {
+    const FrameDatum *frame = store_->GetObject(*h)->AsFrame();
+    for (const Slot *s = frame->begin(); s < frame->end(); ++s) {
+      // Only follow frame references for the selected roles.
+      Handle value = s->value;
+      if (!value.IsGlobalRef() || value.IsNil()) continue;
+      if (!all && std::find(roles_.begin(), roles_.end(), s->name) ==
+                  roles_.end()) {
+        continue;
+      }
+      const Datum *object = store_->GetObject(value);
+      if (!object->IsFrame() || object->AsFrame()->IsProxy()) continue;
+
+      // Add frame to the next frontier if it has not been visited before.
+      if (Visit(value)) {
+        if (parents) parent_[value.offset() / sizeof(Datum *)] = *h;
+        if (value == target_) found_ = true;
+        next->push_back(value);
+      }
+    }
+  }
+}
+
+void Traversal::Clear(const std::vector<Handle> &frames) {
+  // All the marked frames are in the visited list, so the visited bitmap can
+  // be cleared a word at a time.
+  for (Handle h : frames) {
+    Word index = h.offset() / sizeof(Datum *);
+    visited_[index >> 6] = 0;
+  }
+}
+
+}  // namespace sling
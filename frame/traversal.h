@@ -0,0 +1,117 @@
+// Copyright 2017 Google Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef FRAME_TRAVERSAL_H_
+#define FRAME_TRAVERSAL_H_
+
+#include <atomic>
+#include <memory>
+#include <vector>
+
+#include "base/macros.h"
+#include "base/types.h"
+#include "frame/store.h"
+#include "util/worker-pool.h"
+
+namespace sling {
+
+// Breadth-first traversal of the frame graph in a frozen store. The frames in
+// the store are the nodes of the graph, and slots with frame values are the
+// edges. Only slots with the selected roles are followed, or all slots if no
+// roles are selected. The traversal works directly on handles, so no frames
+// are tracked as roots while traversing the graph. Large frontiers are
+// expanded in parallel by worker threads, which are started once for the
+// traversal object. A traversal object can be reused for several searches, but
+// it can only run one search at a time.
+class Traversal {
+ public:
+  // Initializes traversal over frozen store.
+  Traversal(const Store *store, int num_threads = 1);
+
+  // Selects roles for the edges to follow. All slots are followed if no roles
+  // are selected.
+  void set_roles(const std::vector<Handle> &roles) { roles_ = roles; }
+
+  // Returns all the frames reachable from the start frames, including the
+  // start frames themselves. For example, the transitive isa closure of a
+  // frame can be computed by only following isa slots.
+  void Closure(const std::vector<Handle> &start, std::vector<Handle> *result);
+
+  // Returns all the frames reachable from the start frames in at most the
+  // given number of hops.
+  void Neighborhood(const std::vector<Handle> &start, int hops,
+                    std::vector<Handle> *result);
+
+  // Finds a shortest path from source to target. Returns false if target
+  // cannot be reached from source. Otherwise, the path is returned with both
+  // source and target included.
+  bool ShortestPath(Handle source, Handle target, std::vector<Handle> *path);
+
+ private:
+  // Expands frontiers level by level until the maximum number of hops has
+  // been reached, or until the target has been visited. All visited frames
+  // are added to the result in breadth-first order. Parent links are recorded
+  // if requested.
+  void Search(const std::vector<Handle> &start, int hops, Handle target,
+              bool parents, std::vector<Handle> *result);
+
+  // Expands part of the current frontier and adds the newly visited frames to
+  // the next frontier.
+  void Expand(const Handle *begin, const Handle *end, bool parents,
+              std::vector<Handle> *next);
+
+  // Marks frame as visited. Returns false if it has already been visited.
+  bool Visit(Handle handle) {
+    Word index = handle.offset() / sizeof(Datum *);
+    uint64 bit = 1ULL << (index & 63);
+    return (visited_[index >> 6].fetch_or(bit) & bit) == 0;
+  }
+
+  // Clears the visited marks for frames.
+  void Clear(const std::vector<Handle> &frames);
+
+  // Store with the frame graph.
+  const Store *store_;
+
+  // Number of worker threads for expanding large frontiers.
+  int num_threads_;
+
+  // Worker threads for expanding large frontiers, or null if the traversal
+  // is single-threaded.
+  std::unique_ptr<WorkerPool> pool_;
+
+  // Roles for the edges to follow.
+  std::vector<Handle> roles_;
+
+  // Number of handles in the store.
+  Word num_handles_;
+
+  // Bitmap with the visited frames indexed by handle.
+  std::unique_ptr<std::atomic<uint64>[]> visited_;
+
+  // Parent of each visited frame for shortest path search, indexed by handle.
+  std::vector<Handle> parent_;
+
+  // Target frame for search, or nil if there is no target.
+  Handle target_ = Handle::nil();
+
+  // Set when the target frame has been visited.
+  std::atomic<bool> found_{false};
+
+  DISALLOW_COPY_AND_ASSIGN(Traversal);
+};
+
+}  // namespace sling
+
+#endif  // FRAME_TRAVERSAL_H_
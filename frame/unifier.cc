@@ -0,0 +1,233 @@
+// Copyright 2017 Google Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "frame/unifier.h"
+
+#include "base/logging.h"
+
+namespace sling {
+
+Unifier::Unifier(Store *store) : store_(store), outputs_(store) {}
+
+Handle Unifier::Unify(Handle a, Handle b) {
+  int root = Build(a, b);
+  if (root == -1) return Handle::nil();
+  return Construct(root);
+}
+
+bool Unifier::Unifiable(Handle a, Handle b) {
+  return Build(a, b) != -1;
+}
+
+int Unifier::Unify(const std::vector<std::pair<Handle, Handle>> &pairs,
+                   Handles *results) {
+  int num_unified = 0;
+  for (const auto &pair : pairs) {
+    Handle result = Unify(pair.first, pair.second);
+    results->push_back(result);
+    if (!result.IsNil()) num_unified++;
+  }
+  return num_unified;
+}
+
+void Unifier::Clear() {
+  nodes_.clear();
+  node_map_.clear();
+  features_.clear();
+  unexpanded_.clear();
+  pending_.clear();
+}
+
+int Unifier::NodeFor(Handle value) {
+  // Each nil value gets its own node, since nil values can be unified with
+  // different values.
+  if (value.IsNil()) {
+    int index = nodes_.size();
+    nodes_.push_back({index, value, false, -1, -1});
+    return index;
+  }
+  auto f = node_map_.find(value);
+  if (f != node_map_.end()) return f->second;
+
+  // Anonymous frames are complex feature structures. All other values are
+  // atomic.
+  bool complex = false;
+  if (value.IsRef()) {
+    const Datum *object = store_->Deref(value);
+    complex = object->IsFrame() && object->AsFrame()->IsAnonymous();
+  }
+
+  int index = nodes_.size();
+  nodes_.push_back({index, value, complex, -1, -1});
+  node_map_[value] = index;
+  if (complex) unexpanded_.push_back(index);
+  return index;
+}
+
+void Unifier::Expand() {
+  while (!unexpanded_.empty()) {
+    int node = unexpanded_.back();
+    unexpanded_.pop_back();
+    const FrameDatum *frame = store_->GetFrame(nodes_[node].value);
+    for (const Slot *s = frame->begin(); s < frame->end(); ++s) {
+      // Roles with multiple values in the frame are set-valued.
+      bool multi = s->name == Handle::isa() || s->name == Handle::is();
+      for (const Slot *t = frame->begin(); !multi && t < frame->end(); ++t) {
+        if (t != s && t->name == s->name) multi = true;
+      }
+      AddFeature(node, s->name, NodeFor(s->value), multi);
+    }
+  }
+}
+
+void Unifier::AddFeature(int node, Handle role, int value, bool multi) {
+  int index = features_.size();
+  features_.push_back({role, value, multi, -1});
+  Node &n = nodes_[node];
+  if (n.last == -1) {
+    n.features = index;
+  } else {
+    features_[n.last].next = index;
+  }
+  n.last = index;
+}
+
+int Unifier::Build(Handle a, Handle b) {
+  Clear();
+  int na = NodeFor(a);
+  int nb = NodeFor(b);
+  Expand();
+  if (!Merge(na, nb)) return -1;
+  return Find(na);
+}
+
+bool Unifier::Merge(int a, int b) {
+  pending_.emplace_back(a, b);
+  while (!pending_.empty()) {
+    int x = Find(pending_.back().first);
+    int y = Find(pending_.back().second);
+    pending_.pop_back();
+    if (x == y) continue;
+    Node &nx = nodes_[x];
+    Node &ny = nodes_[y];
+
+    // Nil unifies with anything.
+    if (!ny.complex && ny.value.IsNil()) {
+      ny.parent = x;
+      continue;
+    }
+    if (!nx.complex && nx.value.IsNil()) {
+      nx.parent = y;
+      continue;
+    }
+
+    // Atomic values only unify with empty frames, since different atomic
+    // values are always in different sets.
+    if (!nx.complex || !ny.complex) {
+      if (nx.complex && nx.features == -1) {
+        nx.parent = y;
+      } else if (ny.complex && ny.features == -1) {
+        ny.parent = x;
+      } else {
+        return false;
+      }
+      continue;
+    }
+
+    // Merge the features of the two complex nodes. Common single-valued
+    // features are unified, and all other features are added to the merged
+    // node.
+    ny.parent = x;
+    for (int f = ny.features; f != -1; f = features_[f].next) {
+      Handle role = features_[f].role;
+      bool multi = features_[f].multi;
+      int match = -1;
+      for (int g = nx.features; g != -1; g = features_[g].next) {
+        if (features_[g].role == role) {
+          if (features_[g].multi) multi = true;
+          match = g;
+          break;
+        }
+      }
+      if (match != -1 && !multi) {
+        pending_.emplace_back(features_[match].node, features_[f].node);
+      } else {
+        AddFeature(x, role, features_[f].node, multi);
+      }
+    }
+  }
+  return true;
+}
+
+Handle Unifier::Construct(int root) {
+  int r = Find(root);
+  if (!nodes_[r].complex) return nodes_[r].value;
+
+  // Collect the slots for all the complex nodes reachable from the root and
+  // allocate frames for them. The frames are allocated before their slots are
+  // filled in, so cyclic graphs can be constructed. Duplicate values for
+  // set-valued roles are removed. The GC is locked until all the frames are
+  // complete.
+  store_->LockGC();
+  outputs_.assign(nodes_.size(), Handle::nil());
+  slots_.clear();
+  std::vector<int> order;
+  std::vector<int> stack = {r};
+  while (!stack.empty()) {
+    int n = stack.back();
+    stack.pop_back();
+    if (!outputs_[n].IsNil()) continue;
+    int begin = slots_.size();
+    for (int f = nodes_[n].features; f != -1; f = features_[f].next) {
+      // Slot values are temporarily represented by their node numbers.
+      Handle role = features_[f].role;
+      Handle v = Handle::Integer(Find(features_[f].node));
+      bool duplicate = false;
+      if (features_[f].multi) {
+        for (int i = begin; i < slots_.size(); ++i) {
+          if (slots_[i].name == role && slots_[i].value == v) {
+            duplicate = true;
+            break;
+          }
+        }
+      }
+      if (duplicate) continue;
+      slots_.emplace_back(role, v);
+      int node = v.AsInt();
+      if (nodes_[node].complex && outputs_[node].IsNil()) {
+        stack.push_back(node);
+      }
+    }
+    outputs_[n] = store_->AllocateFrame(slots_.size() - begin);
+    order.push_back(n);
+    order.push_back(begin);
+  }
+
+  // Fill in the slots of the new frames.
+  for (Slot &slot : slots_) {
+    const Node &node = nodes_[slot.value.AsInt()];
+    slot.value = node.complex ? outputs_[slot.value.AsInt()] : node.value;
+  }
+  for (int i = 0; i < order.size(); i += 2) {
+    Slot *begin = slots_.data() + order[i + 1];
+    Slot *end = i + 2 < order.size() ? slots_.data() + order[i + 3]
+                                     : slots_.data() + slots_.size();
+    store_->UpdateFrame(outputs_[order[i]], begin, end);
+  }
+  store_->UnlockGC();
+
+  return outputs_[r];
+}
+
+}  // namespace sling
@@ -0,0 +1,140 @@
+// Copyright 2017 Google Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef FRAME_UNIFIER_H_
+#define FRAME_UNIFIER_H_
+
+#include <utility>
+#include <vector>
+
+#include "base/macros.h"
+#include "frame/object.h"
+#include "frame/store.h"
+
+namespace sling {
+
+// Unification of frames viewed as feature structures. Anonymous frames are
+// complex feature structures, and all other values, including frames with ids,
+// are atomic. Two atomic values unify if they are equal or if one of them is
+// nil or an empty frame. Two complex feature structures unify if the values of
+// all their common roles unify, and the result has the union of the roles.
+// Roles that occur more than once in a frame as well as isa: and is: roles are
+// treated as sets, so their values are merged instead of unified.
+//
+// The unifier works directly on the frame data using union-find over the nodes
+// in the two feature structure graphs, so cyclic graphs are handled and no
+// frame objects are tracked while unifying. The result is constructed as new
+// anonymous frames in the store of the unifier. The input frames can be in the
+// store or in its global store, so each thread can run its own unifier with a
+// local store on top of a shared frozen global store.
+class Unifier {
+ public:
+  // Initializes unifier for constructing unified frames in store.
+  explicit Unifier(Store *store);
+
+  // Unifies two frames and returns the unified frame, or nil if the frames
+  // cannot be unified. The result is not tracked after the next call to the
+  // unifier, so it should be wrapped in a Frame if it needs to be kept.
+  Handle Unify(Handle a, Handle b);
+
+  // Checks if two frames can be unified without constructing the result.
+  bool Unifiable(Handle a, Handle b);
+
+  // Unifies a batch of frame pairs. The result for each pair is added to the
+  // results, with nil for pairs that cannot be unified. Returns the number of
+  // pairs that could be unified.
+  int Unify(const std::vector<std::pair<Handle, Handle>> &pairs,
+            Handles *results);
+
+ private:
+  // Node in feature structure graph. Complex nodes have a list of features.
+  struct Node {
+    int parent;     // parent node in union-find, or the node itself for roots
+    Handle value;   // value for atomic node, or source frame for complex node
+    bool complex;   // complex feature structure with features
+    int features;   // first feature for node, or -1 if none
+    int last;       // last feature for node, or -1 if none
+  };
+
+  // Feature for complex node.
+  struct Feature {
+    Handle role;  // feature role
+    int node;     // feature value node
+    bool multi;   // set-valued feature
+    int next;     // next feature for node, or -1 if this is the last one
+  };
+
+  // Clears the graph for the next unification.
+  void Clear();
+
+  // Returns the node for a value. New nodes are created for values that are
+  // not already in the graph.
+  int NodeFor(Handle value);
+
+  // Adds features to the complex nodes that have not yet been expanded.
+  void Expand();
+
+  // Adds feature to node.
+  void AddFeature(int node, Handle role, int value, bool multi);
+
+  // Returns the root node for the union-find set of a node.
+  int Find(int node) {
+    while (nodes_[node].parent != node) {
+      int grandparent = nodes_[nodes_[node].parent].parent;
+      nodes_[node].parent = grandparent;
+      node = grandparent;
+    }
+    return node;
+  }
+
+  // Builds the graphs for two frames and unifies them. Returns the node for
+  // the unified graph, or -1 if the frames cannot be unified.
+  int Build(Handle a, Handle b);
+
+  // Unifies two nodes. Returns false if unification fails.
+  bool Merge(int a, int b);
+
+  // Constructs frames for the unified graph and returns the result.
+  Handle Construct(int root);
+
+  // Store for unified frames.
+  Store *store_;
+
+  // Nodes in the feature structure graph and the mapping from values to nodes.
+  std::vector<Node> nodes_;
+  HandleMap<int> node_map_;
+
+  // Features for complex nodes.
+  std::vector<Feature> features_;
+
+  // Complex nodes that still need to have their features added.
+  std::vector<int> unexpanded_;
+
+  // Pairs of nodes that still need to be unified.
+  std::vector<std::pair<int, int>> pending_;
+
+  // Slots for the unified frames.
+  std::vector<Slot> slots_;
+
+  // Frames constructed for the root nodes in the unified graph. These are
+  // tracked, so the constructed frames survive garbage collection until the
+  // next unification.
+  Handles outputs_;
+
+  DISALLOW_COPY_AND_ASSIGN(Unifier);
+};
+
+}  // namespace sling
+
+#endif  // FRAME_UNIFIER_H_
@@ -0,0 +1,607 @@
+// Copyright 2017 Google Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "frame/wire-view.h"
+
+#include <algorithm>
+#include <vector>
+
+#include "base/logging.h"
+#include "frame/object.h"
+#include "frame/store.h"
+#include "frame/wire.h"
+#include "util/varint.h"
+
+namespace sling {
+
+// Most tags and lengths fit in one byte, so these are decoded inline.
+inline const char *WireView::ReadVarint64(const char *p, uint64 *value) const {
+  if (p < limit_ && static_cast<uint8>(*p) < 0x80) {
+    *value = static_cast<uint8>(*p);
+    return p + 1;
+  }
+  const char *next = Varint::Parse64WithLimit(p, limit_, value);
+  CHECK(next != nullptr) << "Truncated wire format buffer";
+  return next;
+}
+
+inline const char *WireView::ReadVarint32(const char *p, uint32 *value) const {
+  if (p < limit_ && static_cast<uint8>(*p) < 0x80) {
+    *value = static_cast<uint8>(*p);
+    return p + 1;
+  }
+  const char *next = Varint::Parse32WithLimit(p, limit_, value);
+  CHECK(next != nullptr) << "Truncated wire format buffer";
+  return next;
+}
+
+// Materializes objects from a wire view into a store. Each object in the
+// buffer is only materialized once, so shared objects and cycles in the
+// object graph are preserved.
+class WireMaterializer {
+ public:
+  WireMaterializer(const WireView *view, Store *store)
+      : view_(view), store_(store), handles_(store), stack_(store) {
+    handles_.resize(view->refs_.size(), Handle::nil());
+    pending_.resize(view->refs_.size());
+  }
+
+  // Materializes object and returns handle to it.
+  Handle Materialize(const WireObject &object);
+
+ private:
+  // Materializes frame with reference number.
+  Handle MaterializeFrame(const WireObject &object, int ref);
+
+  // Materializes array with reference number.
+  Handle MaterializeArray(const WireObject &object, int ref);
+
+  // Wire view with encoded objects.
+  const WireView *view_;
+
+  // Store for materialized objects.
+  Store *store_;
+
+  // Handles for materialized objects indexed by reference number.
+  Handles handles_;
+
+  // Frames which are being materialized.
+  std::vector<bool> pending_;
+
+  // Stack for slots of frames being materialized.
+  HandleSpace stack_;
+};
+
+Handle WireMaterializer::Materialize(const WireObject &object) {
+  switch (object.type_) {
+    case WIRE_STRING:
+    case WIRE_SYMBOL:
+    case WIRE_LINK:
+    case WIRE_FRAME: {
+      int ref = object.ref_;
+      if (!handles_[ref].IsNil()) return handles_[ref];
+      Handle handle;
+      if (object.type_ == WIRE_STRING) {
+        handle = store_->AllocateString(object.AsString());
+      } else if (object.type_ == WIRE_SYMBOL) {
+        handle = store_->Symbol(object.AsSymbol());
+      } else if (object.type_ == WIRE_LINK) {
+        handle = store_->Lookup(object.AsSymbol());
+      } else {
+        return MaterializeFrame(object, ref);
+      }
+      handles_[ref] = handle;
+      return handle;
+    }
+
+    case WIRE_INTEGER:
+      return Handle::Integer(object.arg_);
+
+    case WIRE_FLOAT:
+      return Handle::FromFloatBits(object.arg_);
+
+    case WIRE_SPECIAL:
+      switch (object.arg_) {
+        case WIRE_NIL: return Handle::nil();
+        case WIRE_ID: return Handle::id();
+        case WIRE_ISA: return Handle::isa();
+        case WIRE_IS: return Handle::is();
+        case WIRE_INDEX: return Handle::Index(object.AsIndex());
+        case WIRE_ARRAY: {
+          int ref = object.ref_;
+          if (!handles_[ref].IsNil()) return handles_[ref];
+          return MaterializeArray(object, ref);
+        }
+        case WIRE_RESOLVE: {
+          int ref = view_->FindResolve(object.ptr_)->ref;
+          if (!handles_[ref].IsNil()) return handles_[ref];
+          return MaterializeFrame(object, ref);
+        }
+        case WIRE_SHAPE:
+        case WIRE_SHAPED: {
+          int ref = object.ref_;
+          if (!handles_[ref].IsNil()) return handles_[ref];
+          return MaterializeFrame(object, ref);
+        }
+      }
+  }
+
+  LOG(FATAL) << "Invalid wire object type " << object.type_;
+  return Handle::nil();
+}
+
+Handle WireMaterializer::MaterializeFrame(const WireObject &object, int ref) {
+  // A frame that refers back to itself, directly or indirectly, needs a handle
+  // before its slots are known. Named frames get the handle for their id, and
+  // anonymous frames get a placeholder frame that is updated afterwards.
+  if (pending_[ref]) {
+    if (handles_[ref].IsNil()) {
+      Text id = object.Id();
+      if (id.empty()) {
+        handles_[ref] = store_->AllocateFrame(object.size());
+      } else {
+        handles_[ref] = store_->Lookup(id);
+      }
+    }
+    return handles_[ref];
+  }
+  pending_[ref] = true;
+
+  // Materialize slots and store them temporarily on the stack.
+  Word mark = stack_.offset(stack_.end());
+  const char *p = object.data_;
+  int next = object.first_ref();
+  const WireObject::NamePosition *names = object.shape_names();
+  for (int i = 0; i < object.size() * 2; ++i) {
+    Handle h;
+    if (names != nullptr && i % 2 == 0) {
+      // Slot names for frames with shapes are taken from the shape.
+      const WireObject::NamePosition &name = names[i / 2];
+      h = Materialize(WireObject(view_, name.ptr, name.ref));
+    } else {
+      int current = next;
+      const char *q = view_->Skip(p, &next);
+      h = Materialize(WireObject(view_, p, current));
+      p = q;
+    }
+    *stack_.push() = h;
+  }
+
+  // Create frame, or fill in the placeholder for an anonymous frame.
+  Slot *begin = reinterpret_cast<Slot *>(stack_.address(mark));
+  Slot *end = reinterpret_cast<Slot *>(stack_.end());
+  Handle handle = handles_[ref];
+  if (!handle.IsNil() && object.Id().empty()) {
+    store_->UpdateFrame(handle, begin, end);
+  } else {
+    handle = store_->AllocateFrame(begin, end);
+  }
+  stack_.set_end(stack_.address(mark));
+
+  pending_[ref] = false;
+  handles_[ref] = handle;
+  return handle;
+}
+
+Handle WireMaterializer::MaterializeArray(const WireObject &object, int ref) {
+  // Allocate array before the elements, so elements can refer to the array.
+  Handle handle = store_->AllocateArray(object.size());
+  handles_[ref] = handle;
+
+  // Materialize elements and store them temporarily on the stack.
+  Word mark = stack_.offset(stack_.end());
+  for (const WireObject &element : object.elements()) {
+    Handle value = Materialize(element);
+    *stack_.push() = value;
+  }
+
+  // Copy elements from stack to array.
+  Handle *source = stack_.address(mark);
+  ArrayDatum *array = store_->Deref(handle)->AsArray();
+  Handle *dest = array->begin();
+  while (source < stack_.end()) *dest++ = *source++;
+  store_->WriteBarrier(array);
+  stack_.set_end(stack_.address(mark));
+
+  return handle;
+}
+
+WireObject::WireObject(const WireView *view, const char *ptr, int ref)
+    : view_(view), ptr_(ptr), ref_(ref) {
+  Parse();
+  if (type_ == WIRE_REF) {
+    // Follow reference to previous object.
+    CHECK_LT(arg_, view_->refs_.size());
+    ref_ = arg_;
+    ptr_ = view_->refs_[ref_].begin;
+  }
+  if (type_ == WIRE_REF || (type_ == WIRE_LINK && !view_->resolves_.empty())) {
+    // Follow link to frame that is encoded later in the buffer.
+    const char *target = view_->refs_[ref_].target;
+    if (target != ptr_) {
+      ptr_ = target;
+      ref_ = view_->FindResolve(target)->first;
+    }
+    Parse();
+  }
+}
+
+void WireObject::Parse() {
+  uint64 tag;
+  data_ = view_->ReadVarint64(ptr_, &tag);
+  type_ = tag & 7;
+  arg_ = tag >> 3;
+  size_ = 0;
+  shape_ = -1;
+  if (type_ == WIRE_FRAME) {
+    size_ = arg_;
+  } else if (type_ == WIRE_SPECIAL) {
+    uint32 size;
+    if (arg_ == WIRE_ARRAY) {
+      data_ = view_->ReadVarint32(data_, &size);
+      size_ = size;
+    } else if (arg_ == WIRE_RESOLVE) {
+      uint32 replace;
+      data_ = view_->ReadVarint32(data_, &size);
+      data_ = view_->ReadVarint32(data_, &replace);
+      size_ = size;
+    } else if (arg_ == WIRE_SHAPE) {
+      // The slot values come after the slot names for the new shape.
+      const WireView::Shape *shape = view_->FindShape(ptr_);
+      shape_ = shape - view_->shapes_.data();
+      data_ = shape->values;
+      size_ = shape->slots;
+    } else if (arg_ == WIRE_SHAPED) {
+      uint32 shape;
+      data_ = view_->ReadVarint32(data_, &shape);
+      shape_ = shape;
+      size_ = view_->shapes_[shape].slots;
+    }
+  }
+}
+
+int WireObject::AsIndex() const {
+  uint32 index = 0;
+  if (IsIndex()) view_->ReadVarint32(data_, &index);
+  return index;
+}
+
+WireObject WireObject::at(int index) const {
+  DCHECK(IsArray());
+  DCHECK_GE(index, 0);
+  DCHECK_LT(index, size_);
+  const char *p = data_;
+  int ref = first_ref();
+  for (int i = 0; i < index; ++i) p = view_->Skip(p, &ref);
+  return WireObject(view_, p, ref);
+}
+
+WireSlot WireObject::Iterator::operator *() const {
+  WireSlot slot;
+  if (names_ != nullptr) {
+    slot.name = WireObject(view_, names_->ptr, names_->ref);
+    slot.value = WireObject(view_, ptr_, ref_);
+    return slot;
+  }
+  int ref = ref_;
+  slot.name = WireObject(view_, ptr_, ref);
+  const char *value = view_->Skip(ptr_, &ref);
+  slot.value = WireObject(view_, value, ref);
+  return slot;
+}
+
+void WireObject::Iterator::operator ++() {
+  if (names_ != nullptr) {
+    ptr_ = view_->Skip(ptr_, &ref_);
+    names_++;
+  } else {
+    ptr_ = view_->Skip(view_->Skip(ptr_, &ref_), &ref_);
+  }
+  remaining_--;
+}
+
+void WireObject::ElementIterator::operator ++() {
+  ptr_ = view_->Skip(ptr_, &ref_);
+  remaining_--;
+}
+
+bool WireObject::Matches(Text name) const {
+  if (IsSymbol()) return AsSymbol() == name;
+  if (IsFrame()) return Id() == name;
+  return false;
+}
+
+WireObject WireObject::Get(Text name) const {
+  // Only decode the slot value for the matching slot.
+  const char *p = data_;
+  int ref = first_ref();
+  const NamePosition *names = shape_names();
+  if (names != nullptr) {
+    for (int i = 0; i < size_; ++i) {
+      if (WireObject(view_, names[i].ptr, names[i].ref).Matches(name)) {
+        return WireObject(view_, p, ref);
+      }
+      p = view_->Skip(p, &ref);
+    }
+    return WireObject();
+  }
+  for (int i = 0; i < size_; ++i) {
+    int value_ref = ref;
+    const char *value = view_->Skip(p, &value_ref);
+    if (WireObject(view_, p, ref).Matches(name)) {
+      return WireObject(view_, value, value_ref);
+    }
+    ref = value_ref;
+    p = view_->Skip(value, &ref);
+  }
+  return WireObject();
+}
+
+int WireObject::GetInt(Text name, int defval) const {
+  WireObject value = Get(name);
+  return value.IsInt() ? value.AsInt() : defval;
+}
+
+Text WireObject::Id() const {
+  for (const WireSlot &slot : *this) {
+    if (slot.name.IsId() && slot.value.IsSymbol()) {
+      return slot.value.AsSymbol();
+    }
+  }
+  return Text();
+}
+
+bool WireObject::IsA(Text type) const {
+  for (const WireSlot &slot : *this) {
+    if (slot.name.IsIsA() && slot.value.Matches(type)) return true;
+  }
+  return false;
+}
+
+Object WireObject::Materialize(Store *store) const {
+  return view_->Materialize(store, *this);
+}
+
+WireView::WireView(const char *data, size_t size)
+    : data_(data), limit_(data + size) {
+  // Most encoded objects take up more than eight bytes.
+  refs_.reserve(size / 8);
+  const char *p = data_;
+  uint64 tag;
+  while (p < limit_) {
+    // Objects in version 2 wire format are preceded by a symbol dictionary.
+    ReadVarint64(p, &tag);
+    if (tag == (WIRE_SYMBOLS << 3 | WIRE_SPECIAL)) {
+      p = ReadDictionary(p);
+      continue;
+    }
+    objects_.push_back({p, static_cast<int>(refs_.size())});
+    p = Index(p);
+  }
+}
+
+const char *WireView::ReadDictionary(const char *p) {
+  uint64 tag;
+  uint32 size;
+  p = ReadVarint64(p, &tag);
+  p = ReadVarint32(p, &size);
+  int prev = names_.size();
+  int prev_size = 0;
+  for (uint32 i = 0; i < size; ++i) {
+    uint32 common;
+    uint32 length;
+    p = ReadVarint32(p, &common);
+    p = ReadVarint32(p, &length);
+    CHECK_LE(common, prev_size) << "Invalid symbol dictionary";
+    CHECK_LE(length, limit_ - p) << "Truncated wire format buffer";
+    int offset = names_.size();
+    names_.append(names_, prev, common);
+    names_.append(p, length);
+    dictionary_.push_back({offset, static_cast<int>(common + length)});
+    p += length;
+    prev = offset;
+    prev_size = common + length;
+  }
+  return p;
+}
+
+const char *WireView::Index(const char *p) {
+  uint64 tag;
+  const char *next = ReadVarint64(p, &tag);
+  uint64 arg = tag >> 3;
+  switch (tag & 7) {
+    case WIRE_REF:
+      CHECK_LT(arg, refs_.size()) << "Invalid reference";
+      return next;
+
+    case WIRE_FRAME: {
+      // Frames get a reference number before the slots are indexed.
+      int ref = refs_.size();
+      refs_.push_back({p, nullptr, p, 0});
+      for (uint64 i = 0; i < arg * 2; ++i) next = Index(next);
+      refs_[ref].end = next;
+      refs_[ref].next = refs_.size();
+      return next;
+    }
+
+    case WIRE_SYMBOL:
+    case WIRE_LINK:
+      if (has_dictionary()) {
+        // The argument is the dictionary index for the symbol.
+        CHECK_LT(arg, dictionary_.size()) << "Invalid symbol index";
+        refs_.push_back({p, next, p, static_cast<int>(refs_.size() + 1)});
+        return next;
+      }
+      // Fall through.
+
+    case WIRE_STRING:
+      CHECK_LE(arg, limit_ - next) << "Truncated wire format buffer";
+      next += arg;
+      refs_.push_back({p, next, p, static_cast<int>(refs_.size() + 1)});
+      return next;
+
+    case WIRE_INTEGER:
+    case WIRE_FLOAT:
+      return next;
+
+    case WIRE_SPECIAL:
+      switch (arg) {
+        case WIRE_NIL:
+        case WIRE_ID:
+        case WIRE_ISA:
+        case WIRE_IS:
+          return next;
+
+        case WIRE_ARRAY: {
+          uint32 size;
+          next = ReadVarint32(next, &size);
+          int ref = refs_.size();
+          refs_.push_back({p, nullptr, p, 0});
+          for (uint32 i = 0; i < size; ++i) next = Index(next);
+          refs_[ref].end = next;
+          refs_[ref].next = refs_.size();
+          return next;
+        }
+
+        case WIRE_INDEX: {
+          uint32 index;
+          return ReadVarint32(next, &index);
+        }
+
+        case WIRE_RESOLVE: {
+          // The resolved frame replaces the link as the target for the
+          // reference.
+          uint32 slots;
+          uint32 replace;
+          next = ReadVarint32(next, &slots);
+          next = ReadVarint32(next, &replace);
+          CHECK_LT(replace, refs_.size()) << "Invalid reference";
+          int index = resolves_.size();
+          int first = refs_.size();
+          resolves_.push_back({p, nullptr, static_cast<int>(replace), first, 0});
+          for (uint32 i = 0; i < slots * 2; ++i) next = Index(next);
+          resolves_[index].end = next;
+          resolves_[index].next = refs_.size();
+          refs_[replace].target = p;
+          return next;
+        }
+
+        case WIRE_SHAPE: {
+          // The shape is numbered before the slot names are indexed, but the
+          // slot names can contain other shapes, so the positions of the names
+          // are collected before they are added to the shape names.
+          uint32 slots;
+          next = ReadVarint32(next, &slots);
+          int ref = refs_.size();
+          refs_.push_back({p, nullptr, p, 0});
+          int shape = shapes_.size();
+          shapes_.push_back({p, nullptr, 0, static_cast<int>(slots), 0});
+          std::vector<WireObject::NamePosition> names(slots);
+          for (uint32 i = 0; i < slots; ++i) {
+            names[i] = {next, static_cast<int>(refs_.size())};
+            next = Index(next);
+          }
+          shapes_[shape].names = shape_names_.size();
+          shape_names_.insert(shape_names_.end(), names.begin(), names.end());
+          shapes_[shape].values = next;
+          shapes_[shape].ref = refs_.size();
+          for (uint32 i = 0; i < slots; ++i) next = Index(next);
+          refs_[ref].end = next;
+          refs_[ref].next = refs_.size();
+          return next;
+        }
+
+        case WIRE_SHAPED: {
+          uint32 shape;
+          next = ReadVarint32(next, &shape);
+          CHECK_LT(shape, shapes_.size()) << "Invalid shape";
+          int ref = refs_.size();
+          refs_.push_back({p, nullptr, p, 0});
+          for (int i = 0; i < shapes_[shape].slots; ++i) next = Index(next);
+          refs_[ref].end = next;
+          refs_[ref].next = refs_.size();
+          return next;
+        }
+      }
+  }
+
+  LOG(FATAL) << "Invalid tag value: " << tag;
+  return nullptr;
+}
+
+const char *WireView::Skip(const char *p, int *ref) const {
+  uint64 tag;
+  const char *next = ReadVarint64(p, &tag);
+  uint64 arg = tag >> 3;
+  switch (tag & 7) {
+    case WIRE_STRING:
+      ++*ref;
+      return next + arg;
+
+    case WIRE_SYMBOL:
+    case WIRE_LINK:
+      ++*ref;
+      return has_dictionary() ? next : next + arg;
+
+    case WIRE_FRAME:
+      break;
+
+    case WIRE_SPECIAL:
+      if (arg == WIRE_ARRAY || arg == WIRE_SHAPE || arg == WIRE_SHAPED) {
+        break;
+      } else if (arg == WIRE_INDEX) {
+        uint32 index;
+        return ReadVarint32(next, &index);
+      } else if (arg == WIRE_RESOLVE) {
+        const Resolve *resolve = FindResolve(p);
+        *ref = resolve->next;
+        return resolve->end;
+      }
+      return next;
+
+    default:
+      return next;
+  }
+
+  // Objects are numbered in the order they appear in the buffer, so the
+  // reference number for a frame or array is the number of objects before it.
+  const Ref &r = refs_[*ref];
+  DCHECK(r.begin == p);
+  *ref = r.next;
+  return r.end;
+}
+
+const WireView::Resolve *WireView::FindResolve(const char *p) const {
+  auto it = std::lower_bound(
+      resolves_.begin(), resolves_.end(), p,
+      [](const Resolve &r, const char *p) { return r.begin < p; });
+  DCHECK(it != resolves_.end() && it->begin == p);
+  return &*it;
+}
+
+const WireView::Shape *WireView::FindShape(const char *p) const {
+  auto it = std::lower_bound(
+      shapes_.begin(), shapes_.end(), p,
+      [](const Shape &s, const char *p) { return s.begin < p; });
+  DCHECK(it != shapes_.end() && it->begin == p);
+  return &*it;
+}
+
+Object WireView::Materialize(Store *store, const WireObject &object) const {
+  CHECK(object.view_ == this);
+  WireMaterializer materializer(this, store);
+  return Object(store, materializer.Materialize(object));
+}
+
+}  // namespace sling
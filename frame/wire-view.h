@@ -0,0 +1,385 @@
+// Copyright 2017 Google Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef FRAME_WIRE_VIEW_H_
+#define FRAME_WIRE_VIEW_H_
+
+#include <vector>
+
+#include "base/macros.h"
+#include "base/types.h"
+#include "frame/object.h"
+#include "frame/store.h"
+#include "frame/wire.h"
+#include "string/text.h"
+
+namespace sling {
+
+class WireView;
+struct WireSlot;
+
+// A wire object is a view of an object in a buffer with objects encoded in
+// binary wire format. References to previously encoded objects and links to
+// frames that are encoded later in the buffer are followed transparently.
+// Strings and symbol names point directly into the buffer, so the buffer must
+// outlive the wire objects. Symbol names from symbol dictionaries in version 2
+// wire format and slot names for shapes in version 3 wire format are kept in
+// the view.
+class WireObject {
+ public:
+  // Initializes invalid wire object.
+  WireObject() : view_(nullptr), ptr_(nullptr) {}
+
+  // Returns true if the object is valid.
+  bool valid() const { return ptr_ != nullptr; }
+
+  // Object type checks.
+  bool IsNil() const { return IsSpecial(WIRE_NIL); }
+  bool IsId() const { return IsSpecial(WIRE_ID); }
+  bool IsIsA() const { return IsSpecial(WIRE_ISA); }
+  bool IsIs() const { return IsSpecial(WIRE_IS); }
+  bool IsInt() const { return type_ == WIRE_INTEGER; }
+  bool IsFloat() const { return type_ == WIRE_FLOAT; }
+  bool IsIndex() const { return IsSpecial(WIRE_INDEX); }
+  bool IsString() const { return type_ == WIRE_STRING; }
+  bool IsSymbol() const {
+    return type_ == WIRE_SYMBOL || type_ == WIRE_LINK;
+  }
+  bool IsFrame() const {
+    return type_ == WIRE_FRAME || IsSpecial(WIRE_RESOLVE) ||
+           IsSpecial(WIRE_SHAPE) || IsSpecial(WIRE_SHAPED);
+  }
+  bool IsArray() const { return IsSpecial(WIRE_ARRAY); }
+
+  // Returns numeric values.
+  int AsInt() const { return Handle::Integer(arg_).AsInt(); }
+  float AsFloat() const { return Handle::FromFloatBits(arg_).AsFloat(); }
+  int AsIndex() const;
+
+  // Returns the contents of a string or the name of a symbol.
+  Text AsString() const { return Text(data_, IsString() ? arg_ : 0); }
+  Text AsSymbol() const;
+
+  // Returns the number of slots in a frame or elements in an array.
+  int size() const { return size_; }
+
+  // Returns array element. This skips over all the preceding elements, so use
+  // elements() for iterating over an array.
+  WireObject at(int index) const;
+
+  // Position of slot name for frame shape.
+  struct NamePosition {
+    const char *ptr;     // start of slot name
+    int ref;             // number of objects that can be referenced before it
+  };
+
+  // Iterator for frame slots. For frames with shapes, the slot names are taken
+  // from the shape and only the slot values are in the frame.
+  class Iterator {
+   public:
+    Iterator(const WireView *view, const char *ptr, int ref, int remaining,
+             const NamePosition *names)
+        : view_(view), ptr_(ptr), ref_(ref), remaining_(remaining),
+          names_(names) {}
+
+    bool operator !=(const Iterator &other) const {
+      return remaining_ != other.remaining_;
+    }
+
+    WireSlot operator *() const;
+    void operator ++();
+
+   private:
+    const WireView *view_;
+    const char *ptr_;
+    int ref_;
+    int remaining_;
+    const NamePosition *names_;
+  };
+
+  // Iteration over frame slots.
+  Iterator begin() const {
+    return Iterator(view_, data_, first_ref(), size_, shape_names());
+  }
+  Iterator end() const { return Iterator(view_, nullptr, 0, 0, nullptr); }
+
+  // Iterator for array elements.
+  class ElementIterator {
+   public:
+    ElementIterator(const WireView *view, const char *ptr, int ref,
+                    int remaining)
+        : view_(view), ptr_(ptr), ref_(ref), remaining_(remaining) {}
+
+    bool operator !=(const ElementIterator &other) const {
+      return remaining_ != other.remaining_;
+    }
+
+    WireObject operator *() const { return WireObject(view_, ptr_, ref_); }
+    void operator ++();
+
+   private:
+    const WireView *view_;
+    const char *ptr_;
+    int ref_;
+    int remaining_;
+  };
+
+  // Range of array elements.
+  struct Elements {
+    ElementIterator begin() const {
+      return ElementIterator(view, ptr, ref, size);
+    }
+    ElementIterator end() const {
+      return ElementIterator(view, nullptr, 0, 0);
+    }
+
+    const WireView *view;
+    const char *ptr;
+    int ref;
+    int size;
+  };
+
+  // Iteration over array elements.
+  Elements elements() const {
+    return Elements{view_, data_, first_ref(), size_};
+  }
+
+  // Returns the value of the first slot with the given name. Slot names that
+  // are symbols are matched by name. Returns an invalid object if the frame
+  // has no such slot.
+  WireObject Get(Text name) const;
+
+  // Returns true if frame has a slot with the given name.
+  bool Has(Text name) const { return Get(name).valid(); }
+
+  // Returns slot values of specific types.
+  Text GetString(Text name) const { return Get(name).AsString(); }
+  int GetInt(Text name, int defval = 0) const;
+
+  // Returns the id of a frame, or an empty text if the frame is anonymous.
+  Text Id() const;
+
+  // Checks if the frame has an isa slot with the given type.
+  bool IsA(Text type) const;
+
+  // Decodes the object and all the objects it refers to into the store.
+  Object Materialize(Store *store) const;
+
+ private:
+  // Initializes object at position, where 'ref' is the number of objects
+  // before the position that can be referenced.
+  WireObject(const WireView *view, const char *ptr, int ref);
+
+  // Decodes the tag at the current position.
+  void Parse();
+
+  // Returns the number of objects that can be referenced before the slots or
+  // elements. Frames and arrays can be referenced themselves, but resolved
+  // frames reuse the reference number of the link. The slot values for a frame
+  // that defines a shape come after the slot names.
+  int first_ref() const;
+
+  // Returns the positions of the slot names for frames with shapes, or null if
+  // the slot names are encoded in the frame.
+  const NamePosition *shape_names() const;
+
+  // Checks if the object is a symbol or a frame with the given name.
+  bool Matches(Text name) const;
+
+  bool IsSpecial(int code) const {
+    return type_ == WIRE_SPECIAL && arg_ == code;
+  }
+
+  // View for the buffer with the object.
+  const WireView *view_;
+
+  // Position of the tag for the object in the buffer.
+  const char *ptr_;
+
+  // Number of objects that can be referenced before the object. If the object
+  // can be referenced, this is also its reference number.
+  int ref_ = 0;
+
+  // Wire type and tag argument.
+  int type_ = 0;
+  uint64 arg_ = 0;
+
+  // Position of the object data after the tag, i.e. the first slot, element,
+  // or byte of a string or symbol name.
+  const char *data_ = nullptr;
+
+  // Number of slots or elements.
+  int size_ = 0;
+
+  // Shape number for frames with shapes, or -1 if the frame has no shape.
+  int shape_ = -1;
+
+  friend class WireView;
+  friend class WireMaterializer;
+};
+
+// Slot in wire frame.
+struct WireSlot {
+  WireObject name;
+  WireObject value;
+};
+
+// A wire view gives lazy access to objects encoded in binary wire format in a
+// memory buffer, e.g. a memory-mapped file or an encoded document. The view
+// only builds an index of the positions of the objects in the buffer, so slots
+// can be looked up without allocating any objects in a store. Parts of the
+// object graph can then be materialized into a store on request.
+class WireView {
+ public:
+  // Indexes encoded objects in buffer. The buffer must outlive the view.
+  WireView(const char *data, size_t size);
+  explicit WireView(Text data) : WireView(data.data(), data.size()) {}
+
+  // Returns the number of top-level objects in the buffer.
+  int size() const { return objects_.size(); }
+
+  // Returns top-level object.
+  WireObject object(int index) const {
+    return WireObject(this, objects_[index].ptr, objects_[index].ref);
+  }
+
+  // Returns the last top-level object, which is the one that a decoder would
+  // return from DecodeAll().
+  WireObject last() const {
+    return objects_.empty() ? WireObject() : object(objects_.size() - 1);
+  }
+
+  // Returns the number of objects that can be referenced.
+  int references() const { return refs_.size(); }
+
+  // Decodes object into the store.
+  Object Materialize(Store *store, const WireObject &object) const;
+
+ private:
+  // Position of top-level object in the buffer.
+  struct Position {
+    const char *ptr;     // start of object
+    int ref;             // number of objects that can be referenced before it
+  };
+
+  // Position of object that can be referenced.
+  struct Ref {
+    const char *begin;   // start of object
+    const char *end;     // end of object
+    const char *target;  // object for reference; differs from begin if the
+                         // object is a link that is resolved later
+    int next;            // number of objects that can be referenced after it
+  };
+
+  // Frame shape in the buffer.
+  struct Shape {
+    const char *begin;   // start of frame that defines the shape
+    const char *values;  // slot values in the frame that defines the shape
+    int names;           // position of the slot names in shape_names_
+    int slots;           // number of slots
+    int ref;             // number of objects that can be referenced before
+                         // the slot values in the frame that defines the shape
+  };
+
+  // Position of resolved frame in the buffer.
+  struct Resolve {
+    const char *begin;   // start of resolved frame
+    const char *end;     // end of resolved frame
+    int ref;             // reference number of the link for the frame
+    int first;           // number of objects that can be referenced before it
+    int next;            // number of objects that can be referenced after it
+  };
+
+  // Reads varint from buffer.
+  const char *ReadVarint64(const char *p, uint64 *value) const;
+  const char *ReadVarint32(const char *p, uint32 *value) const;
+
+  // Indexes the object at position and returns the position after it.
+  const char *Index(const char *p);
+
+  // Returns the position after the object at position. The number of objects
+  // that can be referenced is updated to include the skipped objects.
+  const char *Skip(const char *p, int *ref) const;
+
+  // Returns resolve record for resolved frame at position.
+  const Resolve *FindResolve(const char *p) const;
+
+  // Returns shape defined by the frame at position.
+  const Shape *FindShape(const char *p) const;
+
+  // Reads symbol dictionary at position and returns the position after it.
+  const char *ReadDictionary(const char *p);
+
+  // Returns true if the buffer has symbol dictionaries, i.e. the argument for
+  // symbol and link tags is the dictionary index for the symbol.
+  bool has_dictionary() const { return !dictionary_.empty(); }
+
+  // Returns symbol name from symbol dictionary.
+  Text DictionaryName(uint64 index) const {
+    const Name &name = dictionary_[index];
+    return Text(names_.data() + name.offset, name.size);
+  }
+
+  // Encoded buffer.
+  const char *data_;
+  const char *limit_;
+
+  // Positions of top-level objects.
+  std::vector<Position> objects_;
+
+  // Positions of objects by reference number.
+  std::vector<Ref> refs_;
+
+  // Positions of resolved frames.
+  std::vector<Resolve> resolves_;
+
+  // Symbol names in symbol dictionaries. Names are prefix-compressed in the
+  // buffer, so the names are stored in the view.
+  struct Name {
+    int offset;          // offset of name in names_
+    int size;            // size of name
+  };
+  std::vector<Name> dictionary_;
+  string names_;
+
+  // Frame shapes and the positions of the slot names for the shapes.
+  std::vector<Shape> shapes_;
+  std::vector<WireObject::NamePosition> shape_names_;
+
+  friend class WireObject;
+  friend class WireMaterializer;
+
+  DISALLOW_COPY_AND_ASSIGN(WireView);
+};
+
+inline int WireObject::first_ref() const {
+  if (IsSpecial(WIRE_RESOLVE)) return ref_;
+  if (IsSpecial(WIRE_SHAPE)) return view_->shapes_[shape_].ref;
+  return ref_ + 1;
+}
+
+inline const WireObject::NamePosition *WireObject::shape_names() const {
+  if (shape_ == -1) return nullptr;
+  return view_->shape_names_.data() + view_->shapes_[shape_].names;
+}
+
+inline Text WireObject::AsSymbol() const {
+  if (!IsSymbol()) return Text();
+  if (view_->has_dictionary()) return view_->DictionaryName(arg_);
+  return Text(data_, arg_);
+}
+
+}  // namespace sling
+
+#endif  // FRAME_WIRE_VIEW_H_
@@ -38,6 +38,30 @@ enum WireSpecial {
   WIRE_ARRAY    = 5,  // array, followed by array size and the arguments
   WIRE_INDEX    = 6,  // index value, followed by varint32 encoded integer
   WIRE_RESOLVE  = 7,  // resolve link, followed by slots and replacement index
+  WIRE_SYMBOLS  = 8,  // symbol dictionary, followed by symbol count and names
+  WIRE_SHAPE    = 9,  // frame with new shape, followed by size, names, values
+  WIRE_SHAPED   = 10, // frame with known shape, followed by shape and values
+};
+
+// Wire format versions. In version 1, symbol names are encoded inline the first
+// time the symbol or link is output. In version 2, each encoded object is
+// preceded by a dictionary with the names of the symbols that are used for the
+// first time in the object. The names in the dictionary are sorted, and each
+// name is encoded as the length of the prefix it shares with the previous name,
+// the length of the rest of the name, and the rest of the name. Dictionary
+// entries are numbered consecutively across all the dictionaries in the
+// input, and the argument for symbol and link tags is then the dictionary
+// number instead of the name length. In version 3, frames with the same slot
+// names as an earlier frame are encoded using shapes. The second frame with a
+// particular sequence of slot names is encoded with a shape tag followed by the
+// number of slots, the slot names, and the slot values. This defines a new
+// shape, and shapes are numbered consecutively in the input. Subsequent frames
+// with the same slot names are encoded with a shaped tag followed by the shape
+// number and only the slot values.
+enum WireVersion {
+  WIRE_VERSION_1 = 1,
+  WIRE_VERSION_2 = 2,
+  WIRE_VERSION_3 = 3,
 };
 
 }  // namespace sling
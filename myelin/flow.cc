@@ -555,6 +555,7 @@ Flow::~Flow() {
   for (auto *func : funcs_) delete func;
   for (auto *cnx : cnxs_) delete cnx;
   for (auto *ptr : memory_) free(ptr);
+  for (auto &m : mappings_) File::Unmap(m.first, m.second);
 }
 
 char *Flow::AllocateMemory(size_t size) {
@@ -570,8 +571,15 @@ Status Flow::Load(const string &filename) {
   if (!st.ok()) return st;
   uint64 size;
   CHECK(file->GetSize(&size));
-  char *data = AllocateMemory(size);
-  file->ReadOrDie(data, size);
+
+  // Map flow file into memory if possible to avoid copying the parameters.
+  char *data = static_cast<char *>(file->Map(0, size));
+  if (data != nullptr) {
+    mappings_.emplace_back(data, size);
+  } else {
+    data = AllocateMemory(size);
+    file->ReadOrDie(data, size);
+  }
   st = file->Close();
   if (!st.ok()) return st;
 
@@ -17,6 +17,7 @@
 
 #include <string>
 #include <unordered_map>
+#include <utility>
 #include <vector>
 
 #include "base/status.h"
@@ -624,6 +625,9 @@ class Flow {
   // Data areas owned by flow.
   std::vector<char *> memory_;
 
+  // Memory-mapped flow files.
+  std::vector<std::pair<char *, size_t>> mappings_;
+
   // Batch size.
   int batch_size_ = -1;
 };
@@ -21,6 +21,7 @@
 #include "file/file.h"
 #include "frame/object.h"
 #include "frame/serialization.h"
+#include "stream/record.h"
 #include "util/zip-iterator.h"
 
 namespace sling {
@@ -79,11 +80,67 @@ class ZipDocumentSource : public DocumentSource {
   string file_;
 };
 
+// Iterator implementation for record files. Each record holds an encoded
+// document keyed by its name. The records in all the files matching the file
+// pattern are read in order. If the source is restricted to a part of the
+// corpus, only the corresponding contiguous block range of each file is read.
+class RecordDocumentSource : public DocumentSource {
+ public:
+  RecordDocumentSource(const std::vector<string> &files, int part, int parts)
+      : files_(files), part_(part), parts_(parts) {}
+
+  ~RecordDocumentSource() override {
+    delete reader_;
+  }
+
+  bool NextSerialized(string *name, string *contents) override {
+    Record record;
+    for (;;) {
+      // Open next file.
+      if (reader_ == nullptr) {
+        if (index_ >= files_.size()) return false;
+        reader_ = new RecordReader(files_[index_++]);
+        if (parts_ > 1) reader_->Split(part_, parts_);
+      }
+
+      // Read next record from current file.
+      if (reader_->Read(&record)) break;
+      CHECK(reader_->status()) << reader_->status();
+      delete reader_;
+      reader_ = nullptr;
+    }
+    name->assign(record.key.data(), record.key.size());
+    contents->assign(record.value.data(), record.value.size());
+    return true;
+  }
+
+  void Rewind() override {
+    delete reader_;
+    reader_ = nullptr;
+    index_ = 0;
+  }
+
+ private:
+  // Record files in corpus.
+  std::vector<string> files_;
+
+  // Part of the corpus to read.
+  int part_;
+  int parts_;
+
+  // Reader for current file, or null if no file is open.
+  RecordReader *reader_ = nullptr;
+
+  // Index of the next file to open.
+  int index_ = 0;
+};
+
 Document *DocumentSource::Next(Store *store) {
   string name, contents;
   if (!NextSerialized(&name, &contents)) return nullptr;
 
   StringDecoder decoder(store, contents);
+  decoder.decoder()->set_symbol_cache(symbol_cache_);
   return new Document(decoder.Decode().AsFrame());
 }
 
@@ -92,6 +149,7 @@ Document *DocumentSource::Next(Store *store, string *name) {
   if (!NextSerialized(name, &contents)) return nullptr;
 
   StringDecoder decoder(store, contents);
+  decoder.decoder()->set_symbol_cache(symbol_cache_);
   return new Document(decoder.Decode().AsFrame());
 }
 
@@ -102,16 +160,42 @@ bool HasSuffix(const string &s, const string &suffix) {
   return (s.size() >= len) && (s.substr(s.size() - len) == suffix);
 }
 
+// Checks if a file pattern is for record files, including sharded record files
+// like corpus.rec@10.
+bool IsRecordPattern(const string &s) {
+  int at = s.find('@');
+  return HasSuffix(at == string::npos ? s : s.substr(0, at), ".rec");
+}
+
 }  // namespace
 
 DocumentSource *DocumentSource::Create(const string &file_pattern) {
+  return Create(file_pattern, 0, 1);
+}
+
+DocumentSource *DocumentSource::Create(const string &file_pattern,
+                                       int part, int parts) {
+  CHECK_GE(part, 0);
+  CHECK_LT(part, parts);
+
   // TODO: Add more formats as needed.
   if (HasSuffix(file_pattern, ".zip")) {
+    CHECK_EQ(parts, 1) << "Zip corpora cannot be split: " << file_pattern;
     return new ZipDocumentSource(file_pattern);
+  } else if (IsRecordPattern(file_pattern)) {
+    std::vector<string> files;
+    CHECK(File::Match(file_pattern, &files));
+    CHECK(!files.empty()) << "No files match " << file_pattern;
+    return new RecordDocumentSource(files, part, parts);
   } else {
+    // Each part gets every parts-th file.
     std::vector<string> files;
     CHECK(File::Match(file_pattern, &files));
-    return new EncodedDocumentSource(files);
+    std::vector<string> selected;
+    for (int i = part; i < files.size(); i += parts) {
+      selected.push_back(files[i]);
+    }
+    return new EncodedDocumentSource(selected);
   }
 
   return nullptr;
@@ -18,6 +18,7 @@
 #include <string>
 
 #include "frame/store.h"
+#include "frame/symbol-cache.h"
 #include "nlp/document/document.h"
 
 namespace sling {
@@ -45,8 +46,24 @@ class DocumentSource {
   // Rewinds to the start of the corpus.
   virtual void Rewind() = 0;
 
+  // Resolves symbols in decoded documents through a symbol cache for the
+  // global store of the document stores. The cache is not owned by the source.
+  void set_symbol_cache(SymbolCache *cache) { symbol_cache_ = cache; }
+
   // Returns an iterator implementation depending on 'file_pattern'.
   static DocumentSource *Create(const string &file_pattern);
+
+  // Returns an iterator over part number 'part' out of 'parts' parts of the
+  // corpus, so that several workers can each read their own part. Record files
+  // are split into contiguous block ranges, and each part reads its range of
+  // every file. For corpora with one document per file, the files are divided
+  // between the parts. Zip archives cannot be split.
+  static DocumentSource *Create(const string &file_pattern,
+                                int part, int parts);
+
+ private:
+  // Symbol cache for decoding documents, or null if symbols are not cached.
+  SymbolCache *symbol_cache_ = nullptr;
 };
 
 }  // namespace nlp
@@ -201,21 +201,31 @@ void Document::Update() {
 
   // Update tokens.
   if (tokens_changed_) {
-    Handles tokens(store());
-    tokens.reserve(tokens_.size());
-    for (int i = 0; i < tokens_.size(); ++i) {
+    // The slots for all the token frames are collected in one flat slot array
+    // and the token frames are then allocated in bulk.
+    int num_tokens = tokens_.size();
+    Slots slots(store());
+    std::vector<int> sizes(num_tokens);
+    slots.reserve(num_tokens * 6);
+    for (int i = 0; i < num_tokens; ++i) {
       Token &t = tokens_[i];
-      Builder token(store());
-      token.AddIsA(n_token_);
-      token.Add(n_token_index_, i);
-      token.Add(n_token_text_, t.text_);
-      token.Add(n_token_start_, t.begin_);
-      token.Add(n_token_length_, t.end_ - t.begin_);
+      int begin = slots.size();
+      slots.emplace_back(Handle::isa(), n_token_.handle());
+      slots.emplace_back(n_token_index_.handle(), Handle::Integer(i));
+      slots.emplace_back(n_token_text_.handle(),
+                         store()->AllocateString(t.text_));
+      slots.emplace_back(n_token_start_.handle(), Handle::Integer(t.begin_));
+      slots.emplace_back(n_token_length_.handle(),
+                         Handle::Integer(t.end_ - t.begin_));
       if (t.brk_ != SPACE_BREAK) {
-        token.Add(n_token_break_, t.brk_);
+        slots.emplace_back(n_token_break_.handle(), Handle::Integer(t.brk_));
       }
-      tokens.push_back(token.Create().handle());
+      sizes[i] = slots.size() - begin;
     }
+    Handles tokens(store());
+    tokens.resize(num_tokens);
+    store()->AllocateFrames(slots.data(), sizes.data(), num_tokens,
+                            tokens.data());
     Array token_array(store(), tokens);
     builder.Set(n_document_tokens_, token_array);
     tokens_changed_ = false;
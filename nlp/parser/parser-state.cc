@@ -401,6 +401,7 @@ void ParserState::GetFrames(Handles *frames) {
     FrameDatum *source = store_->GetFrame(frames_[i]);
     FrameDatum *target = store_->GetFrame((*frames)[i]);
     if (target == source) continue;
+    store_->WriteBarrier(target);
     Slot *s = source->begin();
     Slot *end = source->end();
     Slot *t = target->begin();
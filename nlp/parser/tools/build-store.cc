@@ -22,8 +22,15 @@
 #include "base/flags.h"
 #include "frame/object.h"
 #include "frame/serialization.h"
+#include "frame/store-stats.h"
+#include "util/table-writer.h"
 
 DEFINE_string(o, "", "Output for encoded store");
+DEFINE_bool(snapshot, false, "Also write memory-mappable store snapshot");
+DEFINE_bool(coalesce_frames, false, "Merge identical anonymous frames");
+DEFINE_bool(store_stats, false, "Output memory and GC statistics for store");
+DEFINE_int32(store_sampling, 0, "Sample store allocations every n bytes");
+DEFINE_int32(mark_threads, 1, "Number of threads for marking in full GCs");
 
 using namespace sling;
 
@@ -31,7 +38,10 @@ int main(int argc, char *argv[]) {
   InitProgram(&argc, &argv);
 
   // Initialize new store.
-  Store store;
+  Store::Options options;
+  options.allocation_sampling = FLAGS_store_sampling;
+  options.mark_threads = FLAGS_mark_threads;
+  Store store(&options);
 
   // Load content into store.
   for (int i = 1; i < argc; ++i) {
@@ -49,6 +59,7 @@ int main(int argc, char *argv[]) {
 
   // Compact store.
   store.CoalesceStrings();
+  if (FLAGS_coalesce_frames) store.CoalesceFrames();
   store.GC();
   store.Freeze();
 
@@ -58,10 +69,27 @@ int main(int argc, char *argv[]) {
   Output output(&stream);
   Encoder encoder(&store, &output);
   encoder.set_shallow(true);
+  encoder.set_streaming(true);
   encoder.EncodeAll();
   output.Flush();
   CHECK(stream.Close());
 
+  // Save store snapshot.
+  if (FLAGS_snapshot) {
+    string snapshot = FLAGS_o + ".snap";
+    LOG(INFO) << "Writing store snapshot to " << snapshot;
+    CHECK(store.WriteSnapshot(snapshot, FLAGS_o));
+  }
+
+  // Output store statistics.
+  if (FLAGS_store_stats) {
+    TableWriter writer;
+    WriteStoreStats(store, "Store", &writer);
+    string report;
+    writer.Write(&report);
+    std::cout << report;
+  }
+
   LOG(INFO) << "Done.";
   return 0;
 }
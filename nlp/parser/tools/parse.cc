@@ -37,12 +37,16 @@
 #include "base/flags.h"
 #include "frame/object.h"
 #include "frame/serialization.h"
+#include "frame/store-pool.h"
+#include "frame/store-stats.h"
+#include "frame/symbol-cache.h"
 #include "nlp/document/document.h"
 #include "nlp/document/document-source.h"
 #include "nlp/document/document-tokenizer.h"
 #include "nlp/parser/parser.h"
 #include "nlp/parser/trainer/frame-evaluation.h"
 #include "string/printf.h"
+#include "util/table-writer.h"
 
 DEFINE_string(parser, "", "Input file with flow model");
 DEFINE_string(text, "", "Text to parse");
@@ -53,6 +57,8 @@ DEFINE_bool(benchmark, false, "Benchmark parser");
 DEFINE_bool(evaluate, false, "Evaluate parser");
 DEFINE_bool(profile, false, "Profile parser");
 DEFINE_int32(maxdocs, -1, "Maximum number of documents to process");
+DEFINE_bool(store_stats, false, "Output memory and GC statistics for stores");
+DEFINE_int32(store_sampling, 0, "Sample store allocations every n bytes");
 
 using namespace sling;
 using namespace sling::nlp;
@@ -72,13 +78,36 @@ Document *RemoveAnnotations(Document *document) {
   return new Document(b.Create());
 }
 
+// Outputs store statistics if requested.
+void OutputStoreStats(const Store &store, const string &name,
+                      const MemoryUsage *objects = nullptr) {
+  if (!FLAGS_store_stats) return;
+  TableWriter writer;
+  WriteStoreStats(store, name, &writer, objects);
+  string report;
+  writer.Write(&report);
+  std::cout << report << "\n";
+}
+
+// Outputs symbol cache statistics if requested.
+void OutputSymbolCacheStats(const SymbolCache &cache, const string &name) {
+  if (!FLAGS_store_stats) return;
+  TableWriter writer;
+  WriteSymbolCacheStats(cache, name, &writer);
+  string report;
+  writer.Write(&report);
+  std::cout << report << "\n";
+}
+
 // Parallel corpus for evaluating parser on golden corpus.
 class ParserEvaulationCorpus : public ParallelCorpus {
  public:
   ParserEvaulationCorpus(Store *commons, const Parser *parser,
-                         const string &eval_corpus_filename)
-      : commons_(commons), parser_(parser) {
+                         const string &eval_corpus_filename,
+                         SymbolCache *symbols)
+      : pool_(commons), parser_(parser) {
     corpus_ = DocumentSource::Create(eval_corpus_filename);
+    corpus_->set_symbol_cache(symbols);
   }
 
   ~ParserEvaulationCorpus() override {
@@ -90,13 +119,13 @@ class ParserEvaulationCorpus : public ParallelCorpus {
     num_documents_++;
     if (FLAGS_maxdocs != -1 && num_documents_ >= FLAGS_maxdocs) return false;
 
-    // Create a local store for both golden and parsed document.
-    Store *locals = new Store(commons_);
+    // Get a local store for both golden and parsed document.
+    Store *locals = pool_.Acquire();
 
     // Read next document from corpus.
     Document *document = corpus_->Next(locals);
     if (document == nullptr) {
-      delete locals;
+      pool_.Release(locals);
       return false;
     }
 
@@ -115,8 +144,11 @@ class ParserEvaulationCorpus : public ParallelCorpus {
     return true;
   }
 
+  // Returns the local store to the pool for the next document.
+  void Release(Store *store) override { pool_.Release(store); }
+
  private:
-  Store *commons_;           // commons store
+  StorePool pool_;           // pool of local stores on top of commons
   const Parser *parser_;     // parser being evaluated
   DocumentSource *corpus_;   // evaulation corpus with golden annotations
   int num_documents_ = 0;    // number of documents processed
@@ -129,11 +161,14 @@ int main(int argc, char *argv[]) {
   LOG(INFO) << "Load parser from " << FLAGS_parser;
   Clock clock;
   clock.start();
-  Store commons;
+  Store::Options options;
+  options.allocation_sampling = FLAGS_store_sampling;
+  Store commons(&options);
   Parser parser;
   if (FLAGS_profile) parser.EnableProfiling();
   parser.Load(&commons, FLAGS_parser);
   commons.Freeze();
+  SymbolCache symbols(&commons);
   clock.stop();
   LOG(INFO) << clock.ms() << " ms loading parser";
 
@@ -155,6 +190,7 @@ int main(int argc, char *argv[]) {
 
     std::cout << ToText(document.top(), FLAGS_indent) << "\n";
     LOG(INFO) << document.num_tokens() / clock.secs() << " tokens/sec";
+    OutputStoreStats(store, "Document store");
   }
 
   // Parse input corpus.
@@ -162,11 +198,13 @@ int main(int argc, char *argv[]) {
     CHECK(!FLAGS_corpus.empty());
     LOG(INFO) << "Parse " << FLAGS_corpus;
     DocumentSource *corpus = DocumentSource::Create(FLAGS_corpus);
+    corpus->set_symbol_cache(&symbols);
     int num_documents = 0;
+    Store store(&commons);
+    MemoryUsage objects = MemoryUsage();
     for (;;) {
       if (FLAGS_maxdocs != -1 && num_documents >= FLAGS_maxdocs) break;
 
-      Store store(&commons);
       Document *document = corpus->Next(&store);
       if (document == nullptr) break;
       num_documents++;
@@ -177,8 +215,11 @@ int main(int argc, char *argv[]) {
       std::cout << ToText(document->top(), FLAGS_indent) << "\n";
 
       delete document;
+      if (FLAGS_store_stats) AddObjectStats(store, &objects);
+      store.Reset();
     }
     delete corpus;
+    OutputStoreStats(store, "Document store", &objects);
   }
 
   // Benchmark parser on corpus.
@@ -186,13 +227,15 @@ int main(int argc, char *argv[]) {
     CHECK(!FLAGS_corpus.empty());
     LOG(INFO) << "Benchmarking parser on " << FLAGS_corpus;
     DocumentSource *corpus = DocumentSource::Create(FLAGS_corpus);
+    corpus->set_symbol_cache(&symbols);
     int num_documents = 0;
     int num_tokens = 0;
+    Store store(&commons);
+    MemoryUsage objects = MemoryUsage();
     clock.start();
     for (;;) {
       if (FLAGS_maxdocs != -1 && num_documents >= FLAGS_maxdocs) break;
 
-      Store store(&commons);
       Document *document = corpus->Next(&store);
       if (document == nullptr) break;
 
@@ -205,19 +248,22 @@ int main(int argc, char *argv[]) {
       parser.Parse(document);
 
       delete document;
+      if (FLAGS_store_stats) AddObjectStats(store, &objects);
+      store.Reset();
     }
     clock.stop();
     LOG(INFO) << num_documents << " documents, "
               << num_tokens << " tokens, "
               << num_tokens / clock.secs() << " tokens/sec";
     delete corpus;
+    OutputStoreStats(store, "Document store", &objects);
   }
 
   // Evaluate parser on gold corpus.
   if (FLAGS_evaluate) {
     CHECK(!FLAGS_corpus.empty());
     LOG(INFO) << "Evaluating parser on " << FLAGS_corpus;
-    ParserEvaulationCorpus corpus(&commons, &parser, FLAGS_corpus);
+    ParserEvaulationCorpus corpus(&commons, &parser, FLAGS_corpus, &symbols);
     FrameEvaluation::Output eval;
     FrameEvaluation::Evaluate(&corpus, &eval);
 
@@ -244,6 +290,9 @@ int main(int argc, char *argv[]) {
     std::cout << ff.ASCIIReport() << "\n";
   }
 
+  OutputStoreStats(commons, "Commons store");
+  OutputSymbolCacheStats(symbols, "Commons store");
+
   return 0;
 }
 
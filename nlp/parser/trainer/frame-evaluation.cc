@@ -18,6 +18,7 @@
 
 #include "base/logging.h"
 #include "frame/serialization.h"
+#include "frame/symbol-cache.h"
 #include "nlp/document/document-source.h"
 #include "string/strcat.h"
 
@@ -34,12 +35,22 @@ class FileParallelCorpus : public ParallelCorpus {
     commons_ = commons;
     gold_corpus_ = DocumentSource::Create(gold_file_pattern);
     test_corpus_ = DocumentSource::Create(test_file_pattern);
+
+    // Both corpora use the same schema symbols, so these are resolved through
+    // a shared symbol cache if the commons store is frozen.
+    symbols_ = nullptr;
+    if (commons->frozen()) {
+      symbols_ = new SymbolCache(commons);
+      gold_corpus_->set_symbol_cache(symbols_);
+      test_corpus_->set_symbol_cache(symbols_);
+    }
   }
 
   // Close corpora.
   ~FileParallelCorpus() override {
     delete gold_corpus_;
     delete test_corpus_;
+    delete symbols_;
   }
 
   // Read next document pair from corpora.
@@ -61,6 +72,7 @@ class FileParallelCorpus : public ParallelCorpus {
   Store *commons_;               // commons store for documents
   DocumentSource *gold_corpus_;  // corpus with gold annotations
   DocumentSource *test_corpus_;  // corpus with predicted annotations
+  SymbolCache *symbols_;         // symbol cache for commons store
 };
 
 bool FrameEvaluation::Alignment::Map(Handle source, Handle target) {
@@ -101,14 +113,12 @@ void FrameEvaluation::Evaluate(ParallelCorpus *corpus, Output *output) {
   Document *predicted;
   while (corpus->Next(&store, &golden, &predicted)) {
     CHECK_EQ(golden->num_tokens(), predicted->num_tokens());
-    Frame golden_top = golden->top();
-    Frame predicted_top = predicted->top();
 
     // Get mention maps.
     MentionMap golden_mentions;
     MentionMap predicted_mentions;
-    GetMentionMap(golden_top, &golden_mentions);
-    GetMentionMap(predicted_top, &predicted_mentions);
+    GetMentionMap(golden->top(), &golden_mentions);
+    GetMentionMap(predicted->top(), &predicted_mentions);
 
     // Compute mention span alignments.
     Alignment g2p_mention_alignment;
@@ -152,7 +162,7 @@ void FrameEvaluation::Evaluate(ParallelCorpus *corpus, Output *output) {
 
     delete golden;
     delete predicted;
-    delete store;
+    corpus->Release(store);
   }
 
   // Compute the slot score as the sum of the type, role, and label scores.
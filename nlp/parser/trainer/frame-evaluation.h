@@ -36,8 +36,12 @@ class ParallelCorpus {
   virtual ~ParallelCorpus() = default;
 
   // Read next pair of documents. Return false when there are no more documents.
-  // Ownership of the store and documents is transferred to the caller.
+  // Ownership of the documents is transferred to the caller. The store must be
+  // returned with Release() when the documents have been deleted.
   virtual bool Next(Store **store, Document **golden, Document **predicted) = 0;
+
+  // Releases the store for a pair of documents. The default deletes the store.
+  virtual void Release(Store *store) { delete store; }
 };
 
 // Compute precision and recall for frame annotations in an annotated corpus
@@ -13,6 +13,7 @@
 
 #include "nlp/parser/trainer/shared-resources.h"
 
+#include "base/logging.h"
 #include "base/macros.h"
 #include "file/file.h"
 #include "frame/serialization.h"
@@ -31,6 +32,17 @@ void SharedResources::LoadActionTable(const string &file) {
 
 void SharedResources::LoadGlobalStore(const string &file) {
   delete global;
+
+  // Map store snapshot if it is available and up to date.
+  string snapshot = file + ".snap";
+  if (Store::ValidSnapshot(snapshot, file)) {
+    global = new Store(snapshot);
+    return;
+  }
+  if (File::Exists(snapshot)) {
+    LOG(WARNING) << "Ignoring stale or invalid store snapshot " << snapshot;
+  }
+
   global = new Store();
   sling::LoadStore(file, global);
   global->Freeze();
@@ -17,6 +17,8 @@
 #include <string>
 #include <vector>
 
+#include "base/logging.h"
+#include "file/file.h"
 #include "stream/bzip2.h"
 #include "stream/file.h"
 #include "stream/gzip.h"
@@ -55,28 +57,38 @@ int64 InputPipeline::ByteCount() const {
 
 InputStream *FileInput::Open(const string &filename, int block_size) {
   // Open input file.
-  InputStream *stream = new FileInputStream(filename, block_size);
+  File *file = File::OpenOrDie(filename, "r");
 
   // Get file extension.
+  string ext;
   int dot = filename.find_last_of('.');
-  if (dot != -1) {
-    string ext = filename.substr(dot);
-    InputStream *decompressor = nullptr;
-    if (ext == ".gz") {
-      // Add GZIP decompressor.
-      decompressor = new GZipDecompressor(stream, block_size);
-    } else if (ext == ".bz2") {
-      // Add BZIP2 decompressor.
-      decompressor =  new BZip2Decompressor(stream, block_size);
+  if (dot != -1) ext = filename.substr(dot);
+
+  // Read uncompressed files directly from memory if the file can be mapped.
+  if (ext != ".gz" && ext != ".bz2") {
+    InputStream *mapped = MappedInputStream::Open(file, block_size);
+    if (mapped != nullptr) {
+      CHECK(file->Close());
+      return mapped;
     }
+  }
+  InputStream *stream = new FileInputStream(file, block_size);
+
+  InputStream *decompressor = nullptr;
+  if (ext == ".gz") {
+    // Add GZIP decompressor.
+    decompressor = new GZipDecompressor(stream, block_size);
+  } else if (ext == ".bz2") {
+    // Add BZIP2 decompressor.
+    decompressor =  new BZip2Decompressor(stream, block_size);
+  }
 
-    // Create input pipeline for compressed files.
-    if (decompressor != nullptr) {
-      InputPipeline *pipeline = new InputPipeline();
-      pipeline->Add(stream);
-      pipeline->Add(decompressor);
-      stream = pipeline;
-    }
+  // Create input pipeline for compressed files.
+  if (decompressor != nullptr) {
+    InputPipeline *pipeline = new InputPipeline();
+    pipeline->Add(stream);
+    pipeline->Add(decompressor);
+    stream = pipeline;
   }
 
   return stream;
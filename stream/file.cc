@@ -112,6 +112,62 @@ int64 FileInputStream::ByteCount() const {
   return position_ - backup_;
 }
 
+MappedInputStream::MappedInputStream(const char *data, uint64 size,
+                                     int block_size) {
+  data_ = data;
+  size_ = size;
+  block_size_ = block_size;
+  last_ = 0;
+  position_ = 0;
+}
+
+MappedInputStream::~MappedInputStream() {
+  File::Unmap(const_cast<char *>(data_), size_);
+}
+
+MappedInputStream *MappedInputStream::Open(File *file, int block_size) {
+  uint64 size;
+  if (!file->GetSize(&size).ok()) return nullptr;
+  void *data = file->Map(0, size);
+  if (data == nullptr) return nullptr;
+  return new MappedInputStream(static_cast<char *>(data), size, block_size);
+}
+
+bool MappedInputStream::Next(const void **data, int *size) {
+  if (position_ == size_) {
+    last_ = 0;
+    return false;
+  }
+
+  // Return the next block of the mapped file.
+  uint64 remaining = size_ - position_;
+  last_ = remaining < block_size_ ? remaining : block_size_;
+  *data = data_ + position_;
+  *size = last_;
+  position_ += last_;
+  return true;
+}
+
+void MappedInputStream::BackUp(int count) {
+  CHECK(count <= last_);
+  last_ -= count;
+  position_ -= count;
+}
+
+bool MappedInputStream::Skip(int count) {
+  last_ = 0;
+  position_ += count;
+  if (position_ > size_) {
+    position_ = size_;
+    return false;
+  }
+  return true;
+}
+
+int64 MappedInputStream::ByteCount() const {
+  return position_;
+}
+
 FileOutputStream::FileOutputStream(const string &filename, int block_size) {
   CHECK(File::Open(filename, "w", &file_));
   size_ = block_size;
@@ -54,6 +54,34 @@ class FileInputStream : public InputStream {
   int64 position_;        // current file position
 };
 
+// Input stream for a memory-mapped file. The data blocks returned by Next()
+// point directly into the mapping, so the file contents are not copied.
+class MappedInputStream : public InputStream {
+ public:
+  // Takes ownership of memory mapped with File::Map().
+  MappedInputStream(const char *data, uint64 size, int block_size = 1 << 20);
+
+  // Unmaps file.
+  ~MappedInputStream() override;
+
+  // Maps the whole file into memory. Returns null if the file cannot be memory
+  // mapped. The file can be closed afterwards.
+  static MappedInputStream *Open(File *file, int block_size = 1 << 20);
+
+  // Implementation of InputStream interface.
+  bool Next(const void **data, int *size) override;
+  void BackUp(int count) override;
+  bool Skip(int count) override;
+  int64 ByteCount() const override;
+
+ private:
+  const char *data_;      // memory-mapped file
+  uint64 size_;           // size of file
+  int block_size_;        // maximum size of data blocks
+  int last_;              // size of last returned data block
+  uint64 position_;       // current position in file
+};
+
 // File-based output stream.
 class FileOutputStream : public OutputStream {
  public:
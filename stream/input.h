@@ -64,6 +64,17 @@ class Input {
     }
   }
 
+  // Returns the number of bytes buffered in the input and sets 'data' to point
+  // to the buffered bytes. The buffer is filled from the stream if it is empty,
+  // so this only returns zero at the end of the input. The data is not
+  // consumed, but the caller can consume the data with Skip() and keep using
+  // it until the input is read again.
+  int Peek(const char **data) {
+    if (empty()) Fill();
+    *data = current_;
+    return limit_ - current_;
+  }
+
   // Reads 'size' bytes from input and append them to the string.
   bool ReadString(int size, string *output);
 
@@ -58,6 +58,9 @@ class Output {
   // buffer.
   void Flush();
 
+  // Returns the number of bytes written to the output.
+  int64 position() const { return stream_->ByteCount() - (limit_ - current_); }
+
   // Returns the output stream.
   OutputStream *stream() { return stream_; }
 
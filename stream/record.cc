@@ -0,0 +1,276 @@
+// Copyright 2017 Google Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "stream/record.h"
+
+#include <algorithm>
+
+#include "base/logging.h"
+#include "third_party/zlib/zlib.h"
+#include "util/varint.h"
+
+namespace sling {
+
+typedef RecordFileFormat Format;
+
+RecordWriter::RecordWriter(const string &filename,
+                           const RecordFileOptions &options)
+    : options_(options) {
+  CHECK(File::Open(filename, "w", &file_));
+  WriteHeader();
+}
+
+RecordWriter::RecordWriter(File *file, const RecordFileOptions &options)
+    : file_(file), options_(options) {
+  WriteHeader();
+}
+
+RecordWriter::~RecordWriter() {
+  CHECK(Close());
+}
+
+void RecordWriter::WriteHeader() {
+  Format::FileHeader header;
+  header.magic = Format::kFileMagic;
+  header.version = Format::kVersion;
+  file_->WriteOrDie(&header, sizeof(header));
+  position_ = sizeof(header);
+  block_.reserve(options_.block_size);
+}
+
+Status RecordWriter::Write(const Slice &key, const Slice &value) {
+  DCHECK(file_ != nullptr);
+  CHECK_LE(key.size() + value.size(), kuint32max / 2);
+  Varint::Append32(&block_, key.size());
+  block_.append(key.data(), key.size());
+  Varint::Append32(&block_, value.size());
+  block_.append(value.data(), value.size());
+  records_++;
+
+  if (block_.size() >= options_.block_size) return Flush();
+  return Status::OK;
+}
+
+Status RecordWriter::Flush() {
+  if (records_ == 0) return Status::OK;
+  CHECK_LE(block_.size(), kuint32max);
+
+  // Compress block. Blocks that do not get smaller are stored as is.
+  Format::BlockHeader header;
+  header.magic = Format::kBlockMagic;
+  header.raw_size = block_.size();
+  header.records = records_;
+  header.compression = RECORD_UNCOMPRESSED;
+  const string *data = &block_;
+  if (options_.compression == RECORD_DEFLATE) {
+    uLongf size = compressBound(block_.size());
+    compressed_.resize(size);
+    int rc = compress2(reinterpret_cast<Bytef *>(&compressed_[0]), &size,
+                       reinterpret_cast<const Bytef *>(block_.data()),
+                       block_.size(), options_.compression_level);
+    if (rc != Z_OK) return Status(rc, "Block compression failed");
+    if (size < block_.size()) {
+      compressed_.resize(size);
+      header.compression = RECORD_DEFLATE;
+      data = &compressed_;
+    }
+  }
+  header.size = data->size();
+
+  // Write block and add it to the index.
+  Status st = file_->Write(&header, sizeof(header));
+  if (!st.ok()) return st;
+  st = file_->Write(data->data(), data->size());
+  if (!st.ok()) return st;
+  index_.push_back(position_);
+  position_ += sizeof(header) + data->size();
+
+  block_.clear();
+  records_ = 0;
+  return Status::OK;
+}
+
+Status RecordWriter::Close() {
+  if (file_ == nullptr) return Status::OK;
+
+  // Write last block.
+  Status st = Flush();
+  if (!st.ok()) return st;
+
+  // Write block index and footer.
+  Format::Footer footer;
+  footer.index = position_;
+  footer.blocks = index_.size();
+  footer.magic = Format::kIndexMagic;
+  if (!index_.empty()) {
+    st = file_->Write(index_.data(), index_.size() * sizeof(uint64));
+    if (!st.ok()) return st;
+  }
+  st = file_->Write(&footer, sizeof(footer));
+  if (!st.ok()) return st;
+  position_ += index_.size() * sizeof(uint64) + sizeof(footer);
+
+  st = file_->Close();
+  file_ = nullptr;
+  return st;
+}
+
+RecordReader::RecordReader(const string &filename) {
+  file_ = File::OpenOrDie(filename, "r");
+  ReadIndex();
+}
+
+RecordReader::RecordReader(File *file) : file_(file) {
+  ReadIndex();
+}
+
+RecordReader::~RecordReader() {
+  CHECK(file_->Close());
+}
+
+void RecordReader::ReadIndex() {
+  // Check file header.
+  size_ = file_->Size();
+  CHECK_GE(size_, sizeof(Format::FileHeader) + sizeof(Format::Footer))
+      << "Record file too small: " << file_->filename();
+  Format::FileHeader header;
+  uint64 read;
+  CHECK(file_->PRead(0, &header, sizeof(header), &read));
+  CHECK(header.magic == Format::kFileMagic)
+      << "Not a record file: " << file_->filename();
+  CHECK(header.version == Format::kVersion)
+      << "Unsupported record file version " << header.version;
+
+  // Read footer and block index.
+  Format::Footer footer;
+  CHECK(file_->PRead(size_ - sizeof(footer), &footer, sizeof(footer), &read));
+  CHECK(footer.magic == Format::kIndexMagic)
+      << "Record file has no index: " << file_->filename();
+  CHECK_EQ(footer.index + footer.blocks * sizeof(uint64) + sizeof(footer),
+           size_);
+  index_.resize(footer.blocks);
+  if (footer.blocks > 0) {
+    size_t bytes = footer.blocks * sizeof(uint64);
+    CHECK(file_->PRead(footer.index, index_.data(), bytes, &read));
+    CHECK_EQ(read, bytes);
+  }
+
+  // The blocks end where the block index starts.
+  size_ = footer.index;
+  end_ = index_.size();
+}
+
+void RecordReader::Seek(int64 block) {
+  DCHECK_GE(block, 0);
+  DCHECK_LE(block, index_.size());
+  current_ = block;
+  next_ = limit_ = nullptr;
+  remaining_ = 0;
+}
+
+void RecordReader::Split(int part, int parts) {
+  CHECK_GE(part, 0);
+  CHECK_LT(part, parts);
+
+  // A block belongs to the part where it starts. This keeps the parts
+  // balanced by bytes even if the blocks have different sizes.
+  uint64 first = index_.empty() ? 0 : index_[0];
+  uint64 range = size_ - first;
+  uint64 lo = first + range * part / parts;
+  uint64 hi = first + range * (part + 1) / parts;
+  begin_ = std::lower_bound(index_.begin(), index_.end(), lo) - index_.begin();
+  end_ = std::lower_bound(index_.begin(), index_.end(), hi) - index_.begin();
+  if (part == parts - 1) end_ = index_.size();
+  Seek(begin_);
+}
+
+bool RecordReader::Done() {
+  return remaining_ == 0 && current_ >= end_;
+}
+
+bool RecordReader::NextBlock() {
+  // Read block header.
+  uint64 offset = index_[current_++];
+  Format::BlockHeader header;
+  uint64 read;
+  status_ = file_->PRead(offset, &header, sizeof(header), &read);
+  if (!status_.ok()) return false;
+  if (read != sizeof(header) || header.magic != Format::kBlockMagic) {
+    status_ = Status(1, "Corrupt record block in", file_->filename());
+    return false;
+  }
+
+  // Read block data.
+  buffer_.resize(header.size);
+  status_ = file_->PRead(offset + sizeof(header), &buffer_[0], header.size,
+                         &read);
+  if (!status_.ok()) return false;
+  if (read != header.size) {
+    status_ = Status(1, "Truncated record block in", file_->filename());
+    return false;
+  }
+
+  // Decompress block.
+  const string *data = &buffer_;
+  if (header.compression == RECORD_DEFLATE) {
+    block_.resize(header.raw_size);
+    uLongf size = header.raw_size;
+    int rc = uncompress(reinterpret_cast<Bytef *>(&block_[0]), &size,
+                        reinterpret_cast<const Bytef *>(buffer_.data()),
+                        buffer_.size());
+    if (rc != Z_OK || size != header.raw_size) {
+      status_ = Status(rc == Z_OK ? 1 : rc, "Block decompression failed for",
+                       file_->filename());
+      return false;
+    }
+    data = &block_;
+  } else if (header.compression != RECORD_UNCOMPRESSED) {
+    status_ = Status(1, "Unknown block compression in", file_->filename());
+    return false;
+  }
+
+  next_ = data->data();
+  limit_ = next_ + data->size();
+  remaining_ = header.records;
+  return true;
+}
+
+bool RecordReader::Read(Record *record) {
+  // Move to next non-empty block.
+  while (remaining_ == 0) {
+    if (current_ >= end_) return false;
+    if (!NextBlock()) return false;
+  }
+
+  // Decode next record from block.
+  uint32 size;
+  const char *p = Varint::Parse32WithLimit(next_, limit_, &size);
+  if (p == nullptr || size > limit_ - p) return Corrupt();
+  record->key = Slice(p, size);
+  p += size;
+  p = Varint::Parse32WithLimit(p, limit_, &size);
+  if (p == nullptr || size > limit_ - p) return Corrupt();
+  record->value = Slice(p, size);
+  next_ = p + size;
+  remaining_--;
+  return true;
+}
+
+bool RecordReader::Corrupt() {
+  status_ = Status(1, "Corrupt record in", file_->filename());
+  remaining_ = 0;
+  return false;
+}
+
+}  // namespace sling
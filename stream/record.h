@@ -0,0 +1,234 @@
+// Copyright 2017 Google Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef STREAM_RECORD_H_
+#define STREAM_RECORD_H_
+
+#include <string>
+#include <vector>
+
+#include "base/port.h"
+#include "base/slice.h"
+#include "base/status.h"
+#include "base/types.h"
+#include "file/file.h"
+
+namespace sling {
+
+// A record file is a sequence of key/value records grouped into blocks,
+// followed by an index of block offsets:
+//
+//   <file header>
+//   <block header> <records> ... <block header> <records>
+//   <block offsets> <footer>
+//
+// Each record in a block is encoded as a varint key length, the key, a varint
+// value length, and the value. The records in a block can optionally be
+// compressed. Since each block can be decoded independently, readers can seek
+// to any block and a file can be split into contiguous block ranges that are
+// read in parallel.
+
+// Key/value record. The key and value point into the reader buffer and are
+// only valid until the next read.
+struct Record {
+  Slice key;
+  Slice value;
+};
+
+// Block compression codecs.
+enum RecordCompression {
+  RECORD_UNCOMPRESSED = 0,
+  RECORD_DEFLATE = 1,
+};
+
+// Options for writing record files.
+struct RecordFileOptions {
+  // Number of bytes of records in each block before it is flushed.
+  int block_size = 1 << 20;
+
+  // Compression codec for blocks. Blocks that do not shrink when compressed
+  // are stored uncompressed.
+  RecordCompression compression = RECORD_DEFLATE;
+
+  // Compression level for deflate.
+  int compression_level = 6;
+};
+
+// On-disk layout of record files.
+struct RecordFileFormat {
+  static const uint32 kFileMagic = 0x43455253;    // "SREC"
+  static const uint32 kBlockMagic = 0x4b4c4253;   // "SBLK"
+  static const uint32 kIndexMagic = 0x58444e49;   // "INDX"
+  static const uint32 kVersion = 1;
+
+  // File header at the start of the file.
+  struct FileHeader {
+    uint32 magic;        // file magic number
+    uint32 version;      // file format version
+  } PACKED;
+
+  // Block header in front of the records in each block.
+  struct BlockHeader {
+    uint32 magic;        // block magic number
+    uint32 size;         // number of bytes stored in block
+    uint32 raw_size;     // number of bytes after decompression
+    uint32 records;      // number of records in block
+    uint32 compression;  // compression codec for block
+  } PACKED;
+
+  // Footer at the end of the file after the block index.
+  struct Footer {
+    uint64 index;        // file offset of block index
+    uint64 blocks;       // number of blocks in file
+    uint32 magic;        // index magic number
+  } PACKED;
+};
+
+// Writer for record files.
+class RecordWriter {
+ public:
+  // Opens record file for writing.
+  explicit RecordWriter(const string &filename,
+                        const RecordFileOptions &options = RecordFileOptions());
+
+  // Takes ownership of an existing file opened for writing.
+  explicit RecordWriter(File *file,
+                        const RecordFileOptions &options = RecordFileOptions());
+
+  // Closes the file.
+  ~RecordWriter();
+
+  // Adds record to the file.
+  Status Write(const Slice &key, const Slice &value);
+
+  // Adds record without key to the file.
+  Status Write(const Slice &value) { return Write(Slice(), value); }
+
+  // Writes out the current block. The next record starts a new block.
+  Status Flush();
+
+  // Flushes the last block, writes the block index, and closes the file.
+  Status Close();
+
+  // Number of blocks written so far.
+  int64 num_blocks() const { return index_.size(); }
+
+ private:
+  // Writes file header.
+  void WriteHeader();
+
+  // Underlying file, or null if the writer has been closed.
+  File *file_;
+
+  // Writer options.
+  RecordFileOptions options_;
+
+  // Records in the current block.
+  string block_;
+  uint32 records_ = 0;
+
+  // Compression buffer.
+  string compressed_;
+
+  // Current file position.
+  uint64 position_ = 0;
+
+  // File offsets of all blocks written.
+  std::vector<uint64> index_;
+};
+
+// Reader for record files. A reader can be restricted to a contiguous range of
+// blocks so that several readers can process parts of the same file in
+// parallel. Each reader has its own file handle.
+class RecordReader {
+ public:
+  // Opens record file for reading.
+  explicit RecordReader(const string &filename);
+
+  // Takes ownership of an existing file opened for reading.
+  explicit RecordReader(File *file);
+
+  // Closes the file.
+  ~RecordReader();
+
+  // Reads the next record. Returns false at the end of the range or on errors.
+  bool Read(Record *record);
+
+  // Returns true if there are no more records in the range.
+  bool Done();
+
+  // Positions the reader at the start of a block.
+  void Seek(int64 block);
+
+  // Restricts the reader to part number 'part' out of 'parts' parts of the
+  // file and seeks to the start of the part. The file is partitioned into
+  // contiguous block ranges of roughly the same number of bytes.
+  void Split(int part, int parts);
+
+  // Seeks to the start of the current range.
+  void Rewind() { Seek(begin_); }
+
+  // Number of blocks in the file.
+  int64 num_blocks() const { return index_.size(); }
+
+  // File offset of a block.
+  uint64 block_offset(int64 block) const { return index_[block]; }
+
+  // Current block range.
+  int64 begin() const { return begin_; }
+  int64 end() const { return end_; }
+
+  // Status of the last failed read.
+  const Status &status() const { return status_; }
+
+ private:
+  // Reads block index from end of file.
+  void ReadIndex();
+
+  // Reads and decompresses the next block in the range.
+  bool NextBlock();
+
+  // Marks the current block as corrupt and returns false.
+  bool Corrupt();
+
+  // Underlying file.
+  File *file_;
+
+  // Size of the file.
+  uint64 size_;
+
+  // File offsets of all blocks in the file.
+  std::vector<uint64> index_;
+
+  // Block range for reader.
+  int64 begin_ = 0;
+  int64 end_ = 0;
+
+  // Next block to read.
+  int64 current_ = 0;
+
+  // Records in the current block.
+  string buffer_;
+  string block_;
+  const char *next_ = nullptr;
+  const char *limit_ = nullptr;
+  uint32 remaining_ = 0;
+
+  // Status of last failed read.
+  Status status_;
+};
+
+}  // namespace sling
+
+#endif  // STREAM_RECORD_H_
@@ -0,0 +1,188 @@
+// Copyright 2017 Google Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "base/flags.h"
+#include "base/init.h"
+#include "base/logging.h"
+#include "base/types.h"
+#include "file/file.h"
+#include "stream/record.h"
+#include "string/strcat.h"
+
+DEFINE_string(scratch, "/tmp/record-test.rec", "Scratch record file");
+
+using namespace sling;
+
+// Returns the key for record number i.
+static string Key(int i) {
+  return StrCat("key", i);
+}
+
+// Returns the value for record number i. Values are either repetitive, so
+// they compress well, or pseudo-random, so deflate does not shrink them.
+static string Value(int i, bool random) {
+  string value;
+  uint32 seed = i * 2654435761u + 1;
+  for (int j = 0; j < 100 + i % 50; ++j) {
+    if (random) {
+      seed = seed * 1103515245 + 12345;
+      value.push_back(seed >> 24);
+    } else {
+      value.push_back('a' + (i + j / 10) % 26);
+    }
+  }
+  return value;
+}
+
+// Writes records to the scratch file with a new block after every 'block'
+// records.
+static void WriteFile(int n, int block, bool random,
+                      const RecordFileOptions &options) {
+  RecordWriter writer(FLAGS_scratch, options);
+  for (int i = 0; i < n; ++i) {
+    CHECK(writer.Write(Key(i), Value(i, random)));
+    if (block > 0 && (i + 1) % block == 0) CHECK(writer.Flush());
+  }
+  CHECK(writer.Close());
+}
+
+// Reads back all records from the scratch file and checks their contents.
+static void CheckFile(int n, bool random) {
+  RecordReader reader(FLAGS_scratch);
+  Record record;
+  int count = 0;
+  while (reader.Read(&record)) {
+    CHECK_EQ(record.key.str(), Key(count));
+    CHECK_EQ(record.value.str(), Value(count, random));
+    count++;
+  }
+  CHECK(reader.status());
+  CHECK(reader.Done());
+  CHECK_EQ(count, n);
+
+  // Rewinding restarts from the first record.
+  reader.Rewind();
+  CHECK(reader.Read(&record) == (n > 0));
+  if (n > 0) CHECK_EQ(record.key.str(), Key(0));
+}
+
+// Checks writing and reading records with and without compression.
+static void TestReadWrite() {
+  RecordFileOptions deflate;
+  deflate.compression = RECORD_DEFLATE;
+  RecordFileOptions raw;
+  raw.compression = RECORD_UNCOMPRESSED;
+
+  // Compressible records in deflated blocks.
+  WriteFile(1000, 100, false, deflate);
+  CheckFile(1000, false);
+
+  // Uncompressed blocks.
+  WriteFile(1000, 100, false, raw);
+  CheckFile(1000, false);
+
+  // Incompressible records are stored in raw blocks even with deflate.
+  WriteFile(1000, 100, true, deflate);
+  CheckFile(1000, true);
+
+  // Blocks flushed by block size.
+  RecordFileOptions small = deflate;
+  small.block_size = 1000;
+  WriteFile(1000, 0, false, small);
+  CheckFile(1000, false);
+  RecordReader reader(FLAGS_scratch);
+  CHECK_GT(reader.num_blocks(), 50);
+
+  // Records without keys.
+  {
+    RecordWriter writer(FLAGS_scratch);
+    CHECK(writer.Write("hello"));
+    CHECK(writer.Write(""));
+  }
+  RecordReader unkeyed(FLAGS_scratch);
+  Record record;
+  CHECK(unkeyed.Read(&record));
+  CHECK(record.key.empty());
+  CHECK_EQ(record.value.str(), "hello");
+  CHECK(unkeyed.Read(&record));
+  CHECK(record.value.empty());
+  CHECK(!unkeyed.Read(&record));
+  CHECK(unkeyed.status());
+}
+
+// Checks that empty record files can be written, read and split.
+static void TestEmptyFile() {
+  WriteFile(0, 0, false, RecordFileOptions());
+  RecordReader reader(FLAGS_scratch);
+  CHECK_EQ(reader.num_blocks(), 0);
+  CHECK(reader.Done());
+  Record record;
+  CHECK(!reader.Read(&record));
+  CHECK(reader.status());
+  for (int parts = 1; parts <= 3; ++parts) {
+    for (int part = 0; part < parts; ++part) {
+      reader.Split(part, parts);
+      CHECK(!reader.Read(&record));
+    }
+  }
+}
+
+// Checks that splitting a file into parts reads every record exactly once.
+static void TestSplit() {
+  const int n = 1000;
+  RecordFileOptions options;
+  options.block_size = 2000;
+  WriteFile(n, 0, true, options);
+
+  RecordReader reader(FLAGS_scratch);
+  CHECK_GT(reader.num_blocks(), 7);
+  for (int parts = 1; parts <= 7; ++parts) {
+    std::vector<int> seen(n);
+    int64 next = 0;
+    for (int part = 0; part < parts; ++part) {
+      // Parts are consecutive block ranges.
+      reader.Split(part, parts);
+      CHECK_EQ(reader.begin(), next);
+      next = reader.end();
+
+      Record record;
+      while (reader.Read(&record)) {
+        int i = std::stoi(record.key.str().substr(3));
+        CHECK_GE(i, 0);
+        CHECK_LT(i, n);
+        CHECK_EQ(record.value.str(), Value(i, true));
+        seen[i]++;
+      }
+      CHECK(reader.status());
+    }
+    CHECK_EQ(next, reader.num_blocks());
+    for (int i = 0; i < n; ++i) CHECK_EQ(seen[i], 1) << i << "/" << parts;
+  }
+}
+
+int main(int argc, char **argv) {
+  InitProgram(&argc, &argv);
+
+  TestReadWrite();
+  TestEmptyFile();
+  TestSplit();
+  CHECK(File::Delete(FLAGS_scratch));
+
+  std::cout << "PASS\n";
+  return 0;
+}
@@ -29,6 +29,7 @@
 #include <memory>
 #include <string>
 
+#include "base/bitcast.h"
 #include "base/types.h"
 #include "base/logging.h"
 #include "base/strtoint.h"
@@ -578,13 +579,276 @@ bool safe_strtod(const char *str, double *value) {
 }
 
 bool safe_strtof(const string &str, float *value) {
-  return safe_strtof(str.c_str(), value);
+  return safe_strtof(str.data(), str.size(), value);
 }
 
 bool safe_strtod(const string &str, double *value) {
   return safe_strtod(str.c_str(), value);
 }
 
+// ----------------------------------------------------------------------
+// safe_strtof(str, size, value)
+//    Converts decimal numbers to the nearest float with the algorithm by
+//    Eisel and Lemire ("Number Parsing at a Gigabyte per Second", 2021).
+//    The significand is read into a 64-bit integer w and the number is
+//    w * 10^q. This is multiplied by a 128-bit approximation of 5^q,
+//    which gives enough bits to round correctly to a float for all w with
+//    at most 19 digits. Numbers with more digits and non-decimal inputs
+//    like "inf" or hexadecimal floats are converted with strtof().
+// ----------------------------------------------------------------------
+
+// Range of powers of ten that can give finite non-zero floats for a 64-bit
+// significand.
+static const int kSmallestFloatPowerOfTen = -65;
+static const int kLargestFloatPowerOfTen = 38;
+
+// Powers of five normalized to 128 bits for q in [-65, 38]. Positive powers
+// are truncated and negative powers are rounded up.
+static const uint64 kPowerOfFive128[][2] = {
+  {0x86ccbb52ea94baeaULL, 0x98e947129fc2b4e9ULL},  // 1e-65
+  {0xa87fea27a539e9a5ULL, 0x3f2398d747b36224ULL},  // 1e-64
+  {0xd29fe4b18e88640eULL, 0x8eec7f0d19a03aadULL},  // 1e-63
+  {0x83a3eeeef9153e89ULL, 0x1953cf68300424acULL},  // 1e-62
+  {0xa48ceaaab75a8e2bULL, 0x5fa8c3423c052dd7ULL},  // 1e-61
+  {0xcdb02555653131b6ULL, 0x3792f412cb06794dULL},  // 1e-60
+  {0x808e17555f3ebf11ULL, 0xe2bbd88bbee40bd0ULL},  // 1e-59
+  {0xa0b19d2ab70e6ed6ULL, 0x5b6aceaeae9d0ec4ULL},  // 1e-58
+  {0xc8de047564d20a8bULL, 0xf245825a5a445275ULL},  // 1e-57
+  {0xfb158592be068d2eULL, 0xeed6e2f0f0d56712ULL},  // 1e-56
+  {0x9ced737bb6c4183dULL, 0x55464dd69685606bULL},  // 1e-55
+  {0xc428d05aa4751e4cULL, 0xaa97e14c3c26b886ULL},  // 1e-54
+  {0xf53304714d9265dfULL, 0xd53dd99f4b3066a8ULL},  // 1e-53
+  {0x993fe2c6d07b7fabULL, 0xe546a8038efe4029ULL},  // 1e-52
+  {0xbf8fdb78849a5f96ULL, 0xde98520472bdd033ULL},  // 1e-51
+  {0xef73d256a5c0f77cULL, 0x963e66858f6d4440ULL},  // 1e-50
+  {0x95a8637627989aadULL, 0xdde7001379a44aa8ULL},  // 1e-49
+  {0xbb127c53b17ec159ULL, 0x5560c018580d5d52ULL},  // 1e-48
+  {0xe9d71b689dde71afULL, 0xaab8f01e6e10b4a6ULL},  // 1e-47
+  {0x9226712162ab070dULL, 0xcab3961304ca70e8ULL},  // 1e-46
+  {0xb6b00d69bb55c8d1ULL, 0x3d607b97c5fd0d22ULL},  // 1e-45
+  {0xe45c10c42a2b3b05ULL, 0x8cb89a7db77c506aULL},  // 1e-44
+  {0x8eb98a7a9a5b04e3ULL, 0x77f3608e92adb242ULL},  // 1e-43
+  {0xb267ed1940f1c61cULL, 0x55f038b237591ed3ULL},  // 1e-42
+  {0xdf01e85f912e37a3ULL, 0x6b6c46dec52f6688ULL},  // 1e-41
+  {0x8b61313bbabce2c6ULL, 0x2323ac4b3b3da015ULL},  // 1e-40
+  {0xae397d8aa96c1b77ULL, 0xabec975e0a0d081aULL},  // 1e-39
+  {0xd9c7dced53c72255ULL, 0x96e7bd358c904a21ULL},  // 1e-38
+  {0x881cea14545c7575ULL, 0x7e50d64177da2e54ULL},  // 1e-37
+  {0xaa242499697392d2ULL, 0xdde50bd1d5d0b9e9ULL},  // 1e-36
+  {0xd4ad2dbfc3d07787ULL, 0x955e4ec64b44e864ULL},  // 1e-35
+  {0x84ec3c97da624ab4ULL, 0xbd5af13bef0b113eULL},  // 1e-34
+  {0xa6274bbdd0fadd61ULL, 0xecb1ad8aeacdd58eULL},  // 1e-33
+  {0xcfb11ead453994baULL, 0x67de18eda5814af2ULL},  // 1e-32
+  {0x81ceb32c4b43fcf4ULL, 0x80eacf948770ced7ULL},  // 1e-31
+  {0xa2425ff75e14fc31ULL, 0xa1258379a94d028dULL},  // 1e-30
+  {0xcad2f7f5359a3b3eULL, 0x096ee45813a04330ULL},  // 1e-29
+  {0xfd87b5f28300ca0dULL, 0x8bca9d6e188853fcULL},  // 1e-28
+  {0x9e74d1b791e07e48ULL, 0x775ea264cf55347eULL},  // 1e-27
+  {0xc612062576589ddaULL, 0x95364afe032a819eULL},  // 1e-26
+  {0xf79687aed3eec551ULL, 0x3a83ddbd83f52205ULL},  // 1e-25
+  {0x9abe14cd44753b52ULL, 0xc4926a9672793543ULL},  // 1e-24
+  {0xc16d9a0095928a27ULL, 0x75b7053c0f178294ULL},  // 1e-23
+  {0xf1c90080baf72cb1ULL, 0x5324c68b12dd6339ULL},  // 1e-22
+  {0x971da05074da7beeULL, 0xd3f6fc16ebca5e04ULL},  // 1e-21
+  {0xbce5086492111aeaULL, 0x88f4bb1ca6bcf585ULL},  // 1e-20
+  {0xec1e4a7db69561a5ULL, 0x2b31e9e3d06c32e6ULL},  // 1e-19
+  {0x9392ee8e921d5d07ULL, 0x3aff322e62439fd0ULL},  // 1e-18
+  {0xb877aa3236a4b449ULL, 0x09befeb9fad487c3ULL},  // 1e-17
+  {0xe69594bec44de15bULL, 0x4c2ebe687989a9b4ULL},  // 1e-16
+  {0x901d7cf73ab0acd9ULL, 0x0f9d37014bf60a11ULL},  // 1e-15
+  {0xb424dc35095cd80fULL, 0x538484c19ef38c95ULL},  // 1e-14
+  {0xe12e13424bb40e13ULL, 0x2865a5f206b06fbaULL},  // 1e-13
+  {0x8cbccc096f5088cbULL, 0xf93f87b7442e45d4ULL},  // 1e-12
+  {0xafebff0bcb24aafeULL, 0xf78f69a51539d749ULL},  // 1e-11
+  {0xdbe6fecebdedd5beULL, 0xb573440e5a884d1cULL},  // 1e-10
+  {0x89705f4136b4a597ULL, 0x31680a88f8953031ULL},  // 1e-9
+  {0xabcc77118461cefcULL, 0xfdc20d2b36ba7c3eULL},  // 1e-8
+  {0xd6bf94d5e57a42bcULL, 0x3d32907604691b4dULL},  // 1e-7
+  {0x8637bd05af6c69b5ULL, 0xa63f9a49c2c1b110ULL},  // 1e-6
+  {0xa7c5ac471b478423ULL, 0x0fcf80dc33721d54ULL},  // 1e-5
+  {0xd1b71758e219652bULL, 0xd3c36113404ea4a9ULL},  // 1e-4
+  {0x83126e978d4fdf3bULL, 0x645a1cac083126eaULL},  // 1e-3
+  {0xa3d70a3d70a3d70aULL, 0x3d70a3d70a3d70a4ULL},  // 1e-2
+  {0xccccccccccccccccULL, 0xcccccccccccccccdULL},  // 1e-1
+  {0x8000000000000000ULL, 0x0000000000000000ULL},  // 1e0
+  {0xa000000000000000ULL, 0x0000000000000000ULL},  // 1e1
+  {0xc800000000000000ULL, 0x0000000000000000ULL},  // 1e2
+  {0xfa00000000000000ULL, 0x0000000000000000ULL},  // 1e3
+  {0x9c40000000000000ULL, 0x0000000000000000ULL},  // 1e4
+  {0xc350000000000000ULL, 0x0000000000000000ULL},  // 1e5
+  {0xf424000000000000ULL, 0x0000000000000000ULL},  // 1e6
+  {0x9896800000000000ULL, 0x0000000000000000ULL},  // 1e7
+  {0xbebc200000000000ULL, 0x0000000000000000ULL},  // 1e8
+  {0xee6b280000000000ULL, 0x0000000000000000ULL},  // 1e9
+  {0x9502f90000000000ULL, 0x0000000000000000ULL},  // 1e10
+  {0xba43b74000000000ULL, 0x0000000000000000ULL},  // 1e11
+  {0xe8d4a51000000000ULL, 0x0000000000000000ULL},  // 1e12
+  {0x9184e72a00000000ULL, 0x0000000000000000ULL},  // 1e13
+  {0xb5e620f480000000ULL, 0x0000000000000000ULL},  // 1e14
+  {0xe35fa931a0000000ULL, 0x0000000000000000ULL},  // 1e15
+  {0x8e1bc9bf04000000ULL, 0x0000000000000000ULL},  // 1e16
+  {0xb1a2bc2ec5000000ULL, 0x0000000000000000ULL},  // 1e17
+  {0xde0b6b3a76400000ULL, 0x0000000000000000ULL},  // 1e18
+  {0x8ac7230489e80000ULL, 0x0000000000000000ULL},  // 1e19
+  {0xad78ebc5ac620000ULL, 0x0000000000000000ULL},  // 1e20
+  {0xd8d726b7177a8000ULL, 0x0000000000000000ULL},  // 1e21
+  {0x878678326eac9000ULL, 0x0000000000000000ULL},  // 1e22
+  {0xa968163f0a57b400ULL, 0x0000000000000000ULL},  // 1e23
+  {0xd3c21bcecceda100ULL, 0x0000000000000000ULL},  // 1e24
+  {0x84595161401484a0ULL, 0x0000000000000000ULL},  // 1e25
+  {0xa56fa5b99019a5c8ULL, 0x0000000000000000ULL},  // 1e26
+  {0xcecb8f27f4200f3aULL, 0x0000000000000000ULL},  // 1e27
+  {0x813f3978f8940984ULL, 0x4000000000000000ULL},  // 1e28
+  {0xa18f07d736b90be5ULL, 0x5000000000000000ULL},  // 1e29
+  {0xc9f2c9cd04674edeULL, 0xa400000000000000ULL},  // 1e30
+  {0xfc6f7c4045812296ULL, 0x4d00000000000000ULL},  // 1e31
+  {0x9dc5ada82b70b59dULL, 0xf020000000000000ULL},  // 1e32
+  {0xc5371912364ce305ULL, 0x6c28000000000000ULL},  // 1e33
+  {0xf684df56c3e01bc6ULL, 0xc732000000000000ULL},  // 1e34
+  {0x9a130b963a6c115cULL, 0x3c7f400000000000ULL},  // 1e35
+  {0xc097ce7bc90715b3ULL, 0x4b9f100000000000ULL},  // 1e36
+  {0xf0bdc21abb48db20ULL, 0x1e86d40000000000ULL},  // 1e37
+  {0x96769950b50d88f4ULL, 0x1314448000000000ULL},  // 1e38
+};
+
+// Returns w * 10^q rounded to the nearest float, where w must be non-zero.
+static float ComputeFloat(uint64 w, int q, bool negative) {
+  const int kMantissaBits = 23;
+  const int kMinimumExponent = -127;
+  const int kInfinitePower = 0xFF;
+  uint32 bits = negative ? 0x80000000 : 0;
+  if (q < kSmallestFloatPowerOfTen) return bit_cast<float>(bits);
+  if (q > kLargestFloatPowerOfTen) {
+    return bit_cast<float>(bits | (kInfinitePower << kMantissaBits));
+  }
+
+  // Compute the product of the normalized significand and the power of five.
+  // Only the high 64 bits are needed unless the bits below the mantissa are
+  // all ones, in which case the product is refined with the low 64 bits of
+  // the power of five.
+  int lz = __builtin_clzll(w);
+  w <<= lz;
+  const uint64 *power = kPowerOfFive128[q - kSmallestFloatPowerOfTen];
+  unsigned __int128 first = static_cast<unsigned __int128>(w) * power[0];
+  uint64 high = first >> 64;
+  uint64 low = first;
+  const uint64 kPrecisionMask = 0xFFFFFFFFFFFFFFFFULL >> (kMantissaBits + 3);
+  if ((high & kPrecisionMask) == kPrecisionMask) {
+    unsigned __int128 second = static_cast<unsigned __int128>(w) * power[1];
+    uint64 carry = second >> 64;
+    low += carry;
+    if (carry > low) high++;
+  }
+
+  // Extract mantissa with one extra bit for rounding. The binary exponent is
+  // floor(log2(10^q)) which is computed as (217706 * q) >> 16.
+  int upperbit = high >> 63;
+  int shift = upperbit + 64 - kMantissaBits - 3;
+  uint64 mantissa = high >> shift;
+  int power2 = ((217706 * q) >> 16) + 63 + upperbit - lz - kMinimumExponent;
+
+  if (power2 <= 0) {
+    // Subnormal numbers are shifted into place and rounded. Rounding can
+    // turn the number into the smallest normal number.
+    if (-power2 + 1 >= 64) return bit_cast<float>(bits);
+    mantissa >>= -power2 + 1;
+    mantissa += mantissa & 1;
+    mantissa >>= 1;
+    power2 = mantissa < (1ULL << kMantissaBits) ? 0 : 1;
+    return bit_cast<float>(bits | (power2 << kMantissaBits) |
+                           static_cast<uint32>(mantissa));
+  }
+
+  // Numbers exactly halfway between two floats are rounded to even. This can
+  // only happen when 5^q is exact, i.e. for small powers of ten.
+  if (low <= 1 && q >= -17 && q <= 10 && (mantissa & 3) == 1 &&
+      (mantissa << shift) == high) {
+    mantissa &= ~1ULL;
+  }
+
+  // Round to nearest and renormalize if rounding overflows the mantissa.
+  mantissa += mantissa & 1;
+  mantissa >>= 1;
+  if (mantissa >= (2ULL << kMantissaBits)) {
+    mantissa = 1ULL << kMantissaBits;
+    power2++;
+  }
+  mantissa &= ~(1ULL << kMantissaBits);
+  if (power2 >= kInfinitePower) {
+    return bit_cast<float>(bits | (kInfinitePower << kMantissaBits));
+  }
+  return bit_cast<float>(bits | (power2 << kMantissaBits) |
+                         static_cast<uint32>(mantissa));
+}
+
+bool safe_strtof(const char *str, int size, float *value) {
+  const char *p = str;
+  const char *end = str + size;
+
+  // Parse sign.
+  bool negative = false;
+  if (p < end && (*p == '-' || *p == '+')) {
+    negative = *p == '-';
+    p++;
+  }
+
+  // Parse significand into w and count the significant digits.
+  uint64 w = 0;
+  int digits = 0;
+  int exponent = 0;
+  const char *start = p;
+  while (p < end && ascii_isdigit(*p)) {
+    if (w != 0 || *p != '0') {
+      if (++digits > 19) goto fallback;
+      w = w * 10 + (*p - '0');
+    }
+    p++;
+  }
+  if (p < end && *p == '.') {
+    p++;
+    while (p < end && ascii_isdigit(*p)) {
+      if (w != 0 || *p != '0') {
+        if (++digits > 19) goto fallback;
+        w = w * 10 + (*p - '0');
+      }
+      exponent--;
+      p++;
+    }
+    if (p == start + 1) goto fallback;
+  } else if (p == start) {
+    goto fallback;
+  }
+
+  // Parse exponent.
+  if (p < end && (*p == 'e' || *p == 'E')) {
+    p++;
+    bool negative_exponent = false;
+    if (p < end && (*p == '-' || *p == '+')) {
+      negative_exponent = *p == '-';
+      p++;
+    }
+    const char *exponent_start = p;
+    int e = 0;
+    while (p < end && ascii_isdigit(*p)) {
+      if (e < 10000) e = e * 10 + (*p - '0');
+      p++;
+    }
+    if (p == exponent_start) goto fallback;
+    exponent += negative_exponent ? -e : e;
+  }
+  if (p != end) goto fallback;
+
+  if (w == 0) {
+    *value = negative ? -0.0f : 0.0f;
+  } else {
+    *value = ComputeFloat(w, exponent, negative);
+  }
+  return true;
+
+fallback:
+  return safe_strtof(string(str, size).c_str(), value);
+}
+
 uint64 atoi_kmgt(const char *s) {
   char *endptr;
   uint64 n = strtou64(s, &endptr, 10);
@@ -989,6 +1253,307 @@ bool StrictAutoDigitLessThan(const char *a, int alen,
   return AutoDigitStrCmp(a, alen, b, blen, true) < 0;
 }
 
+// ----------------------------------------------------------------------
+// FastFloatToBufferLeft()
+//    Converts floats to the shortest decimal representation that parses
+//    back to the same float with the Ryu algorithm by Ulf Adams ("Ryu: Fast
+//    Float-to-String Conversion", PLDI 2018). The interval of decimal
+//    numbers that round to the float is computed from the binary mantissa
+//    and exponent with a single fixed-point multiplication by a power of
+//    five, and digits are removed from the bounds of the interval until it
+//    does not contain any shorter decimal numbers. If there are several
+//    shortest numbers in the interval, the one closest to the float is used.
+// ----------------------------------------------------------------------
+
+// Number of bits in the powers of five and their inverses.
+static const int kFloatPow5InvBitCount = 59;
+static const int kFloatPow5BitCount = 61;
+
+// Inverse powers of five, i.e. floor(2^(pow5bits(i) - 1 + 59) / 5^i) + 1.
+static const uint64 kFloatPow5InvSplit[31] = {
+  0x0800000000000001ULL, 0x0666666666666667ULL, 0x051eb851eb851eb9ULL,
+  0x04189374bc6a7efaULL, 0x068db8bac710cb2aULL, 0x053e2d6238da3c22ULL,
+  0x0431bde82d7b634eULL, 0x06b5fca6af2bd216ULL, 0x055e63b88c230e78ULL,
+  0x044b82fa09b5a52dULL, 0x06df37f675ef6eaeULL, 0x057f5ff85e592558ULL,
+  0x0465e6604b7a8447ULL, 0x0709709a125da071ULL, 0x05a126e1a84ae6c1ULL,
+  0x0480ebe7b9d58567ULL, 0x0734aca5f6226f0bULL, 0x05c3bd5191b525a3ULL,
+  0x049c97747490eae9ULL, 0x0760f253edb4ab0eULL, 0x05e72843249088d8ULL,
+  0x04b8ed0283a6d3e0ULL, 0x078e480405d7b966ULL, 0x060b6cd004ac9452ULL,
+  0x04d5f0a66a23a9dbULL, 0x07bcb43d769f762bULL, 0x063090312bb2c4efULL,
+  0x04f3a68dbc8f03f3ULL, 0x07ec3daf94180651ULL, 0x065697bfa9acd1daULL,
+  0x051212ffbaf0a7e2ULL,
+};
+
+// Powers of five truncated to 61 bits, i.e. floor(5^i / 2^(pow5bits(i) - 61)).
+static const uint64 kFloatPow5Split[47] = {
+  0x1000000000000000ULL, 0x1400000000000000ULL, 0x1900000000000000ULL,
+  0x1f40000000000000ULL, 0x1388000000000000ULL, 0x186a000000000000ULL,
+  0x1e84800000000000ULL, 0x1312d00000000000ULL, 0x17d7840000000000ULL,
+  0x1dcd650000000000ULL, 0x12a05f2000000000ULL, 0x174876e800000000ULL,
+  0x1d1a94a200000000ULL, 0x12309ce540000000ULL, 0x16bcc41e90000000ULL,
+  0x1c6bf52634000000ULL, 0x11c37937e0800000ULL, 0x16345785d8a00000ULL,
+  0x1bc16d674ec80000ULL, 0x1158e460913d0000ULL, 0x15af1d78b58c4000ULL,
+  0x1b1ae4d6e2ef5000ULL, 0x10f0cf064dd59200ULL, 0x152d02c7e14af680ULL,
+  0x1a784379d99db420ULL, 0x108b2a2c28029094ULL, 0x14adf4b7320334b9ULL,
+  0x19d971e4fe8401e7ULL, 0x1027e72f1f128130ULL, 0x1431e0fae6d7217cULL,
+  0x193e5939a08ce9dbULL, 0x1f8def8808b02452ULL, 0x13b8b5b5056e16b3ULL,
+  0x18a6e32246c99c60ULL, 0x1ed09bead87c0378ULL, 0x13426172c74d822bULL,
+  0x1812f9cf7920e2b6ULL, 0x1e17b84357691b64ULL, 0x12ced32a16a1b11eULL,
+  0x178287f49c4a1d66ULL, 0x1d6329f1c35ca4bfULL, 0x125dfa371a19e6f7ULL,
+  0x16f578c4e0a060b5ULL, 0x1cb2d6f618c878e3ULL, 0x11efc659cf7d4b8dULL,
+  0x166bb7f0435c9e71ULL, 0x1c06a5ec5433c60dULL,
+};
+
+// Returns ceil(log2(5^e)) for e > 0 and one for e = 0.
+static inline int Pow5Bits(int e) {
+  return ((e * 1217359) >> 19) + 1;
+}
+
+// Returns floor(log10(2^e)) for e >= 0.
+static inline int Log10Pow2(int e) {
+  return (e * 78913) >> 18;
+}
+
+// Returns floor(log10(5^e)) for e >= 0.
+static inline int Log10Pow5(int e) {
+  return (e * 732923) >> 20;
+}
+
+// Returns true if value is divisible by 5^p.
+static inline bool MultipleOfPowerOf5(uint32 value, int p) {
+  int count = 0;
+  while (value % 5 == 0) {
+    value /= 5;
+    count++;
+  }
+  return count >= p;
+}
+
+// Returns true if value is divisible by 2^p.
+static inline bool MultipleOfPowerOf2(uint32 value, int p) {
+  return (value & ((1u << p) - 1)) == 0;
+}
+
+// Returns (m * factor) >> shift, where shift must be larger than 32.
+static inline uint32 MulShift32(uint32 m, uint64 factor, int shift) {
+  uint64 low = static_cast<uint64>(m) * static_cast<uint32>(factor);
+  uint64 high = static_cast<uint64>(m) * (factor >> 32);
+  return ((low >> 32) + high) >> (shift - 32);
+}
+
+// Computes the shortest decimal representation of a positive finite float,
+// i.e. the float is equal to digits * 10^exponent after rounding.
+static void ShortestFloat(uint32 bits, uint32 *digits, int *exponent) {
+  const int kMantissaBits = 23;
+  const int kExponentBias = 127;
+  uint32 ieee_mantissa = bits & ((1u << kMantissaBits) - 1);
+  uint32 ieee_exponent = bits >> kMantissaBits;
+
+  // Decode float into m2 * 2^e2. Two extra bits are used for computing the
+  // bounds of the rounding interval.
+  int e2;
+  uint32 m2;
+  if (ieee_exponent == 0) {
+    e2 = 1 - kExponentBias - kMantissaBits - 2;
+    m2 = ieee_mantissa;
+  } else {
+    e2 = ieee_exponent - kExponentBias - kMantissaBits - 2;
+    m2 = (1u << kMantissaBits) | ieee_mantissa;
+  }
+  bool accept_bounds = (m2 & 1) == 0;
+
+  // The float is mv * 2^e2 and the rounding interval is [mm, mp] * 2^e2. The
+  // lower bound is closer when the mantissa is a power of two.
+  uint32 mv = 4 * m2;
+  uint32 mp = 4 * m2 + 2;
+  uint32 mm_shift = ieee_mantissa != 0 || ieee_exponent <= 1;
+  uint32 mm = 4 * m2 - 1 - mm_shift;
+
+  // Convert the interval to decimal, i.e. compute vr, vp, and vm such that
+  // the interval is [vm, vp] * 10^e10. The digits removed by the conversion
+  // are tracked to decide if the bounds are exact and to round vr.
+  uint32 vr, vp, vm;
+  int e10;
+  bool vm_trailing_zeros = false;
+  bool vr_trailing_zeros = false;
+  uint32 last_removed_digit = 0;
+  if (e2 >= 0) {
+    int q = Log10Pow2(e2);
+    e10 = q;
+    int k = kFloatPow5InvBitCount + Pow5Bits(q) - 1;
+    int i = -e2 + q + k;
+    vr = MulShift32(mv, kFloatPow5InvSplit[q], i);
+    vp = MulShift32(mp, kFloatPow5InvSplit[q], i);
+    vm = MulShift32(mm, kFloatPow5InvSplit[q], i);
+    if (q != 0 && (vp - 1) / 10 <= vm / 10) {
+      // The loop below removes at most one digit, so the last removed digit
+      // needs to be computed here.
+      int l = kFloatPow5InvBitCount + Pow5Bits(q - 1) - 1;
+      last_removed_digit =
+          MulShift32(mv, kFloatPow5InvSplit[q - 1], -e2 + q - 1 + l) % 10;
+    }
+    if (q <= 9) {
+      // Only one of mp, mv, and mm can be a multiple of five.
+      if (mv % 5 == 0) {
+        vr_trailing_zeros = MultipleOfPowerOf5(mv, q);
+      } else if (accept_bounds) {
+        vm_trailing_zeros = MultipleOfPowerOf5(mm, q);
+      } else {
+        vp -= MultipleOfPowerOf5(mp, q);
+      }
+    }
+  } else {
+    int q = Log10Pow5(-e2);
+    e10 = q + e2;
+    int i = -e2 - q;
+    int k = Pow5Bits(i) - kFloatPow5BitCount;
+    int j = q - k;
+    vr = MulShift32(mv, kFloatPow5Split[i], j);
+    vp = MulShift32(mp, kFloatPow5Split[i], j);
+    vm = MulShift32(mm, kFloatPow5Split[i], j);
+    if (q != 0 && (vp - 1) / 10 <= vm / 10) {
+      j = q - 1 - (Pow5Bits(i + 1) - kFloatPow5BitCount);
+      last_removed_digit = MulShift32(mv, kFloatPow5Split[i + 1], j) % 10;
+    }
+    if (q <= 1) {
+      // mv, mp, and mm have at least two trailing zero bits, except mm when
+      // the mantissa is a power of two.
+      vr_trailing_zeros = true;
+      if (accept_bounds) {
+        vm_trailing_zeros = mm_shift == 1;
+      } else {
+        vp--;
+      }
+    } else if (q < 31) {
+      vr_trailing_zeros = MultipleOfPowerOf2(mv, q - 1);
+    }
+  }
+
+  // Remove digits while the interval still contains a shorter number.
+  int removed = 0;
+  uint32 output;
+  if (vm_trailing_zeros || vr_trailing_zeros) {
+    // General case for exact bounds.
+    while (vp / 10 > vm / 10) {
+      vm_trailing_zeros &= vm % 10 == 0;
+      vr_trailing_zeros &= last_removed_digit == 0;
+      last_removed_digit = vr % 10;
+      vr /= 10;
+      vp /= 10;
+      vm /= 10;
+      removed++;
+    }
+    if (vm_trailing_zeros) {
+      while (vm % 10 == 0) {
+        vr_trailing_zeros &= last_removed_digit == 0;
+        last_removed_digit = vr % 10;
+        vr /= 10;
+        vp /= 10;
+        vm /= 10;
+        removed++;
+      }
+    }
+    if (vr_trailing_zeros && last_removed_digit == 5 && vr % 2 == 0) {
+      // Round even if the exact number is .....50..0.
+      last_removed_digit = 4;
+    }
+    // Round up if vr is outside the interval or the removed digits are
+    // larger than half.
+    output = vr + ((vr == vm && (!accept_bounds || !vm_trailing_zeros)) ||
+                   last_removed_digit >= 5);
+  } else {
+    // Common case where the bounds are not exact.
+    while (vp / 10 > vm / 10) {
+      last_removed_digit = vr % 10;
+      vr /= 10;
+      vp /= 10;
+      vm /= 10;
+      removed++;
+    }
+    output = vr + (vr == vm || last_removed_digit >= 5);
+  }
+
+  *digits = output;
+  *exponent = e10 + removed;
+}
+
+char *FastFloatToBufferLeft(float value, char *buffer) {
+  uint32 bits = bit_cast<uint32>(value);
+  if (bits >> 31) *buffer++ = '-';
+  bits &= 0x7FFFFFFF;
+
+  // Output special values like printf().
+  if (bits >= 0x7F800000) {
+    strcpy(buffer, bits == 0x7F800000 ? "inf" : "nan");
+    return buffer + 3;
+  }
+  if (bits == 0) {
+    strcpy(buffer, "0");
+    return buffer + 1;
+  }
+
+  // Compute the shortest digits and output them right-aligned in a scratch
+  // buffer.
+  uint32 output;
+  int exponent;
+  ShortestFloat(bits, &output, &exponent);
+  char scratch[16];
+  char *end = scratch + sizeof(scratch);
+  char *start = end;
+  while (output >= 100) {
+    start -= 2;
+    PutTwoDigits(output % 100, start);
+    output /= 100;
+  }
+  if (output >= 10) {
+    start -= 2;
+    PutTwoDigits(output, start);
+  } else {
+    *--start = '0' + output;
+  }
+  int length = end - start;
+
+  // Use the same notation as printf("%g") with the precision set to the
+  // number of digits, but at least six. Scientific notation is used for
+  // exponents below -4 or at least the precision.
+  int x = exponent + length - 1;
+  int precision = length > 6 ? length : 6;
+  if (x < -4 || x >= precision) {
+    *buffer++ = *start++;
+    if (start < end) {
+      *buffer++ = '.';
+      while (start < end) *buffer++ = *start++;
+    }
+    *buffer++ = 'e';
+    if (x < 0) {
+      *buffer++ = '-';
+      x = -x;
+    } else {
+      *buffer++ = '+';
+    }
+    if (x >= 10) {
+      PutTwoDigits(x, buffer);
+      buffer += 2;
+    } else {
+      *buffer++ = '0';
+      *buffer++ = '0' + x;
+    }
+  } else if (x < 0) {
+    *buffer++ = '0';
+    *buffer++ = '.';
+    for (int i = -1; i > x; --i) *buffer++ = '0';
+    while (start < end) *buffer++ = *start++;
+  } else {
+    for (int i = 0; i <= x; ++i) {
+      *buffer++ = start < end ? *start++ : '0';
+      if (i == x && start < end) *buffer++ = '.';
+    }
+    while (start < end) *buffer++ = *start++;
+  }
+  *buffer = '\0';
+  return buffer;
+}
+
 // ----------------------------------------------------------------------
 // SimpleDtoa()
 // SimpleFtoa()
@@ -1028,6 +1593,9 @@ bool StrictAutoDigitLessThan(const char *a, int alen,
 //    and it is embedded in a larger library.  If speed turns out to be
 //    an issue, we could re-implement this in terms of their
 //    implementation.
+//
+//    Floats are converted with FastFloatToBufferLeft() instead, which
+//    always gives the shortest representation.
 // ----------------------------------------------------------------------
 
 string SimpleDtoa(double value) {
@@ -1065,27 +1633,7 @@ char *DoubleToBuffer(double value, char *buffer) {
 }
 
 char *FloatToBuffer(float value, char *buffer) {
-  // FLT_DIG is 6 for IEEE-754 floats, which are used on almost all
-  // platforms these days.  Just in case some system exists where FLT_DIG
-  // is significantly larger -- and risks overflowing our buffer -- we have
-  // this assert.
-  static_assert(FLT_DIG < 10, "FLT_DIG is too big");
-
-  int snprintf_result =
-    snprintf(buffer, kFloatToBufferSize, "%.*g", FLT_DIG, value);
-
-  // The snprintf should never overflow because the buffer is significantly
-  // larger than the precision we asked for.
-  DCHECK(snprintf_result > 0 && snprintf_result < kFloatToBufferSize);
-
-  float parsed_value;
-  if (!safe_strtof(buffer, &parsed_value) || parsed_value != value) {
-    snprintf_result =
-      snprintf(buffer, kFloatToBufferSize, "%.*g", FLT_DIG+2, value);
-
-    // Should never overflow; see above.
-    DCHECK(snprintf_result > 0 && snprintf_result < kFloatToBufferSize);
-  }
+  FastFloatToBufferLeft(value, buffer);
   return buffer;
 }
 
@@ -56,6 +56,10 @@ bool safe_strtod(const string &str, double *value);
 bool safe_strto32(const char *startptr, int buffer_size, int32 *value);
 bool safe_strto64(const char *startptr, int buffer_size, int64 *value);
 
+// Parses size many characters from str into a float. Decimal numbers are
+// converted exactly without going through strtof().
+bool safe_strtof(const char *str, int size, float *value);
+
 // Parses with a fixed base between 2 and 36. For base 16, leading "0x" is ok.
 // If base is set to 0, its value is inferred from the beginning of str:
 // "0x" means base 16, "0" means base 8, otherwise base 10 is used.
@@ -441,7 +445,8 @@ bool ABSL_MUST_USE_RESULT SimpleAtoi(const string &s, int_type *out) {
 //    passed to strtod(), will produce the exact same original double
 //    (except in case of NaN; all NaNs are considered the same value).
 //    We try to keep the string short but it's not guaranteed to be as
-//    short as possible.
+//    short as possible for doubles. Floats are always converted to the
+//    shortest string.
 //
 //    DoubleToBuffer() and FloatToBuffer() write the text to the given
 //    buffer and return it.  The buffer must be at least
@@ -457,6 +462,12 @@ string SimpleFtoa(float value);
 char *DoubleToBuffer(double i, char *buffer);
 char *FloatToBuffer(float i, char *buffer);
 
+// Writes the shortest string for a float to the beginning of the buffer and
+// returns a pointer to the terminating nul. The notation is the same as for
+// printf("%g"), i.e. scientific notation is only used for large and small
+// exponents. The buffer must be at least kFloatToBufferSize bytes.
+char *FastFloatToBufferLeft(float value, char *buffer);
+
 // In practice, doubles should never need more than 24 bytes and floats
 // should never need more than 14 (including nul terminators), but we
 // overestimate to be safe.
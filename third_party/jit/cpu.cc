@@ -29,6 +29,7 @@
 // modified significantly by Google Inc.
 // Copyright 2017 Google Inc. All rights reserved.
 
+#include <string.h>
 #include <utility>
 
 #include "third_party/jit/cpu.h"
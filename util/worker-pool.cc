@@ -0,0 +1,82 @@
+// Copyright 2017 Google Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "util/worker-pool.h"
+
+#include "base/logging.h"
+
+namespace sling {
+
+WorkerPool::WorkerPool(int num_threads) {
+  CHECK_GE(num_threads, 1);
+  for (int i = 1; i < num_threads; ++i) {
+    workers_.emplace_back(&WorkerPool::Work, this, i);
+  }
+}
+
+WorkerPool::~WorkerPool() {
+  {
+    std::lock_guard<std::mutex> lock(mu_);
+    stop_ = true;
+  }
+  start_.notify_all();
+  for (std::thread &t : workers_) t.join();
+}
+
+void WorkerPool::Run(const Task &task) {
+  // Wake up the workers.
+  {
+    std::lock_guard<std::mutex> lock(mu_);
+    task_ = &task;
+    pending_ = workers_.size();
+    generation_++;
+  }
+  start_.notify_all();
+
+  // The calling thread runs the task as worker 0.
+  task(0);
+
+  // Wait for the workers to complete.
+  std::unique_lock<std::mutex> lock(mu_);
+  done_.wait(lock, [this]() { return pending_ == 0; });
+  task_ = nullptr;
+}
+
+void WorkerPool::Work(int worker) {
+  int generation = 0;
+  for (;;) {
+    // Wait for next run.
+    const Task *task;
+    {
+      std::unique_lock<std::mutex> lock(mu_);
+      start_.wait(lock, [this, generation]() {
+        return stop_ || generation_ != generation;
+      });
+      if (stop_) return;
+      generation = generation_;
+      task = task_;
+    }
+
+    // Run task and signal completion.
+    (*task)(worker);
+    bool last;
+    {
+      std::lock_guard<std::mutex> lock(mu_);
+      last = --pending_ == 0;
+    }
+    if (last) done_.notify_one();
+  }
+}
+
+}  // namespace sling
@@ -0,0 +1,80 @@
+// Copyright 2017 Google Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef UTIL_WORKER_POOL_H_
+#define UTIL_WORKER_POOL_H_
+
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "base/macros.h"
+
+namespace sling {
+
+// Pool of worker threads for running the same task on a fixed number of
+// threads several times. The threads are started when the pool is created and
+// are reused for each run, so a run only costs a wakeup of the workers. The
+// calling thread takes part in each run as worker 0.
+class WorkerPool {
+ public:
+  // A task is called with the worker index as argument.
+  typedef std::function<void(int worker)> Task;
+
+  // Starts pool for running tasks on a number of threads, including the
+  // calling thread.
+  explicit WorkerPool(int num_threads);
+
+  // Stops all the worker threads.
+  ~WorkerPool();
+
+  // Runs task on all threads in the pool and waits until all of them are done.
+  void Run(const Task &task);
+
+  // Returns the number of threads in each run.
+  int size() const { return workers_.size() + 1; }
+
+ private:
+  // Worker thread loop.
+  void Work(int worker);
+
+  // Worker threads. The calling thread is worker 0, so the first thread in
+  // this list is worker 1.
+  std::vector<std::thread> workers_;
+
+  // Task for current run.
+  const Task *task_ = nullptr;
+
+  // Generation number that is incremented for each run.
+  int generation_ = 0;
+
+  // Number of worker threads that have not yet completed the current run.
+  int pending_ = 0;
+
+  // Set when the workers should stop.
+  bool stop_ = false;
+
+  // Mutex and signals for starting and completing runs.
+  std::mutex mu_;
+  std::condition_variable start_;
+  std::condition_variable done_;
+
+  DISALLOW_COPY_AND_ASSIGN(WorkerPool);
+};
+
+}  // namespace sling
+
+#endif  // UTIL_WORKER_POOL_H_